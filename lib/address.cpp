@@ -1,34 +1,20 @@
 #include "address.h"
+#include "bytes.h"
 
 #include <QDebug>
 
+#include <array>
+
 namespace Bd {
 
 Address::Address() {}
 
-Address::Address(QByteArrayView bytes)
-{
-    Q_ASSERT(bytes.size() <= 4);
-
-    _stack = 0;
-    switch (bytes.size()) {
-    case 4:
-        _stack |= bytes[3] << 24;
-        // fall through
-    case 3:
-        _stack |= bytes[2] << 16;
-        // fall through
-    case 2:
-        _stack |= bytes[1] << 8;
-        // fall through
-    case 1:
-        _stack |= bytes[0];
-        break;
-    }
-}
-
 Address::Address(quint32 stack)
-    : _stack(stack)
+    : _address(stack)
+{}
+
+Address::Address(Core::Address address)
+    : _address(address)
 {}
 
 Address Address::localNode()
@@ -38,67 +24,62 @@ Address Address::localNode()
 
 QByteArray Address::toByteArray() const
 {
-    auto res = QByteArray(reinterpret_cast<const char *>(&_stack), sizeof(_stack));
-    res.resize(size());
-    res.append('\0');
-    return res;
+    std::array<std::byte, Core::Address::MaxDepth + 1> buf;
+    return Bd::toByteArray(std::span(buf).first(_address.encode(buf)));
 }
 
 qsizetype Address::size() const
 {
-    if (_stack & 0xff000000)
-        return 4;
-    if (_stack & 0xff0000)
-        return 3;
-    if (_stack & 0xff00)
-        return 2;
-    if (_stack & 0xff)
-        return 1;
-    return 0;
+    return _address.size();
 }
 
 bool Address::isLocalNode() const
 {
-    return _stack == 0;
+    return _address.isLocalNode();
 }
 
 tl::expected<quint8, Error> Address::downstream()
 {
-    if (isLocalNode())
-        return tl::make_unexpected(Error::AddressStackEmpty);
-    auto node = _stack & 0xff;
-    _stack >>= 8;
-    return node;
+    return _address.downstream();
 }
 
 tl::expected<void, Error> Address::upstream(quint8 node)
 {
-    if (size() == 4)
-        return tl::make_unexpected(Error::AddressStackFull);
-    _stack = (_stack << 8) | node;
-    return {};
+    return _address.upstream(node);
+}
+
+tl::expected<Address, Error> Address::child(quint8 local) const
+{
+    // a node only knows its local number, every hub on the way up to the host prepends its own
+    auto address = Address(local);
+    auto stack = _address.stack();
+    for (auto hop = size(); hop-- > 0;) {
+        auto result = address.upstream(static_cast<quint8>(stack >> (8 * hop)));
+        if (!result)
+            return tl::make_unexpected(result.error());
+    }
+    return address;
 }
 
 bool Address::operator==(Address const &rhs) const
 {
-    return _stack == rhs._stack;
+    return _address == rhs._address;
 }
 
 tl::expected<Address, Error> Address::parse(QByteArrayView bytes)
 {
-    if (bytes.isEmpty())
-        return tl::make_unexpected(Error::OutOfData);
-    auto size = bytes.indexOf('\0');
-    if (size == -1)
-        return tl::make_unexpected(Error::AddressMissingTerminator);
-    if (size > 4)
-        return tl::make_unexpected(Error::AddressTooLong);
-    return Address(bytes.first(size));
+    return Core::Address::parse(asBytes(bytes)).map([](Core::Address a) { return Address(a); });
+}
+
+Core::Address Address::core() const
+{
+    return _address;
 }
 
 QDebug operator<<(QDebug d, Address const &a)
 {
-    d << QByteArray(reinterpret_cast<const char *>(&a), sizeof(a)).toHex('-');
+    auto stack = a._address.stack();
+    d << QByteArray(reinterpret_cast<const char *>(&stack), sizeof(stack)).toHex('-');
     return d;
 }
 
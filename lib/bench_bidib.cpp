@@ -0,0 +1,261 @@
+#include <QTest>
+
+#include <QLoggingCategory>
+
+#include <bidib/address.h>
+#include <bidib/bidib_messages.h>
+#include <bidib/message.h>
+#include <bidib/node.h>
+#include <bidib/pack.h>
+#include <bidib/serialtransport.h>
+#include <bidib/trafficgenerator.h>
+
+#include "crc.h"
+
+// Microbenchmarks for the codec path. Run with "-o bench.csv,csv" or "-o bench.xml,xml" to get
+// results that can be compared between releases, see the bidib-bench-report target.
+class BenchBiDiB : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void computeCrc8_data();
+    void computeCrc8();
+
+    void serialTransportEscape_data();
+    void serialTransportEscape();
+    void serialTransportUnescape_data();
+    void serialTransportUnescape();
+
+    void serialTransportProcessData_data();
+    void serialTransportProcessData();
+    void serialTransportProcessDataSignals_data();
+    void serialTransportProcessDataSignals();
+
+    void packerPack();
+    void unpackerUnpack();
+
+    void addressParse();
+    void messageToSendBuffer();
+
+    void nodeDispatch();
+};
+
+struct KeyValue8
+{
+    quint8 id;
+    quint8 value;
+};
+
+// Roughly 4 KiB of generated traffic with the given shape.
+static QByteArray traffic(Bd::TrafficProfile const &profile)
+{
+    Bd::TrafficGenerator generator(profile, 42);
+    QByteArray result;
+    while (result.size() < 4096)
+        result += generator.generate(std::chrono::milliseconds(10));
+    return result;
+}
+
+// Roughly 4 KiB of frames whose payload needs escaping byte for byte, a fixed worst case for
+// the unescape path. The same frames as in earlier releases, to keep results comparable.
+static QByteArray escapeHeavy()
+{
+    auto payload = Bd::Packer::pack(quint8(BIDIB_PKT_MAGIC), quint8(BIDIB_PKT_ESCAPE));
+    QByteArray result;
+    quint8 num = 0;
+    while (result.size() < 4096) {
+        auto buf = Bd::Message(MSG_FEATURE, payload).toSendBuffer(Bd::Address(0x03), ++num);
+        result += Bd::SerialTransport::frame(*buf);
+    }
+    return result;
+}
+
+static QByteArray randomBytes(qsizetype size)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for (qsizetype i = 0; i < size; ++i)
+        result[i] = static_cast<char>(i * 31 + 7);
+    return result;
+}
+
+static void addSizes()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addRow("16") << randomBytes(16);
+    QTest::addRow("64") << randomBytes(64);
+    QTest::addRow("4096") << randomBytes(4096);
+}
+
+static void addTrafficMixes()
+{
+    Bd::TrafficProfile none;
+    none.occupancyRate = none.railcomRate = none.diagnosticsRate = none.driveAckRate
+        = none.featureRate = 0;
+
+    auto occupancy = none;
+    occupancy.occupancyRate = 100;
+    auto railcom = none;
+    railcom.railcomRate = 100;
+    auto diagnostics = none;
+    diagnostics.diagnosticsRate = 100;
+
+    QTest::addColumn<QByteArray>("data");
+    QTest::addRow("occupancy") << traffic(occupancy);
+    QTest::addRow("railcom") << traffic(railcom);
+    QTest::addRow("diagnostics") << traffic(diagnostics);
+    QTest::addRow("escape-heavy") << escapeHeavy();
+    QTest::addRow("mixed") << traffic(Bd::TrafficProfile{});
+    QTest::addRow("mixed-10x") << traffic(Bd::TrafficProfile{}.scaled(10));
+}
+
+void BenchBiDiB::initTestCase()
+{
+    // the node logs every message, keep the formatting but drop the output
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false\ndefault.warning=false"));
+}
+
+void BenchBiDiB::computeCrc8_data()
+{
+    addSizes();
+}
+
+void BenchBiDiB::computeCrc8()
+{
+    QFETCH(QByteArray, data);
+    quint8 crc = 0;
+    QBENCHMARK {
+        crc ^= Bd::computeCrc8(data);
+    }
+    Q_UNUSED(crc);
+}
+
+void BenchBiDiB::serialTransportEscape_data()
+{
+    addSizes();
+}
+
+void BenchBiDiB::serialTransportEscape()
+{
+    QFETCH(QByteArray, data);
+    QBENCHMARK {
+        auto escaped = Bd::SerialTransport::escape(data);
+        Q_UNUSED(escaped);
+    }
+}
+
+void BenchBiDiB::serialTransportUnescape_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addRow("16") << Bd::SerialTransport::escape(randomBytes(16));
+    QTest::addRow("64") << Bd::SerialTransport::escape(randomBytes(64));
+    QTest::addRow("4096") << Bd::SerialTransport::escape(randomBytes(4096));
+}
+
+void BenchBiDiB::serialTransportUnescape()
+{
+    QFETCH(QByteArray, data);
+    QBENCHMARK {
+        auto unescaped = Bd::SerialTransport::unescape(data);
+        Q_UNUSED(unescaped);
+    }
+}
+
+void BenchBiDiB::serialTransportProcessData_data()
+{
+    addTrafficMixes();
+}
+
+void BenchBiDiB::serialTransportProcessData()
+{
+    struct Sink : Bd::TransportSink
+    {
+        quint64 messages{};
+        void messageReceived(Bd::Core::MessageView const &) override { ++messages; }
+    };
+
+    QFETCH(QByteArray, data);
+    Sink sink;
+    Bd::SerialTransport st;
+    st.setSink(&sink);
+    QBENCHMARK {
+        st.processData(data);
+    }
+    QVERIFY(sink.messages > 0);
+}
+
+void BenchBiDiB::serialTransportProcessDataSignals_data()
+{
+    addTrafficMixes();
+}
+
+void BenchBiDiB::serialTransportProcessDataSignals()
+{
+    QFETCH(QByteArray, data);
+    quint64 messages = 0;
+    Bd::SerialTransport st;
+    connect(&st, &Bd::SerialTransport::messageReceived, this, [&messages] { ++messages; });
+    QBENCHMARK {
+        st.processData(data);
+    }
+    QVERIFY(messages > 0);
+}
+
+void BenchBiDiB::packerPack()
+{
+    QBENCHMARK {
+        auto payload = Bd::Packer::pack(quint8(1),
+                                        quint16(2),
+                                        KeyValue8{BIDIB_BST_DIAG_I, 100},
+                                        QStringLiteral("Größenwahn"));
+        Q_UNUSED(payload);
+    }
+}
+
+void BenchBiDiB::unpackerUnpack()
+{
+    auto payload = Bd::Packer::pack(quint8(1),
+                                    quint16(2),
+                                    KeyValue8{BIDIB_BST_DIAG_I, 100},
+                                    QStringLiteral("Größenwahn"));
+    QBENCHMARK {
+        auto values = Bd::Unpacker::unpack<quint8, quint16, KeyValue8, QString>(payload);
+        Q_UNUSED(values);
+    }
+}
+
+void BenchBiDiB::addressParse()
+{
+    auto data = QByteArray::fromHex("0102030400");
+    QBENCHMARK {
+        auto address = Bd::Address::parse(data);
+        Q_UNUSED(address);
+    }
+}
+
+void BenchBiDiB::messageToSendBuffer()
+{
+    auto msg = Bd::Message(MSG_BM_ADDRESS, Bd::Packer::pack(quint8(1), quint16(1234)));
+    auto address = Bd::Address(0x030201);
+    QBENCHMARK {
+        auto buf = msg.toSendBuffer(address, 42);
+        Q_UNUSED(buf);
+    }
+}
+
+void BenchBiDiB::nodeDispatch()
+{
+    auto getAll = Bd::Message(MSG_NODETAB_GETALL, {});
+    auto getNext = Bd::Message(MSG_NODETAB_GETNEXT, {});
+    Bd::Node node;
+    QBENCHMARK {
+        node.handleMessage(getAll);
+        node.handleMessage(getNext);
+    }
+}
+
+QTEST_MAIN(BenchBiDiB)
+
+#include "bench_bidib.moc"
@@ -0,0 +1,162 @@
+#include "discovery.h"
+#include "bidib_messages.h"
+#include "host.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+
+namespace Bd {
+
+class DiscoveryPrivate
+{
+    Q_DECLARE_PUBLIC(Discovery)
+
+public:
+    DiscoveryPrivate(Discovery *q, Host *host)
+        : q_ptr(q)
+        , host(host)
+    {}
+
+    void enumerate(qsizetype node);
+    void nodeTabRead(Address const &address, quint8 version, QList<NodeTabEntry> const &entries);
+    void requestFailed(Address const &address, quint8 type, Error error);
+    void reportProgress();
+
+    Discovery *const q_ptr;
+    Host *const host;
+
+    QList<DiscoveredNode> nodes;
+    // hubs with an enumeration in flight, by address stack
+    QHash<quint32, qsizetype> pending;
+    QElapsedTimer timer;
+    std::chrono::milliseconds elapsed{};
+    bool running{false};
+};
+
+void DiscoveryPrivate::enumerate(qsizetype node)
+{
+    pending.insert(nodes[node].address.core().stack(), node);
+    host->readNodeTab(nodes[node].address);
+}
+
+void DiscoveryPrivate::nodeTabRead(Address const &address,
+                                   quint8 version,
+                                   QList<NodeTabEntry> const &entries)
+{
+    Q_Q(Discovery);
+
+    auto it = pending.find(address.core().stack());
+    if (it == pending.end())
+        return;
+    auto parent = *it;
+    pending.erase(it);
+    nodes[parent].nodeTabVersion = version;
+
+    QList<qsizetype> hubs;
+    for (auto const &e : entries) {
+        if (e.local == 0) {
+            // the node itself, only news for the root
+            nodes[parent].uniqueId = e.uniqueId;
+            if (parent == 0)
+                emit q->nodeDiscovered(address, e.uniqueId);
+            continue;
+        }
+
+        auto child = address.child(e.local);
+        if (!child) {
+            qWarning() << "cannot address node" << e.local << "below" << address << child.error();
+            continue;
+        }
+
+        nodes << DiscoveredNode{*child, e.uniqueId, 0, parent};
+        emit q->nodeDiscovered(*child, e.uniqueId);
+        if (e.uniqueId.classId & UniqueId::ClassBridge)
+            hubs << nodes.size() - 1;
+    }
+
+    // the siblings' subtrees are read side by side. All of them count as pending before the
+    // first request goes out, a subtree answered right away must not end the discovery.
+    for (auto hub : std::as_const(hubs))
+        pending.insert(nodes[hub].address.core().stack(), hub);
+    for (auto hub : std::as_const(hubs))
+        host->readNodeTab(nodes[hub].address);
+    reportProgress();
+}
+
+void DiscoveryPrivate::requestFailed(Address const &address, quint8 type, Error error)
+{
+    Q_Q(Discovery);
+
+    if (type != MSG_NODETAB_GETALL || !pending.remove(address.core().stack()))
+        return;
+    emit q->hubFailed(address, error);
+    reportProgress();
+}
+
+void DiscoveryPrivate::reportProgress()
+{
+    Q_Q(Discovery);
+
+    if (!running)
+        return;
+    emit q->progress(nodes.size(), pending.size());
+    if (!pending.isEmpty())
+        return;
+
+    running = false;
+    elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::nanoseconds(timer.nsecsElapsed()));
+    emit q->finished(elapsed);
+}
+
+Discovery::Discovery(Host *host)
+    : _d(new DiscoveryPrivate(this, host))
+{
+    Q_D(Discovery);
+    connect(host,
+            &Host::nodeTabRead,
+            this,
+            [d](Address const &address, quint8 version, QList<NodeTabEntry> const &entries) {
+                d->nodeTabRead(address, version, entries);
+            });
+    connect(host,
+            &Host::requestFailed,
+            this,
+            [d](Address const &address, quint8 type, Error error) {
+                d->requestFailed(address, type, error);
+            });
+}
+
+Discovery::~Discovery() = default;
+
+void Discovery::start(Address const &root)
+{
+    Q_D(Discovery);
+    d->nodes.clear();
+    d->pending.clear();
+    d->nodes << DiscoveredNode{root, {}, 0, -1};
+    d->running = true;
+    d->timer.start();
+    d->enumerate(0);
+}
+
+bool Discovery::isRunning() const
+{
+    Q_D(const Discovery);
+    return d->running;
+}
+
+QList<DiscoveredNode> const &Discovery::nodes() const
+{
+    Q_D(const Discovery);
+    return d->nodes;
+}
+
+std::chrono::milliseconds Discovery::elapsed() const
+{
+    Q_D(const Discovery);
+    return d->elapsed;
+}
+
+} // namespace Bd
@@ -0,0 +1,915 @@
+#include "host.h"
+#include "bidib_messages.h"
+
+#include <bidib/scheduler.h>
+
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+
+#include <bitset>
+#include <functional>
+#include <optional>
+
+namespace Bd {
+
+class HostPrivate
+{
+    Q_DECLARE_PUBLIC(Host)
+
+public:
+    explicit HostPrivate(Host *q)
+        : q_ptr(q)
+    {}
+
+    enum class Conversation { Features, NodeTab, Node, Accessories };
+
+    // Timeout of a conversation. Its timer may still go off after the conversation ended or
+    // started over, the serial tells whether it is still the current one.
+    struct Deadline
+    {
+        Scheduler::Id timer{};
+        quint64 serial{};
+    };
+
+    struct FeatureRequest
+    {
+        Core::FeatureTable features;
+        std::optional<quint8> count;
+        bool streaming{false};
+        Deadline deadline;
+    };
+
+    struct NodeTabRequest
+    {
+        std::optional<quint8> count;
+        quint8 version{};
+        QList<NodeTabEntry> entries;
+        Deadline deadline;
+    };
+
+    struct AccessoryRequest
+    {
+        QList<AccessoryState> states;
+        std::bitset<256> received;
+        qsizetype count{0};
+        Deadline deadline;
+    };
+
+    struct NodeRequest
+    {
+        enum Stage { UniqueId, SoftwareVersion, NodeTab, Features, ProductName, UserName };
+
+        Stage stage{UniqueId};
+        NodeInfo info;
+        bool fromCache{false};
+        Deadline deadline;
+    };
+
+    struct ReplyRequest
+    {
+        quint64 id;
+        Message request;
+        qsizetype size; // on the wire
+        ReplyFilter filter;
+        Scheduler::Id timer{};
+        std::function<void(tl::expected<Message, Error>)> done;
+    };
+
+    // Awaited requests of one node in issue order. The first inFlight are sent, the rest wait
+    // for room in the window.
+    struct ReplyQueue
+    {
+        QList<ReplyRequest> requests;
+        qsizetype inFlight{0};
+        qsizetype bytes{0};
+    };
+
+    void send(Address const &address, Message const &msg);
+    quint64 expectReply(Address const &address,
+                        Message const &request,
+                        ReplyFilter filter,
+                        std::function<void(tl::expected<Message, Error>)> done);
+    void cancelReply(Address const &address, quint64 id);
+    void resolveReplies(Address const &address, Message const &msg);
+    ReplyRequest takeReply(ReplyQueue &queue, qsizetype index);
+    void pump(Address const &address);
+    void touch(Deadline &deadline, Conversation conversation, quint32 stack);
+    void cancel(Deadline &deadline);
+    void expire(Conversation conversation, quint32 stack, quint64 serial);
+    void expireReply(quint32 stack, quint64 id);
+
+    void featureCount(Address const &address, Message const &msg);
+    void feature(Address const &address, Message const &msg);
+    void featureNA(Address const &address, Message const &msg);
+    void finishFeatures(Address const &address);
+
+    void nodeTabEntry(Address const &address, Message const &msg);
+    void nodeNA(Address const &address, Message const &msg);
+    void finishNodeTab(Address const &address, bool fromCache = false);
+    void nodeChanged(Address const &address, Message const &msg);
+
+    void accessoryState(Address const &address, Message const &msg);
+
+    void uniqueId(Address const &address, Message const &msg);
+    void softwareVersion(Address const &address, Message const &msg);
+    void nodeTabCount(Address const &address, Message const &msg);
+    void nodeRequestEntry(Address const &address, Message const &msg);
+    void nodeRequestNA(Address const &address, Message const &msg);
+    void string(Address const &address, Message const &msg);
+    void readFeaturesOf(Address const &address, NodeRequest &request);
+    void readStrings(Address const &address, NodeRequest &request);
+    void finishNode(Address const &address);
+
+    Host *const q_ptr;
+    std::chrono::milliseconds timeout{1000};
+    Scheduler scheduler;
+    quint64 nextSerial{1};
+
+    // in-flight conversations by address stack
+    QHash<quint32, FeatureRequest> featureRequests;
+    QHash<quint32, NodeTabRequest> nodeTabRequests;
+    QHash<quint32, NodeRequest> nodeRequests;
+    QHash<quint32, AccessoryRequest> accessoryRequests;
+    QHash<quint32, ReplyQueue> replyQueues;
+    quint64 nextReplyId{1};
+    qsizetype window{8};
+    // reported with MSG_PKT_CAPACITY, nodes that never did take 64 bytes
+    QHash<quint32, qsizetype> packetCapacity;
+    NodeCache *cache{nullptr};
+};
+
+static quint8 pendingType(HostPrivate::NodeRequest::Stage stage)
+{
+    switch (stage) {
+    case HostPrivate::NodeRequest::UniqueId:
+        return MSG_SYS_GET_UNIQUE_ID;
+    case HostPrivate::NodeRequest::SoftwareVersion:
+        return MSG_SYS_GET_SW_VERSION;
+    case HostPrivate::NodeRequest::NodeTab:
+        return MSG_NODETAB_GETALL;
+    case HostPrivate::NodeRequest::Features:
+        return MSG_FEATURE_GETALL;
+    case HostPrivate::NodeRequest::ProductName:
+    case HostPrivate::NodeRequest::UserName:
+        return MSG_STRING_GET;
+    }
+    return 0;
+}
+
+void HostPrivate::send(Address const &address, Message const &msg)
+{
+    Q_Q(Host);
+    emit q->messageToSend(address, msg);
+}
+
+quint64 HostPrivate::expectReply(Address const &address,
+                                 Message const &request,
+                                 ReplyFilter filter,
+                                 std::function<void(tl::expected<Message, Error>)> done)
+{
+    auto &queue = replyQueues[address.core().stack()];
+    auto &r = queue.requests.emplaceBack(ReplyRequest{
+        .id = nextReplyId++,
+        .request = request,
+        // length, address with terminator, number, type and payload
+        .size = 1 + address.size() + 1 + 2 + request.payload().size(),
+        .filter = std::move(filter),
+        .done = std::move(done),
+    });
+    auto id = r.id;
+    pump(address);
+    return id;
+}
+
+void HostPrivate::cancelReply(Address const &address, quint64 id)
+{
+    auto it = replyQueues.find(address.core().stack());
+    if (it == replyQueues.end())
+        return;
+    for (qsizetype i = 0; i < it->requests.size(); ++i) {
+        if (it->requests[i].id == id) {
+            takeReply(*it, i);
+            break;
+        }
+    }
+    if (it->requests.isEmpty())
+        replyQueues.erase(it);
+    pump(address);
+}
+
+void HostPrivate::resolveReplies(Address const &address, Message const &msg)
+{
+    if (msg.type() == MSG_PKT_CAPACITY && !msg.payload().isEmpty())
+        packetCapacity.insert(address.core().stack(), quint8(msg.payload()[0]));
+
+    auto it = replyQueues.find(address.core().stack());
+    if (it == replyQueues.end())
+        return;
+
+    auto matches = [&msg](ReplyFilter const &f) {
+        if (msg.type() != f.type && msg.type() != f.refusal)
+            return false;
+        return msg.payload().startsWith(f.key);
+    };
+
+    // replies may come in any order, only requests on the wire can be answered
+    QList<ReplyRequest> answered;
+    for (qsizetype i = 0; i < it->inFlight;) {
+        if (matches(it->requests[i].filter))
+            answered << takeReply(*it, i);
+        else
+            ++i;
+    }
+    if (it->requests.isEmpty())
+        replyQueues.erase(it);
+    if (answered.isEmpty())
+        return;
+
+    pump(address);
+    // resuming may start new requests
+    for (auto &r : answered)
+        r.done(msg);
+}
+
+HostPrivate::ReplyRequest HostPrivate::takeReply(ReplyQueue &queue, qsizetype index)
+{
+    if (index < queue.inFlight) {
+        --queue.inFlight;
+        queue.bytes -= queue.requests[index].size;
+        scheduler.cancel(queue.requests[index].timer);
+    }
+    return queue.requests.takeAt(index);
+}
+
+// Sends waiting requests while the node has room: at most window requests and as many bytes as
+// its packet capacity, but always at least one.
+void HostPrivate::pump(Address const &address)
+{
+    auto stack = address.core().stack();
+    for (;;) {
+        auto it = replyQueues.find(stack);
+        if (it == replyQueues.end() || it->inFlight == it->requests.size())
+            return;
+
+        auto &next = it->requests[it->inFlight];
+        auto capacity = packetCapacity.value(stack, 64);
+        if (it->inFlight > 0 && (it->inFlight >= window || it->bytes + next.size > capacity))
+            return;
+
+        ++it->inFlight;
+        it->bytes += next.size;
+        next.timer = scheduler.schedule(timeout, [this, stack, id = next.id] {
+            expireReply(stack, id);
+        });
+        // a transport may answer from within send(), which changes the queue
+        auto request = next.request;
+        send(address, request);
+    }
+}
+
+void HostPrivate::touch(Deadline &deadline, Conversation conversation, quint32 stack)
+{
+    scheduler.cancel(deadline.timer);
+    auto serial = deadline.serial = nextSerial++;
+    deadline.timer = scheduler.schedule(timeout, [this, conversation, stack, serial] {
+        expire(conversation, stack, serial);
+    });
+}
+
+void HostPrivate::cancel(Deadline &deadline)
+{
+    scheduler.cancel(std::exchange(deadline.timer, 0));
+    deadline.serial = 0;
+}
+
+void HostPrivate::expire(Conversation conversation, quint32 stack, quint64 serial)
+{
+    Q_Q(Host);
+
+    switch (conversation) {
+    case Conversation::Features: {
+        auto it = featureRequests.find(stack);
+        if (it == featureRequests.end() || it->deadline.serial != serial)
+            return;
+        featureRequests.erase(it);
+        // a node request waiting for these features fails with them
+        if (auto node = nodeRequests.find(stack); node != nodeRequests.end()) {
+            cancel(node->deadline);
+            nodeRequests.erase(node);
+        }
+        emit q->requestFailed(Address(stack), MSG_FEATURE_GETALL, Error::Timeout);
+        break;
+    }
+    case Conversation::NodeTab: {
+        auto it = nodeTabRequests.find(stack);
+        if (it == nodeTabRequests.end() || it->deadline.serial != serial)
+            return;
+        nodeTabRequests.erase(it);
+        emit q->requestFailed(Address(stack), MSG_NODETAB_GETALL, Error::Timeout);
+        break;
+    }
+    case Conversation::Node: {
+        auto it = nodeRequests.find(stack);
+        if (it == nodeRequests.end() || it->deadline.serial != serial)
+            return;
+        auto stage = it->stage;
+        nodeRequests.erase(it);
+        emit q->requestFailed(Address(stack), pendingType(stage), Error::Timeout);
+        break;
+    }
+    case Conversation::Accessories: {
+        auto it = accessoryRequests.find(stack);
+        if (it == accessoryRequests.end() || it->deadline.serial != serial)
+            return;
+        accessoryRequests.erase(it);
+        emit q->requestFailed(Address(stack), MSG_ACCESSORY_GETALL, Error::Timeout);
+        break;
+    }
+    }
+}
+
+// Awaited requests report the timeout to their coroutine instead.
+void HostPrivate::expireReply(quint32 stack, quint64 id)
+{
+    auto it = replyQueues.find(stack);
+    if (it == replyQueues.end())
+        return;
+
+    std::optional<ReplyRequest> timedOut;
+    for (qsizetype i = 0; i < it->inFlight; ++i) {
+        if (it->requests[i].id == id) {
+            timedOut = takeReply(*it, i);
+            break;
+        }
+    }
+    if (it->requests.isEmpty())
+        replyQueues.erase(it);
+    if (!timedOut)
+        return;
+
+    // the window opened up for the requests still waiting
+    pump(Address(stack));
+    timedOut->done(tl::make_unexpected(Error::Timeout));
+}
+
+void HostPrivate::featureCount(Address const &address, Message const &msg)
+{
+    auto it = featureRequests.find(address.core().stack());
+    if (it == featureRequests.end())
+        return;
+
+    auto args = Unpacker::unpack<quint8, std::optional<quint8>>(msg.payload());
+    if (!args)
+        return;
+    auto [count, mode] = *args;
+
+    it->count = count;
+    // nodes that do not know about streaming answer without a mode, walk those step by step
+    it->streaming = it->streaming && mode.value_or(0) == 1;
+    touch(it->deadline, Conversation::Features, it.key());
+
+    if (count == 0)
+        finishFeatures(address);
+    else if (!it->streaming)
+        send(address, Message(MSG_FEATURE_GETNEXT, {}));
+}
+
+void HostPrivate::feature(Address const &address, Message const &msg)
+{
+    auto it = featureRequests.find(address.core().stack());
+    if (it == featureRequests.end() || !it->count)
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8>(msg.payload());
+    if (!args)
+        return;
+    auto [id, value] = *args;
+
+    it->features.set(id, value);
+    touch(it->deadline, Conversation::Features, it.key());
+
+    if (it->features.size() >= *it->count)
+        finishFeatures(address);
+    else if (!it->streaming)
+        send(address, Message(MSG_FEATURE_GETNEXT, {}));
+}
+
+void HostPrivate::featureNA(Address const &address, Message const &msg)
+{
+    auto it = featureRequests.find(address.core().stack());
+    if (it == featureRequests.end() || !it->count)
+        return;
+
+    // 0xff marks the end of the list, the node had fewer features than it announced
+    auto args = Unpacker::unpack<quint8>(msg.payload());
+    if (args && std::get<0>(*args) == 0xff)
+        finishFeatures(address);
+}
+
+void HostPrivate::finishFeatures(Address const &address)
+{
+    Q_Q(Host);
+    auto request = featureRequests.take(address.core().stack());
+    cancel(request.deadline);
+    emit q->featuresRead(address, request.features);
+
+    auto it = nodeRequests.find(address.core().stack());
+    if (it != nodeRequests.end() && it->stage == NodeRequest::Features) {
+        it->info.features = request.features;
+        readStrings(address, *it);
+    }
+}
+
+void HostPrivate::nodeTabEntry(Address const &address, Message const &msg)
+{
+    auto it = nodeTabRequests.find(address.core().stack());
+    if (it == nodeTabRequests.end() || !it->count)
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8, UniqueId>(msg.payload());
+    if (!args)
+        return;
+    auto [version, local, uid] = *args;
+
+    if (!it->entries.isEmpty() && version != it->version) {
+        // the table changed while we were reading it, start over
+        cancel(it->deadline);
+        *it = {};
+        touch(it->deadline, Conversation::NodeTab, it.key());
+        send(address, Message(MSG_NODETAB_GETALL, {}));
+        return;
+    }
+
+    it->version = version;
+    it->entries << NodeTabEntry{local, uid};
+    touch(it->deadline, Conversation::NodeTab, it.key());
+
+    // entry 0 is the node itself, with count and version unchanged the rest is in its record
+    if (cache && it->entries.size() == 1 && local == 0) {
+        auto cached = cache->find(uid);
+        if (cached && cached->nodeTabVersion == version && cached->nodeTabCount == *it->count
+            && cached->nodeTab.size() == *it->count && cached->nodeTab[0] == it->entries[0]) {
+            it->entries = cached->nodeTab;
+            finishNodeTab(address, true);
+            return;
+        }
+    }
+
+    if (it->entries.size() >= *it->count)
+        finishNodeTab(address);
+    else
+        send(address, Message(MSG_NODETAB_GETNEXT, {}));
+}
+
+void HostPrivate::nodeNA(Address const &address, Message const &msg)
+{
+    Q_UNUSED(msg);
+    auto it = nodeTabRequests.find(address.core().stack());
+    if (it != nodeTabRequests.end() && it->count)
+        finishNodeTab(address);
+}
+
+void HostPrivate::finishNodeTab(Address const &address, bool fromCache)
+{
+    Q_Q(Host);
+    auto request = nodeTabRequests.take(address.core().stack());
+    cancel(request.deadline);
+
+    // only nodes read with readNode() have a record to keep the table in
+    if (cache && !fromCache && !request.entries.isEmpty() && request.entries[0].local == 0) {
+        if (auto info = cache->find(request.entries[0].uniqueId)) {
+            info->nodeTabVersion = request.version;
+            info->nodeTabCount = request.count.value_or(0);
+            info->nodeTab = request.entries;
+            cache->store(*info);
+        }
+    }
+    emit q->nodeTabRead(address, request.version, request.entries);
+}
+
+void HostPrivate::nodeChanged(Address const &address, Message const &msg)
+{
+    Q_Q(Host);
+
+    // MSG_NODE_LOST carries the same version, local number and unique ID as MSG_NODE_NEW
+    auto args = Unpacker::unpack<quint8, quint8, UniqueId>(msg.payload());
+    if (!args) {
+        qWarning() << "malformed node table change" << address << msg;
+        return;
+    }
+    auto [version, local, uid] = *args;
+
+    // the node repeats the change until it is acknowledged
+    send(address, Message::create<quint8>(MSG_NODE_CHANGED_ACK, version));
+    if (msg.type() == MSG_NODE_NEW)
+        emit q->nodeNew(address, version, NodeTabEntry{local, uid});
+    else
+        emit q->nodeLost(address, version, NodeTabEntry{local, uid});
+}
+
+void HostPrivate::accessoryState(Address const &address, Message const &msg)
+{
+    Q_Q(Host);
+    auto it = accessoryRequests.find(address.core().stack());
+    if (it == accessoryRequests.end())
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8, quint8, quint8, quint8>(msg.payload());
+    if (!args)
+        return;
+    auto [number, aspect, total, execute, wait] = *args;
+    if (number >= it->count)
+        return;
+
+    // the stream comes in accessory order, but an answer to an earlier MSG_ACCESSORY_SET may
+    // arrive in between and replace a state already read
+    it->states[number] = AccessoryState{number, aspect, total, execute, wait};
+    it->received.set(number);
+    touch(it->deadline, Conversation::Accessories, it.key());
+
+    if (qsizetype(it->received.count()) < it->count)
+        return;
+    auto request = accessoryRequests.take(it.key());
+    cancel(request.deadline);
+    emit q->accessoriesRead(address, request.states);
+}
+
+void HostPrivate::uniqueId(Address const &address, Message const &msg)
+{
+    auto it = nodeRequests.find(address.core().stack());
+    if (it == nodeRequests.end() || it->stage != NodeRequest::UniqueId)
+        return;
+
+    auto args = Unpacker::unpack<UniqueId>(msg.payload());
+    if (!args)
+        return;
+
+    it->info.uniqueId = std::get<0>(*args);
+    it->stage = NodeRequest::SoftwareVersion;
+    touch(it->deadline, Conversation::Node, it.key());
+    send(address, Message(MSG_SYS_GET_SW_VERSION, {}));
+}
+
+void HostPrivate::softwareVersion(Address const &address, Message const &msg)
+{
+    auto it = nodeRequests.find(address.core().stack());
+    if (it == nodeRequests.end() || it->stage != NodeRequest::SoftwareVersion)
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8, quint8>(msg.payload());
+    if (!args)
+        return;
+    auto [sub, minor, major] = *args;
+    it->info.softwareVersion = quint32(major) << 16 | quint32(minor) << 8 | sub;
+
+    if (cache) {
+        if (auto cached = cache->lookup(it->info.uniqueId, it->info.softwareVersion)) {
+            it->info = *cached;
+            it->fromCache = true;
+        }
+    }
+
+    if (it->info.uniqueId.classId & UniqueId::ClassBridge) {
+        // count and version of the node table tell whether anything changed below the node
+        it->stage = NodeRequest::NodeTab;
+        touch(it->deadline, Conversation::Node, it.key());
+        send(address, Message(MSG_NODETAB_GETALL, {}));
+    } else if (it->fromCache) {
+        finishNode(address);
+    } else {
+        readFeaturesOf(address, *it);
+    }
+}
+
+void HostPrivate::nodeTabCount(Address const &address, Message const &msg)
+{
+    if (auto tab = nodeTabRequests.find(address.core().stack()); tab != nodeTabRequests.end()) {
+        auto args = Unpacker::unpack<quint8>(msg.payload());
+        if (args) {
+            tab->count = std::get<0>(*args);
+            touch(tab->deadline, Conversation::NodeTab, tab.key());
+            if (*tab->count == 0)
+                finishNodeTab(address);
+            else
+                send(address, Message(MSG_NODETAB_GETNEXT, {}));
+        }
+    }
+
+    auto it = nodeRequests.find(address.core().stack());
+    if (it == nodeRequests.end() || it->stage != NodeRequest::NodeTab)
+        return;
+
+    auto args = Unpacker::unpack<quint8>(msg.payload());
+    if (!args)
+        return;
+    auto count = std::get<0>(*args);
+
+    if (it->fromCache && it->info.nodeTabCount != count) {
+        // the cached record is stale, keep what was just read and start over
+        it->info = NodeInfo{it->info.uniqueId, it->info.softwareVersion};
+        it->fromCache = false;
+    }
+    it->info.nodeTabCount = count;
+    if (!it->fromCache)
+        it->info.nodeTab.clear();
+
+    if (count == 0) {
+        readFeaturesOf(address, *it);
+        return;
+    }
+    // the first entry carries the table version
+    touch(it->deadline, Conversation::Node, it.key());
+    send(address, Message(MSG_NODETAB_GETNEXT, {}));
+}
+
+void HostPrivate::nodeRequestEntry(Address const &address, Message const &msg)
+{
+    auto it = nodeRequests.find(address.core().stack());
+    if (it == nodeRequests.end() || it->stage != NodeRequest::NodeTab)
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8, UniqueId>(msg.payload());
+    if (!args)
+        return;
+    auto [version, local, uid] = *args;
+
+    if (it->fromCache) {
+        // same count and version, the node table is the cached one
+        if (version == it->info.nodeTabVersion) {
+            finishNode(address);
+            return;
+        }
+        it->info = NodeInfo{it->info.uniqueId,
+                            it->info.softwareVersion,
+                            version,
+                            it->info.nodeTabCount};
+        it->fromCache = false;
+    } else if (!it->info.nodeTab.isEmpty() && version != it->info.nodeTabVersion) {
+        // the table changed while we were reading it, start over
+        it->info.nodeTab.clear();
+        touch(it->deadline, Conversation::Node, it.key());
+        send(address, Message(MSG_NODETAB_GETALL, {}));
+        return;
+    }
+
+    it->info.nodeTabVersion = version;
+    it->info.nodeTab << NodeTabEntry{local, uid};
+    if (it->info.nodeTab.size() >= it->info.nodeTabCount) {
+        readFeaturesOf(address, *it);
+        return;
+    }
+    touch(it->deadline, Conversation::Node, it.key());
+    send(address, Message(MSG_NODETAB_GETNEXT, {}));
+}
+
+void HostPrivate::nodeRequestNA(Address const &address, Message const &msg)
+{
+    Q_UNUSED(msg);
+    // the node table ended before the count said it would
+    auto it = nodeRequests.find(address.core().stack());
+    if (it != nodeRequests.end() && it->stage == NodeRequest::NodeTab && !it->fromCache
+        && !it->info.nodeTab.isEmpty())
+        readFeaturesOf(address, *it);
+}
+
+void HostPrivate::string(Address const &address, Message const &msg)
+{
+    auto it = nodeRequests.find(address.core().stack());
+    if (it == nodeRequests.end())
+        return;
+
+    auto args = Unpacker::unpack<quint8, quint8, QString>(msg.payload());
+    if (!args)
+        return;
+    auto [ns, id, s] = *args;
+
+    if (it->stage == NodeRequest::ProductName && ns == 0 && id == 0) {
+        it->info.productName = s;
+        it->stage = NodeRequest::UserName;
+        touch(it->deadline, Conversation::Node, it.key());
+        send(address, Message::create<quint8, quint8>(MSG_STRING_GET, 0, 1));
+    } else if (it->stage == NodeRequest::UserName && ns == 0 && id == 1) {
+        it->info.userName = s;
+        finishNode(address);
+    }
+}
+
+void HostPrivate::readFeaturesOf(Address const &address, NodeRequest &request)
+{
+    Q_Q(Host);
+    // the feature request has its own deadline
+    request.stage = NodeRequest::Features;
+    cancel(request.deadline);
+    q->readFeatures(address);
+}
+
+void HostPrivate::readStrings(Address const &address, NodeRequest &request)
+{
+    if (request.info.features.value(FEATURE_STRING_SIZE, 0) == 0) {
+        finishNode(address);
+        return;
+    }
+    request.stage = NodeRequest::ProductName;
+    touch(request.deadline, Conversation::Node, address.core().stack());
+    send(address, Message::create<quint8, quint8>(MSG_STRING_GET, 0, 0));
+}
+
+void HostPrivate::finishNode(Address const &address)
+{
+    Q_Q(Host);
+    auto request = nodeRequests.take(address.core().stack());
+    cancel(request.deadline);
+    if (cache && !request.fromCache)
+        cache->store(request.info);
+    emit q->nodeRead(address, request.info, request.fromCache);
+}
+
+Host::Host(QObject *parent)
+    : QObject(parent)
+    , _d(new HostPrivate(this))
+{}
+
+Host::~Host() = default;
+
+void Host::readFeatures(Address const &address, FeatureMode mode)
+{
+    Q_D(Host);
+    auto &request = d->featureRequests[address.core().stack()];
+    d->cancel(request.deadline);
+    request = {};
+    request.streaming = mode == FeatureMode::Streamed;
+    d->touch(request.deadline, HostPrivate::Conversation::Features, address.core().stack());
+
+    if (request.streaming)
+        d->send(address, Message::create<quint8>(MSG_FEATURE_GETALL, 1));
+    else
+        d->send(address, Message(MSG_FEATURE_GETALL, {}));
+}
+
+void Host::readNode(Address const &address)
+{
+    Q_D(Host);
+    auto &request = d->nodeRequests[address.core().stack()];
+    d->cancel(request.deadline);
+    request = {};
+    d->touch(request.deadline, HostPrivate::Conversation::Node, address.core().stack());
+    d->send(address, Message(MSG_SYS_GET_UNIQUE_ID, {}));
+}
+
+void Host::readNodeTab(Address const &address)
+{
+    Q_D(Host);
+    auto &request = d->nodeTabRequests[address.core().stack()];
+    d->cancel(request.deadline);
+    request = {};
+    d->touch(request.deadline, HostPrivate::Conversation::NodeTab, address.core().stack());
+    d->send(address, Message(MSG_NODETAB_GETALL, {}));
+}
+
+void Host::readAccessories(Address const &address, quint8 count)
+{
+    Q_D(Host);
+    if (count == 0) {
+        emit accessoriesRead(address, {});
+        return;
+    }
+
+    auto &request = d->accessoryRequests[address.core().stack()];
+    d->cancel(request.deadline);
+    request = {};
+    request.count = count;
+    request.states.resize(count);
+    d->touch(request.deadline, HostPrivate::Conversation::Accessories, address.core().stack());
+    d->send(address, Message(MSG_ACCESSORY_GETALL, {}));
+}
+
+PendingReply Host::request(Address const &address, Message const &request, ReplyFilter filter)
+{
+    return PendingReply(this, address, request, std::move(filter));
+}
+
+void Host::setWindow(qsizetype requests)
+{
+    Q_D(Host);
+    d->window = std::max<qsizetype>(requests, 1);
+}
+
+qsizetype Host::window() const
+{
+    Q_D(const Host);
+    return d->window;
+}
+
+void Host::setCache(NodeCache *cache)
+{
+    Q_D(Host);
+    d->cache = cache;
+}
+
+NodeCache *Host::cache() const
+{
+    Q_D(const Host);
+    return d->cache;
+}
+
+void Host::setTimeout(std::chrono::milliseconds timeout)
+{
+    Q_D(Host);
+    d->timeout = timeout;
+}
+
+std::chrono::milliseconds Host::timeout() const
+{
+    Q_D(const Host);
+    return d->timeout;
+}
+
+void Host::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(Host);
+    d->resolveReplies(address, msg);
+
+    switch (msg.type()) {
+    case MSG_FEATURE_COUNT:
+        d->featureCount(address, msg);
+        break;
+    case MSG_FEATURE:
+        d->feature(address, msg);
+        break;
+    case MSG_FEATURE_NA:
+        d->featureNA(address, msg);
+        break;
+    case MSG_SYS_UNIQUE_ID:
+        d->uniqueId(address, msg);
+        break;
+    case MSG_SYS_SW_VERSION:
+        d->softwareVersion(address, msg);
+        break;
+    case MSG_NODETAB_COUNT:
+        d->nodeTabCount(address, msg);
+        break;
+    case MSG_NODETAB:
+        d->nodeTabEntry(address, msg);
+        d->nodeRequestEntry(address, msg);
+        break;
+    case MSG_NODE_NA:
+        d->nodeNA(address, msg);
+        d->nodeRequestNA(address, msg);
+        break;
+    case MSG_NODE_NEW:
+    case MSG_NODE_LOST:
+        d->nodeChanged(address, msg);
+        break;
+    case MSG_STRING:
+        d->string(address, msg);
+        break;
+    case MSG_ACCESSORY_STATE:
+        d->accessoryState(address, msg);
+        break;
+    }
+}
+
+PendingReply::PendingReply(Host *host,
+                           Address const &address,
+                           Message const &request,
+                           ReplyFilter filter)
+    : _host(host)
+    , _address(address)
+    , _request(request)
+    , _filter(std::move(filter))
+{}
+
+PendingReply::~PendingReply()
+{
+    if (_id && !_result && _host)
+        _host->d_func()->cancelReply(_address, _id);
+}
+
+bool PendingReply::await_suspend(std::coroutine_handle<> handle)
+{
+    if (!_host) {
+        _result = tl::make_unexpected(Error::Timeout);
+        return false;
+    }
+
+    _handle = handle;
+    _suspending = true;
+    auto d = _host->d_func();
+    // sent from within, or later once the node has room
+    _id = d->expectReply(_address, _request, _filter, [this](tl::expected<Message, Error> reply) {
+        _result = std::move(reply);
+        if (!_suspending)
+            _handle.resume();
+    });
+    _suspending = false;
+
+    // an immediate answer continues without suspending
+    return !_result;
+}
+
+tl::expected<Message, Error> PendingReply::await_resume()
+{
+    return std::move(*_result);
+}
+
+} // namespace Bd
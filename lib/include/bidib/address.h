@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bidib/core/address.h>
 #include <bidib/error.h>
 
 #include <QtCore/QtTypes>
@@ -7,6 +8,7 @@
 #include <expected.hpp>
 
 class QByteArray;
+class QByteArrayView;
 class QDebug;
 
 namespace Bd {
@@ -15,6 +17,7 @@ class Address
 {
 public:
     explicit Address(quint32 stack);
+    explicit Address(Core::Address address);
 
     static Address localNode();
     QByteArray toByteArray() const;
@@ -22,14 +25,16 @@ public:
     bool isLocalNode() const;
     tl::expected<quint8, Error> downstream();
     tl::expected<void, Error> upstream(quint8 node);
+    tl::expected<Address, Error> child(quint8 local) const;
     bool operator==(Address const &rhs) const;
     static tl::expected<Address, Error> parse(QByteArrayView bytes);
 
+    Core::Address core() const;
+
 private:
     Address();
-    explicit Address(QByteArrayView bytes);
 
-    quint32 _stack{};
+    Core::Address _address{};
 
     friend QDebug operator<<(QDebug d, Address const &a);
 };
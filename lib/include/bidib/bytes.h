@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QByteArrayView>
+
+#include <cstddef>
+#include <span>
+
+namespace Bd {
+
+// Conversions between Qt byte arrays and the byte views of the core layer.
+
+inline std::span<const std::byte> asBytes(QByteArrayView ba)
+{
+    return {reinterpret_cast<const std::byte *>(ba.data()), static_cast<std::size_t>(ba.size())};
+}
+
+inline QByteArray toByteArray(std::span<const std::byte> bytes)
+{
+    return QByteArray(reinterpret_cast<const char *>(bytes.data()),
+                      static_cast<qsizetype>(bytes.size()));
+}
+
+} // namespace Bd
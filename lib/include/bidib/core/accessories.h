@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Bd::Core {
+
+// State of one accessory as carried by MSG_ACCESSORY_STATE and MSG_ACCESSORY_NOTIFY. With the
+// error bit set in execute, wait holds the error code instead of a time.
+struct AccessoryCell
+{
+    static constexpr std::uint8_t Done = 0x00;
+    static constexpr std::uint8_t Moving = 0x01;
+    static constexpr std::uint8_t Error = 0x80;
+    static constexpr std::uint8_t ErrorVoid = 0x01;
+
+    std::uint8_t aspect{};
+    std::uint8_t total{};
+    std::uint8_t execute{};
+    std::uint8_t wait{};
+
+    constexpr bool moving() const { return !(execute & Error) && (execute & Moving); }
+    constexpr bool failed() const { return execute & Error; }
+
+    constexpr bool operator==(AccessoryCell const &rhs) const = default;
+};
+static_assert(sizeof(AccessoryCell) == 4);
+
+// Accessories of one node, four bytes each. Operating one starts a movement that takes its wait
+// time and ends with complete(); errors stick until the next successful operation.
+class AccessoryBank
+{
+public:
+    AccessoryBank() = default;
+
+    // count accessories with aspects aspects each, all in aspect 0.
+    AccessoryBank(std::size_t count, std::uint8_t aspects)
+        : _cells(count, AccessoryCell{0, aspects, AccessoryCell::Done, 0})
+    {}
+
+    std::size_t size() const { return _cells.size(); }
+    bool contains(std::uint8_t number) const { return number < _cells.size(); }
+    AccessoryCell const &operator[](std::uint8_t number) const { return _cells[number]; }
+
+    // MSG_ACCESSORY_SET: starts the movement to aspect, taking wait (in the MSG_ACCESSORY_STATE
+    // encoding, 0 for instant). Returns the state to answer with, an error for an unknown aspect.
+    AccessoryCell operate(std::uint8_t number, std::uint8_t aspect, std::uint8_t wait)
+    {
+        auto &c = _cells[number];
+        if (aspect >= c.total)
+            return {c.aspect, c.total, AccessoryCell::Error, AccessoryCell::ErrorVoid};
+
+        c.aspect = aspect;
+        c.execute = wait ? AccessoryCell::Moving : AccessoryCell::Done;
+        c.wait = wait;
+        return c;
+    }
+
+    // The movement is over, false if there was none.
+    bool complete(std::uint8_t number)
+    {
+        auto &c = _cells[number];
+        if (!c.moving())
+            return false;
+        c.execute = AccessoryCell::Done;
+        c.wait = 0;
+        return true;
+    }
+
+    // A spontaneous error, false if it was reported already.
+    bool fail(std::uint8_t number, std::uint8_t error)
+    {
+        auto &c = _cells[number];
+        AccessoryCell failed{c.aspect, c.total, AccessoryCell::Error, error};
+        if (c == failed)
+            return false;
+        c = failed;
+        return true;
+    }
+
+    auto begin() const { return _cells.cbegin(); }
+    auto end() const { return _cells.cend(); }
+
+private:
+    std::vector<AccessoryCell> _cells;
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <bidib/error.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <expected.hpp>
+
+namespace Bd::Core {
+
+// Node address as a stack of up to four node numbers, the first byte on the wire being the
+// least significant one.
+class Address
+{
+public:
+    static constexpr std::size_t MaxDepth = 4;
+
+    constexpr Address() = default;
+
+    constexpr explicit Address(std::uint32_t stack)
+        : _stack(stack)
+    {}
+
+    static constexpr Address localNode() { return {}; }
+
+    constexpr std::uint32_t stack() const { return _stack; }
+
+    constexpr std::size_t size() const
+    {
+        if (_stack & 0xff000000)
+            return 4;
+        if (_stack & 0xff0000)
+            return 3;
+        if (_stack & 0xff00)
+            return 2;
+        if (_stack & 0xff)
+            return 1;
+        return 0;
+    }
+
+    constexpr bool isLocalNode() const { return _stack == 0; }
+
+    tl::expected<std::uint8_t, Error> downstream()
+    {
+        if (isLocalNode())
+            return tl::make_unexpected(Error::AddressStackEmpty);
+        auto node = static_cast<std::uint8_t>(_stack & 0xff);
+        _stack >>= 8;
+        return node;
+    }
+
+    tl::expected<void, Error> upstream(std::uint8_t node)
+    {
+        if (size() == MaxDepth)
+            return tl::make_unexpected(Error::AddressStackFull);
+        _stack = (_stack << 8) | node;
+        return {};
+    }
+
+    constexpr bool operator==(Address const &rhs) const = default;
+
+    // Writes the address bytes and the terminating zero, out must hold at least size() + 1 bytes.
+    constexpr std::size_t encode(std::span<std::byte> out) const
+    {
+        auto n = size();
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = std::byte((_stack >> (8 * i)) & 0xff);
+        out[n] = std::byte{0};
+        return n + 1;
+    }
+
+    static tl::expected<Address, Error> parse(std::span<const std::byte> bytes)
+    {
+        if (bytes.empty())
+            return tl::make_unexpected(Error::OutOfData);
+        auto end = std::find(bytes.begin(), bytes.end(), std::byte{0});
+        if (end == bytes.end())
+            return tl::make_unexpected(Error::AddressMissingTerminator);
+        auto size = static_cast<std::size_t>(end - bytes.begin());
+        if (size > MaxDepth)
+            return tl::make_unexpected(Error::AddressTooLong);
+
+        std::uint32_t stack = 0;
+        for (std::size_t i = 0; i < size; ++i)
+            stack |= std::to_integer<std::uint32_t>(bytes[i]) << (8 * i);
+        return Address(stack);
+    }
+
+private:
+    std::uint32_t _stack{};
+};
+
+// One detector section of an occupancy node, packed into one integer as node address and
+// section number, e.g. as a hash key.
+class SectionKey
+{
+public:
+    constexpr SectionKey() = default;
+
+    constexpr SectionKey(Address node, std::uint8_t section)
+        : _key(std::uint64_t(node.stack()) << 8 | section)
+    {}
+
+    static constexpr SectionKey fromPacked(std::uint64_t key)
+    {
+        SectionKey s;
+        s._key = key;
+        return s;
+    }
+
+    constexpr Address node() const { return Address(std::uint32_t(_key >> 8)); }
+    constexpr std::uint8_t section() const { return std::uint8_t(_key); }
+    constexpr std::uint64_t packed() const { return _key; }
+
+    constexpr bool operator==(SectionKey const &rhs) const = default;
+
+private:
+    std::uint64_t _key{};
+};
+
+} // namespace Bd::Core
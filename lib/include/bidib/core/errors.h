@@ -0,0 +1,84 @@
+#pragma once
+
+#include <bidib/error.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Bd::Core {
+
+inline constexpr std::size_t ErrorCount = static_cast<std::size_t>(Error::NotAvailable) + 1;
+
+// Per error code counters. Written by the decoder, readable from any thread.
+class ErrorCounters
+{
+public:
+    void count(Error error)
+    {
+        _counters[static_cast<std::size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count(Error error) const
+    {
+        return _counters[static_cast<std::size_t>(error)].load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t total() const
+    {
+        std::uint64_t sum = 0;
+        for (auto const &c : _counters)
+            sum += c.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    void reset()
+    {
+        for (auto &c : _counters)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, ErrorCount> _counters{};
+};
+
+// Token bucket deciding which errors are worth capturing: up to burst samples at once, refilled
+// with one token per interval.
+class SampleLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SampleLimiter(std::uint32_t burst, Clock::duration interval)
+        : _burst(burst)
+        , _tokens(burst)
+        , _interval(std::max(interval, Clock::duration(1)))
+    {}
+
+    bool admit(Clock::time_point now)
+    {
+        if (_tokens == _burst) {
+            _last = now;
+        } else if (auto refill = (now - _last) / _interval; refill > 0) {
+            _tokens = static_cast<std::uint32_t>(
+                std::min<std::int64_t>(_burst, _tokens + static_cast<std::int64_t>(refill)));
+            _last += refill * _interval;
+        }
+
+        if (_tokens == 0)
+            return false;
+        --_tokens;
+        return true;
+    }
+
+private:
+    std::uint32_t _burst;
+    std::uint32_t _tokens;
+    Clock::duration _interval;
+    Clock::time_point _last{};
+};
+
+} // namespace Bd::Core
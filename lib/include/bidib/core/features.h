@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <utility>
+
+namespace Bd::Core {
+
+// Feature values of a node, indexed by feature number. A presence bitmap tells which features
+// exist, iteration scans it in feature number order.
+class FeatureTable
+{
+public:
+    struct Entry
+    {
+        std::uint8_t id;
+        std::uint8_t value;
+
+        constexpr bool operator==(Entry const &rhs) const = default;
+    };
+
+    class Iterator
+    {
+    public:
+        constexpr Entry operator*() const { return {std::uint8_t(_id), _table->_values[_id]}; }
+
+        constexpr Iterator &operator++()
+        {
+            _id = _table->nextId(_id + 1);
+            return *this;
+        }
+
+        constexpr bool operator==(Iterator const &rhs) const { return _id == rhs._id; }
+
+    private:
+        friend class FeatureTable;
+
+        constexpr Iterator(FeatureTable const *table, std::size_t id)
+            : _table(table)
+            , _id(id)
+        {}
+
+        FeatureTable const *_table;
+        std::size_t _id;
+    };
+
+    constexpr FeatureTable() = default;
+
+    constexpr FeatureTable(std::initializer_list<Entry> entries)
+    {
+        for (auto e : entries)
+            set(e.id, e.value);
+    }
+
+    constexpr bool contains(std::uint8_t id) const
+    {
+        return _present[id / 64] & (std::uint64_t(1) << (id % 64));
+    }
+
+    constexpr std::optional<std::uint8_t> value(std::uint8_t id) const
+    {
+        if (!contains(id))
+            return std::nullopt;
+        return _values[id];
+    }
+
+    constexpr std::uint8_t value(std::uint8_t id, std::uint8_t defaultValue) const
+    {
+        return contains(id) ? _values[id] : defaultValue;
+    }
+
+    // Adds the feature or overwrites its value.
+    constexpr void set(std::uint8_t id, std::uint8_t value)
+    {
+        _present[id / 64] |= std::uint64_t(1) << (id % 64);
+        _values[id] = value;
+    }
+
+    // Changes an existing feature only, returns false if the node does not have it.
+    constexpr bool update(std::uint8_t id, std::uint8_t value)
+    {
+        if (!contains(id))
+            return false;
+        _values[id] = value;
+        return true;
+    }
+
+    constexpr void remove(std::uint8_t id)
+    {
+        _present[id / 64] &= ~(std::uint64_t(1) << (id % 64));
+        _values[id] = 0;
+    }
+
+    constexpr std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (auto word : _present)
+            n += std::popcount(word);
+        return n;
+    }
+
+    constexpr bool empty() const { return size() == 0; }
+
+    // First feature number >= from, nullopt past the last one.
+    constexpr std::optional<std::uint8_t> next(std::size_t from) const
+    {
+        auto id = nextId(from);
+        if (id == 256)
+            return std::nullopt;
+        return std::uint8_t(id);
+    }
+
+    constexpr Iterator begin() const { return {this, nextId(0)}; }
+    constexpr Iterator end() const { return {this, 256}; }
+
+    constexpr bool operator==(FeatureTable const &rhs) const = default;
+
+private:
+    constexpr std::size_t nextId(std::size_t from) const
+    {
+        for (auto word = from / 64; word < _present.size(); ++word) {
+            auto bits = _present[word];
+            if (word == from / 64)
+                bits &= ~std::uint64_t(0) << (from % 64);
+            if (bits)
+                return word * 64 + std::countr_zero(bits);
+        }
+        return 256;
+    }
+
+    std::array<std::uint64_t, 4> _present{};
+    std::array<std::uint8_t, 256> _values{};
+};
+
+} // namespace Bd::Core
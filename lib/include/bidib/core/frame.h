@@ -0,0 +1,132 @@
+#pragma once
+
+#include <bidib/bidib_messages.h>
+#include <bidib/core/crc.h>
+#include <bidib/core/message.h>
+#include <bidib/error.h>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace Bd::Core {
+
+inline constexpr std::size_t MaxFrameSize = 256;
+
+// Receives the output of the decoder. All views are only valid during the call.
+template<typename T>
+concept FrameSink = requires(T &sink,
+                             std::span<const std::byte> bytes,
+                             MessageView const &msg,
+                             Error error) {
+    sink.frame(bytes);
+    sink.message(msg);
+    sink.error(error, bytes);
+};
+
+// Checks the checksum of an unescaped frame and passes each contained message to the sink.
+template<FrameSink Sink>
+void decodeFrame(std::span<const std::byte> frame, Sink &sink)
+{
+    if (frame.empty())
+        // empty frame is no error
+        return;
+
+    if (crc8(frame) != 0) {
+        sink.error(Error::BadChecksum, frame);
+        return;
+    }
+
+    // the last byte contains the checksum
+    auto data = frame.first(frame.size() - 1);
+
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        auto len = std::to_integer<std::size_t>(data[pos]);
+
+        auto msgData = data.subspan(pos + 1, std::min(len, data.size() - pos - 1));
+        if (msgData.size() < len) {
+            sink.error(Error::OutOfData, msgData);
+            return;
+        }
+
+        if (auto msg = parseMessage(msgData))
+            sink.message(*msg);
+        else
+            sink.error(msg.error(), msgData);
+
+        pos += len + 1;
+    }
+}
+
+// Splits a serial byte stream into frames, unescapes them in place and decodes them without
+// allocating. Bytes before the first frame delimiter are skipped.
+template<std::size_t Capacity = MaxFrameSize>
+class FrameDecoder
+{
+public:
+    template<FrameSink Sink>
+    void feed(std::span<const std::byte> data, Sink &sink)
+    {
+        for (auto b : data) {
+            auto c = std::to_integer<std::uint8_t>(b);
+            if (c == BIDIB_PKT_MAGIC) {
+                finishFrame(sink);
+                continue;
+            }
+            if (!_synchronized)
+                continue;
+            if (c == BIDIB_PKT_ESCAPE) {
+                _escape = true;
+                continue;
+            }
+            if (_escape) {
+                _escape = false;
+                c ^= 0x20;
+            }
+            if (_size < Capacity)
+                _buffer[_size++] = std::byte{c};
+            else
+                _overflow = true;
+        }
+    }
+
+    void reset()
+    {
+        _size = 0;
+        _escape = false;
+        _overflow = false;
+        _synchronized = false;
+    }
+
+private:
+    template<FrameSink Sink>
+    void finishFrame(Sink &sink)
+    {
+        auto frame = std::span<const std::byte>(_buffer.data(), _size);
+        if (_overflow)
+            sink.error(Error::MessageTooLarge, frame);
+        else if (_escape)
+            sink.error(Error::EscapingIncomplete, frame);
+        else if (!frame.empty()) {
+            sink.frame(frame);
+            decodeFrame(frame, sink);
+        }
+
+        _size = 0;
+        _escape = false;
+        _overflow = false;
+        _synchronized = true;
+    }
+
+    std::array<std::byte, Capacity> _buffer{};
+    std::size_t _size{};
+    bool _escape{};
+    bool _overflow{};
+    bool _synchronized{};
+};
+
+} // namespace Bd::Core
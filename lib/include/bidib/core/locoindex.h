@@ -0,0 +1,119 @@
+#pragma once
+
+#include <bidib/core/address.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Bd::Core {
+
+// Where the locos are: loco address to the sections detecting it and section to the locos it
+// detects, both kept up to date with every report so that neither direction needs a scan. A
+// loco is seen by a section or two and a section sees a few locos at most, so the sets are
+// small vectors and an update costs two hash lookups plus a few compares.
+//
+// Updates report each loco entering or leaving a section to a callback,
+// changed(loco, section, entered).
+class LocoIndex
+{
+public:
+    // All locos the section detects now, as in MSG_BM_ADDRESS, replacing what it detected before.
+    template<typename F>
+    void assign(SectionKey section, std::span<std::uint16_t const> locos, F &&changed)
+    {
+        auto it = _locos.try_emplace(section.packed()).first;
+        auto &current = it->second;
+        for (std::size_t i = 0; i < current.size();) {
+            auto loco = current[i];
+            if (std::find(locos.begin(), locos.end(), loco) != locos.end()) {
+                ++i;
+                continue;
+            }
+            current[i] = current.back();
+            current.pop_back();
+            leave(loco, section);
+            changed(loco, section, false);
+        }
+        for (auto loco : locos) {
+            if (std::find(current.begin(), current.end(), loco) != current.end())
+                continue;
+            current.push_back(loco);
+            _sections[loco].push_back(section);
+            changed(loco, section, true);
+        }
+        if (current.empty())
+            _locos.erase(it);
+    }
+
+    // The section detects nothing anymore, as in MSG_BM_FREE.
+    template<typename F>
+    void clear(SectionKey section, F &&changed)
+    {
+        auto it = _locos.find(section.packed());
+        if (it == _locos.end())
+            return;
+        auto locos = std::move(it->second);
+        _locos.erase(it);
+        for (auto loco : locos) {
+            leave(loco, section);
+            changed(loco, section, false);
+        }
+    }
+
+    // Drops all sections of the node, e.g. when it is lost. Scans all occupied sections.
+    template<typename F>
+    void clearNode(Address node, F &&changed)
+    {
+        std::vector<SectionKey> sections;
+        for (auto const &[key, locos] : _locos) {
+            if (SectionKey::fromPacked(key).node() == node)
+                sections.push_back(SectionKey::fromPacked(key));
+        }
+        for (auto s : sections)
+            clear(s, changed);
+    }
+
+    std::span<SectionKey const> sections(std::uint16_t loco) const
+    {
+        auto it = _sections.find(loco);
+        if (it == _sections.end())
+            return {};
+        return it->second;
+    }
+
+    std::span<std::uint16_t const> locos(SectionKey section) const
+    {
+        auto it = _locos.find(section.packed());
+        if (it == _locos.end())
+            return {};
+        return it->second;
+    }
+
+    // Locos detected anywhere.
+    std::size_t size() const { return _sections.size(); }
+
+private:
+    void leave(std::uint16_t loco, SectionKey section)
+    {
+        auto it = _sections.find(loco);
+        if (it == _sections.end())
+            return;
+        auto &sections = it->second;
+        auto s = std::find(sections.begin(), sections.end(), section);
+        if (s != sections.end()) {
+            *s = sections.back();
+            sections.pop_back();
+        }
+        if (sections.empty())
+            _sections.erase(it);
+    }
+
+    std::unordered_map<std::uint16_t, std::vector<SectionKey>> _sections;
+    std::unordered_map<std::uint64_t, std::vector<std::uint16_t>> _locos;
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <bidib/core/timerwheel.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Bd::Core {
+
+// One step of a light control macro as in MSG_LC_MACRO_SET: a port and the state to put it in,
+// or with 0xff for the port's first byte a system function with the opcode in state and its
+// argument in the second byte. The next step follows delay ticks later.
+struct MacroStep
+{
+    static constexpr std::uint8_t System = 0xff;
+
+    std::uint8_t delay;
+    std::uint8_t port[2];
+    std::uint8_t state;
+
+    constexpr bool system() const { return port[0] == System; }
+    constexpr std::uint16_t address() const { return std::uint16_t(port[0] | port[1] << 8); }
+
+    constexpr bool operator==(MacroStep const &rhs) const = default;
+};
+static_assert(sizeof(MacroStep) == 4);
+
+// The macros of one light control node, run from a single tick count: steps are stored four
+// bytes each in one table, parameters next to them, and running macros wait in a TimerWheel for
+// the tick their next step is due, so idle ticks and idle macros cost nothing. The caller
+// decides what a tick is, BiDiB nodes use 20 ms.
+//
+// Within one tick, steps without delay run back to back, at most length() of them.
+class MacroEngine
+{
+public:
+    // BIDIB_MSYS_* opcodes of system steps
+    enum Opcode : std::uint8_t {
+        DelayFixed = 244,
+        StopMacro = 253,
+        StartMacro = 254,
+        EndOfMacro = 255,
+    };
+
+    // BIDIB_MACRO_PARA_* indices
+    enum Parameter : std::uint8_t {
+        Slowdown = 1,
+        Repeat = 2,
+        StartClock = 3,
+    };
+    static constexpr std::size_t Parameters = 4;
+
+    static constexpr MacroStep End{0, {MacroStep::System, 0}, EndOfMacro};
+
+    MacroEngine() = default;
+
+    MacroEngine(std::size_t count, std::size_t length)
+        : _length(length)
+        , _steps(count * length, End)
+        , _saved(count * length, End)
+        , _parameters(count, DefaultParameters)
+        , _savedParameters(count, DefaultParameters)
+        , _runs(count)
+    {}
+
+    std::size_t count() const { return _runs.size(); }
+    std::size_t length() const { return _length; }
+    bool contains(std::uint8_t macro, std::uint8_t item = 0) const
+    {
+        return macro < count() && item < _length;
+    }
+
+    MacroStep step(std::uint8_t macro, std::uint8_t item) const
+    {
+        return _steps[macro * _length + item];
+    }
+
+    // A running macro picks the change up when it gets to the step.
+    void setStep(std::uint8_t macro, std::uint8_t item, MacroStep step)
+    {
+        _steps[macro * _length + item] = step;
+    }
+
+    // Unknown parameters read as 0xffffffff and cannot be set.
+    std::uint32_t parameter(std::uint8_t macro, std::uint8_t index) const
+    {
+        return index > 0 && index < Parameters ? _parameters[macro][index] : 0xffffffff;
+    }
+
+    bool setParameter(std::uint8_t macro, std::uint8_t index, std::uint32_t value)
+    {
+        if (index == 0 || index >= Parameters)
+            return false;
+        _parameters[macro][index] = value;
+        return true;
+    }
+
+    bool running(std::uint8_t macro) const { return _runs[macro].timer != 0; }
+    std::size_t active() const { return _wheel.size(); }
+
+    // Starts the macro from its first step at tick, or at the next tick advance() processes if
+    // that is later. A running macro starts over.
+    void start(std::uint8_t macro, std::uint64_t tick)
+    {
+        auto &r = _runs[macro];
+        _wheel.cancel(r.timer);
+        r.item = 0;
+        r.pass = 1;
+        r.timer = _wheel.schedule(std::max(tick, _wheel.now()), macro);
+    }
+
+    // False if it was not running.
+    bool stop(std::uint8_t macro)
+    {
+        auto &r = _runs[macro];
+        if (!_wheel.cancel(r.timer))
+            return false;
+        r.timer = 0;
+        return true;
+    }
+
+    // Stops the macro and empties it.
+    void remove(std::uint8_t macro)
+    {
+        stop(macro);
+        std::fill_n(_steps.begin() + macro * _length, _length, End);
+        _parameters[macro] = DefaultParameters;
+    }
+
+    // Keeps a copy of steps and parameters as a node keeps them in its permanent storage.
+    void save(std::uint8_t macro)
+    {
+        std::copy_n(_steps.begin() + macro * _length, _length, _saved.begin() + macro * _length);
+        _savedParameters[macro] = _parameters[macro];
+    }
+
+    // Stops the macro and goes back to the saved copy.
+    void restore(std::uint8_t macro)
+    {
+        stop(macro);
+        std::copy_n(_saved.begin() + macro * _length, _length, _steps.begin() + macro * _length);
+        _parameters[macro] = _savedParameters[macro];
+    }
+
+    // The next tick advance() processes.
+    std::uint64_t now() const { return _wheel.now(); }
+
+    // Runs all steps due up to and including tick. Port steps go to output(macro, address,
+    // state), macros ending on their own or stopped by a step to stopped(macro).
+    template<typename Output, typename Stopped>
+    void advance(std::uint64_t tick, Output &&output, Stopped &&stopped)
+    {
+        _wheel.advance(tick, [&](std::uint8_t macro) { run(macro, output, stopped); });
+    }
+
+private:
+    static constexpr std::array<std::uint32_t, Parameters> DefaultParameters{0, 1, 1, 0xffffffff};
+
+    struct Run
+    {
+        TimerWheel<std::uint8_t>::Id timer{};
+        std::uint8_t item{};
+        std::uint32_t pass{};
+    };
+
+    template<typename Output, typename Stopped>
+    void run(std::uint8_t macro, Output &output, Stopped &stopped)
+    {
+        auto &r = _runs[macro];
+        // this timer is done, every way out below either ends the run or schedules the next one
+        r.timer = 0;
+        auto slowdown = std::max<std::uint32_t>(_parameters[macro][Slowdown], 1);
+        auto now = _wheel.now();
+
+        for (std::size_t n = 0; n < _length; ++n) {
+            auto s = step(macro, r.item);
+            std::uint32_t wait = s.delay;
+            r.item = std::uint8_t((r.item + 1) % _length);
+
+            if (!s.system()) {
+                output(macro, s.address(), s.state);
+            } else if (s.state == EndOfMacro) {
+                // 0 repeats forever, n runs n times
+                auto repeat = _parameters[macro][Repeat];
+                if (repeat != 0 && r.pass >= repeat) {
+                    stopped(macro);
+                    return;
+                }
+                ++r.pass;
+                r.item = 0;
+            } else if (s.state == StartMacro && s.port[1] != macro && s.port[1] < count()) {
+                start(s.port[1], now);
+            } else if (s.state == StopMacro && s.port[1] < count()) {
+                if (s.port[1] == macro) {
+                    stopped(macro);
+                    return;
+                }
+                if (stop(s.port[1]))
+                    stopped(s.port[1]);
+            } else if (s.state == DelayFixed) {
+                wait += s.port[1];
+            }
+
+            if (wait > 0) {
+                r.timer = _wheel.schedule(now + wait * slowdown, macro);
+                return;
+            }
+        }
+        // a whole pass without delay, go on with the next tick
+        r.timer = _wheel.schedule(now + 1, macro);
+    }
+
+    std::size_t _length{};
+    std::vector<MacroStep> _steps;
+    std::vector<MacroStep> _saved;
+    std::vector<std::array<std::uint32_t, Parameters>> _parameters;
+    std::vector<std::array<std::uint32_t, Parameters>> _savedParameters;
+    std::vector<Run> _runs;
+    TimerWheel<std::uint8_t> _wheel;
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <bidib/core/address.h>
+#include <bidib/error.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <expected.hpp>
+
+namespace Bd::Core {
+
+// Largest value of the length byte, i.e. a message occupies at most 64 bytes on the wire.
+inline constexpr std::size_t MaxMessageSize = 63;
+
+// A decoded message referring to the bytes of the frame it was parsed from.
+struct MessageView
+{
+    Address address;
+    std::uint8_t num{};
+    std::uint8_t type{};
+    std::span<const std::byte> payload;
+};
+
+// Parses the message data following the length byte.
+inline tl::expected<MessageView, Error> parseMessage(std::span<const std::byte> data)
+{
+    auto address = Address::parse(data);
+    if (!address)
+        return tl::make_unexpected(address.error());
+
+    auto i = address->size() + 1; // skip trailing zero
+    if (data.size() < i + 2)
+        return tl::make_unexpected(Error::MessageMalformed);
+
+    // TODO: implement sequence check
+    MessageView msg;
+    msg.address = *address;
+    msg.num = std::to_integer<std::uint8_t>(data[i++]);
+    msg.type = std::to_integer<std::uint8_t>(data[i++]);
+    msg.payload = data.subspan(i);
+    return msg;
+}
+
+// Encodes a message including its length byte, returns the number of bytes written to out.
+inline tl::expected<std::size_t, Error> encodeMessage(std::span<std::byte> out,
+                                                      Address address,
+                                                      std::uint8_t num,
+                                                      std::uint8_t type,
+                                                      std::span<const std::byte> payload)
+{
+    auto size = 3 + address.size() + payload.size();
+    if (size > MaxMessageSize || size + 1 > out.size())
+        return tl::make_unexpected(Error::MessageTooLarge);
+
+    std::size_t o = 0;
+    out[o++] = std::byte(size);
+    o += address.encode(out.subspan(o));
+    out[o++] = std::byte{num};
+    out[o++] = std::byte{type};
+    std::copy(payload.begin(), payload.end(), out.begin() + o);
+    return o + payload.size();
+}
+
+} // namespace Bd::Core
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <bidib/core/message.h>
+#include <bidib/error.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include <expected.hpp>
+
+namespace Bd::Core {
+
+// Fixed capacity byte buffer, the default backing store of a Packer.
+template<std::size_t Capacity>
+class FixedBuffer
+{
+public:
+    bool append(std::span<const std::byte> bytes)
+    {
+        if (bytes.size() > Capacity - _size)
+            return false;
+        std::copy(bytes.begin(), bytes.end(), _data.begin() + _size);
+        _size += bytes.size();
+        return true;
+    }
+
+    std::span<const std::byte> bytes() const { return {_data.data(), _size}; }
+
+private:
+    std::array<std::byte, Capacity> _data{};
+    std::size_t _size{};
+};
+
+// Serializes a value into a buffer. Specialize for types that are not sent as their raw bytes.
+template<typename T, typename = void>
+struct Putter
+{
+    static_assert(std::is_trivially_copyable_v<T>, "no Putter for this type");
+
+    template<typename Buffer>
+    static bool put(Buffer &buf, T const &t)
+    {
+        return buf.append(std::as_bytes(std::span(&t, 1)));
+    }
+};
+
+template<>
+struct Putter<std::string_view>
+{
+    template<typename Buffer>
+    static bool put(Buffer &buf, std::string_view s)
+    {
+        if (s.size() > 255)
+            return false;
+        return Putter<std::uint8_t>::put(buf, static_cast<std::uint8_t>(s.size()))
+               && buf.append(std::as_bytes(std::span(s)));
+    }
+};
+
+// Raw bytes, e.g. a list running up to the end of the payload.
+template<>
+struct Putter<std::span<const std::byte>>
+{
+    template<typename Buffer>
+    static bool put(Buffer &buf, std::span<const std::byte> bytes)
+    {
+        return buf.append(bytes);
+    }
+};
+
+template<typename Buffer>
+class BasicPacker
+{
+public:
+    template<class T>
+    BasicPacker &operator<<(T const &t)
+    {
+        _ok = _ok && Putter<T>::put(_buffer, t);
+        return *this;
+    }
+
+    BasicPacker &operator<<(char const *s) { return *this << std::string_view(s); }
+
+    // false if a value did not fit, everything after it has been dropped
+    bool ok() const { return _ok; }
+
+    Buffer const &buffer() const { return _buffer; }
+
+    template<class... Types>
+    static BasicPacker pack(Types const &...args)
+    {
+        BasicPacker p;
+        (void) (p << ... << args);
+        return p;
+    }
+
+private:
+    Buffer _buffer{};
+    bool _ok{true};
+};
+
+template<std::size_t Capacity = MaxMessageSize>
+using Packer = BasicPacker<FixedBuffer<Capacity>>;
+
+class Unpacker;
+
+// Deserializes a value from an Unpacker. Specialize for types that are not sent as their raw
+// bytes. A failing getter consumes all remaining data, so later optional values stay empty.
+template<typename T, typename = void>
+struct Getter
+{
+    static_assert(std::is_trivially_copyable_v<T>, "no Getter for this type");
+
+    static tl::expected<T, Error> get(Unpacker &u);
+};
+
+class Unpacker
+{
+public:
+    explicit Unpacker(std::span<const std::byte> bytes)
+        : _bytes(bytes)
+    {}
+
+    std::size_t available() const { return _bytes.size(); }
+
+    std::span<const std::byte> take(std::size_t count)
+    {
+        auto taken = _bytes.first(count);
+        _bytes = _bytes.subspan(count);
+        return taken;
+    }
+
+    void exhaust() { _bytes = {}; }
+
+    template<class T>
+    tl::expected<T, Error> get()
+    {
+        return Getter<T>::get(*this);
+    }
+
+    template<typename T>
+    tl::expected<std::tuple<T>, Error> multiget()
+    {
+        auto v = get<T>();
+        if (v)
+            return std::make_tuple(*v);
+        return tl::make_unexpected(Error::OutOfData);
+    }
+
+    template<typename T1, typename T2, typename... Args>
+    tl::expected<std::tuple<T1, T2, Args...>, Error> multiget()
+    {
+        auto v = multiget<T1>();
+        if (!v)
+            return tl::make_unexpected(v.error());
+
+        auto rest = multiget<T2, Args...>();
+        if (!rest)
+            return tl::make_unexpected(rest.error());
+
+        return std::tuple_cat(*v, *rest);
+    }
+
+    template<typename... Args>
+    static tl::expected<std::tuple<Args...>, Error> unpack(std::span<const std::byte> bytes)
+    {
+        if constexpr (sizeof...(Args) == 0) {
+            return std::tuple<>{};
+        } else {
+            // the values are extracted recursively, a fold expression would not guarantee
+            // left-to-right evaluation on every compiler
+            Unpacker u(bytes);
+            return u.multiget<Args...>();
+        }
+    }
+
+private:
+    std::span<const std::byte> _bytes;
+};
+
+template<typename T, typename X>
+tl::expected<T, Error> Getter<T, X>::get(Unpacker &u)
+{
+    if (u.available() < sizeof(T)) {
+        u.exhaust();
+        return tl::make_unexpected(Error::OutOfData);
+    }
+    T t;
+    std::memcpy(&t, u.take(sizeof(T)).data(), sizeof(T));
+    return t;
+}
+
+template<>
+struct Getter<std::string_view>
+{
+    static tl::expected<std::string_view, Error> get(Unpacker &u)
+    {
+        auto len = u.get<std::uint8_t>();
+        if (!len)
+            return tl::make_unexpected(len.error());
+        if (u.available() < *len) {
+            u.exhaust();
+            return tl::make_unexpected(Error::OutOfData);
+        }
+        auto bytes = u.take(*len);
+        return std::string_view(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+};
+
+// Everything left of the payload, possibly nothing.
+template<>
+struct Getter<std::span<const std::byte>>
+{
+    static tl::expected<std::span<const std::byte>, Error> get(Unpacker &u)
+    {
+        return u.take(u.available());
+    }
+};
+
+template<typename T>
+struct Getter<std::optional<T>>
+{
+    static tl::expected<std::optional<T>, Error> get(Unpacker &u)
+    {
+        auto val = u.get<T>();
+        if (val)
+            return *val;
+        return std::nullopt;
+    }
+};
+
+} // namespace Bd::Core
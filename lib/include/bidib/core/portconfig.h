@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Bd::Core {
+
+// One BIDIB_PCFG_* parameter of a port, its value one to four bytes wide depending on the id.
+struct PortParam
+{
+    std::uint8_t id;
+    std::uint32_t value;
+
+    constexpr bool operator==(PortParam const &rhs) const = default;
+};
+
+// Configuration of the ports of one light control node as in MSG_LC_CONFIGX, by port index as in
+// PortTable. Only ports with parameters take memory: a table from port to entry finds them in
+// constant time, so adding a port is an append. Entries stay in the order they were added;
+// walking the ports in order, the way a node answers, goes through that table instead.
+class PortConfig
+{
+    static constexpr std::uint32_t Nil = 0xffffffff;
+
+public:
+    static constexpr std::uint8_t None = 0x00;
+    static constexpr std::uint8_t Continue = 0xff;
+
+    // Bytes of the value: ids up to 0x3f carry one, every further 0x40 one more.
+    static constexpr std::size_t width(std::uint8_t id)
+    {
+        return id == Continue ? 0 : 1 + (id >> 6);
+    }
+
+    PortConfig() = default;
+    explicit PortConfig(std::size_t ports)
+        : _slots(ports, Nil)
+    {}
+
+    // Ports with parameters.
+    std::size_t size() const { return _entries.size(); }
+
+    std::span<PortParam const> params(std::uint16_t index) const
+    {
+        if (index >= _slots.size() || _slots[index] == Nil)
+            return {};
+        return _entries[_slots[index]].params;
+    }
+
+    std::optional<std::uint32_t> value(std::uint16_t index, std::uint8_t id) const
+    {
+        for (auto const &p : params(index)) {
+            if (p.id == id)
+                return p.value;
+        }
+        return std::nullopt;
+    }
+
+    void set(std::uint16_t index, PortParam param)
+    {
+        if (index >= _slots.size() || param.id == None || param.id == Continue)
+            return;
+        if (_slots[index] == Nil) {
+            _slots[index] = std::uint32_t(_entries.size());
+            _entries.push_back({index, {}});
+        }
+        auto &params = _entries[_slots[index]].params;
+        for (auto &p : params) {
+            if (p.id == param.id) {
+                p.value = param.value;
+                return;
+            }
+        }
+        params.push_back(param);
+    }
+
+    // Id and little endian value pairs as in MSG_LC_CONFIGX_SET. False without changing anything
+    // if the last value is cut short.
+    bool apply(std::uint16_t index, std::span<const std::byte> data)
+    {
+        for (std::size_t pos = 0; pos < data.size(); pos += 1 + width(std::uint8_t(data[pos]))) {
+            if (pos + 1 + width(std::uint8_t(data[pos])) > data.size())
+                return false;
+        }
+        for (std::size_t pos = 0; pos < data.size();) {
+            PortParam p{std::uint8_t(data[pos++]), 0};
+            for (std::size_t i = 0; i < width(p.id); ++i)
+                p.value |= std::uint32_t(data[pos++]) << (8 * i);
+            set(index, p);
+        }
+        return true;
+    }
+
+    // The parameters of the port in the MSG_LC_CONFIGX encoding, byte by byte.
+    template<typename Out>
+    void bytes(std::uint16_t index, Out &&out) const
+    {
+        for (auto const &p : params(index)) {
+            out(p.id);
+            for (std::size_t i = 0; i < width(p.id); ++i)
+                out(std::uint8_t(p.value >> (8 * i)));
+        }
+    }
+
+    // Calls f(index, params) for every configured port, by ascending index. Costs one compare per
+    // port of the node, a handful of bytes next to the replies it is walked for.
+    template<typename F>
+    void forEach(F &&f) const
+    {
+        for (std::size_t i = 0; i < _slots.size(); ++i) {
+            if (_slots[i] != Nil)
+                f(std::uint16_t(i), std::span<PortParam const>(_entries[_slots[i]].params));
+        }
+    }
+
+private:
+    struct Entry
+    {
+        std::uint16_t index;
+        std::vector<PortParam> params;
+    };
+
+    std::vector<std::uint32_t> _slots;
+    std::vector<Entry> _entries;
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <vector>
+
+namespace Bd::Core {
+
+// Ports of one light control node: the type and state of port i are types()[i] and
+// states()[i], the ports of each type follow each other. A port is addressed with two bytes on
+// the wire, read here as one little endian number:
+//
+//  - in the type model the low byte is the type and the high byte the number among its type,
+//  - in the flat model (FEATURE_CTRL_PORT_FLAT_MODEL) it is the index i itself.
+//
+// Lookups are constant time in both, queries only visit the ports they can match.
+class PortTable
+{
+public:
+    static constexpr std::size_t Types = 16;
+
+    struct Group
+    {
+        std::uint8_t type;
+        std::uint8_t count;
+    };
+
+    PortTable() = default;
+
+    // One group per type, in the order the ports are numbered in the flat model.
+    PortTable(std::initializer_list<Group> groups)
+    {
+        for (auto g : groups) {
+            _first[g.type] = std::uint16_t(_types.size());
+            _count[g.type] = g.count;
+            _types.insert(_types.end(), g.count, g.type);
+        }
+        _states.resize(_types.size());
+    }
+
+    std::size_t size() const { return _types.size(); }
+    std::uint8_t count(std::uint8_t type) const { return type < Types ? _count[type] : 0; }
+
+    bool flat() const { return _flat; }
+    void setFlat(bool flat) { _flat = flat; }
+
+    // Index of the port at address in the current model.
+    std::optional<std::uint16_t> find(std::uint16_t address) const
+    {
+        if (_flat)
+            return address < size() ? std::optional(address) : std::nullopt;
+        std::size_t type = address & 0xff;
+        auto number = address >> 8;
+        if (type >= Types || number >= _count[type])
+            return std::nullopt;
+        return std::uint16_t(_first[type] + number);
+    }
+
+    std::uint16_t address(std::uint16_t index) const
+    {
+        if (_flat)
+            return index;
+        auto type = _types[index];
+        return std::uint16_t(type | (index - _first[type]) << 8);
+    }
+
+    std::uint8_t type(std::uint16_t index) const { return _types[index]; }
+    std::uint8_t state(std::uint16_t index) const { return _states[index]; }
+    void set(std::uint16_t index, std::uint8_t state) { _states[index] = state; }
+
+    std::vector<std::uint8_t> const &types() const { return _types; }
+    std::vector<std::uint8_t> const &states() const { return _states; }
+
+    // MSG_LC_PORT_QUERY_ALL: calls f(address, state) for every port with its type bit set in
+    // select and its address from start up to end.
+    template<typename F>
+    void query(std::uint16_t select, std::uint16_t start, std::uint16_t end, F &&f) const
+    {
+        if (_flat) {
+            for (std::size_t i = start; i < end && i < size(); ++i) {
+                if (select >> _types[i] & 1)
+                    f(std::uint16_t(i), _states[i]);
+            }
+            return;
+        }
+        // only the selected types are visited
+        for (auto bits = std::uint32_t(select); bits; bits &= bits - 1) {
+            auto type = std::countr_zero(bits);
+            for (std::uint16_t n = 0; n < _count[type]; ++n) {
+                auto a = std::uint16_t(type | n << 8);
+                if (a >= start && a < end)
+                    f(a, _states[_first[type] + n]);
+            }
+        }
+    }
+
+private:
+    std::vector<std::uint8_t> _types;
+    std::vector<std::uint8_t> _states;
+    std::array<std::uint16_t, Types> _first{};
+    std::array<std::uint8_t, Types> _count{};
+    bool _flat{false};
+};
+
+} // namespace Bd::Core
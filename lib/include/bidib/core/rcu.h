@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Bd::Core {
+
+// Read-copy-update cell: one writer publishes immutable versions of T, readers on any thread look
+// at the current one without locks and without touching a shared reference count. Replaced
+// versions are freed once no reader can still see them, tracked with epochs: a reader announces
+// the epoch it entered in, a version retired in epoch e goes away when every active reader entered
+// after e.
+//
+// Each reading thread needs its own Reader, there are at most MaxReaders at a time.
+template<typename T>
+class Rcu
+{
+    static constexpr std::uint64_t Idle = ~std::uint64_t(0);
+
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> epoch{Idle};
+        std::atomic<bool> taken{false};
+    };
+
+public:
+    static constexpr std::size_t MaxReaders = 64;
+
+    // Access to one version, as long as the guard lives.
+    class Guard
+    {
+    public:
+        Guard(Guard &&other) noexcept
+            : _slot(std::exchange(other._slot, nullptr))
+            , _value(other._value)
+        {}
+
+        Guard(Guard const &) = delete;
+        Guard &operator=(Guard const &) = delete;
+        Guard &operator=(Guard &&) = delete;
+
+        ~Guard()
+        {
+            if (_slot)
+                _slot->store(Idle, std::memory_order_release);
+        }
+
+        T const &operator*() const { return *_value; }
+        T const *operator->() const { return _value; }
+        T const *get() const { return _value; }
+
+    private:
+        friend class Rcu;
+
+        Guard(std::atomic<std::uint64_t> *slot, T const *value)
+            : _slot(slot)
+            , _value(value)
+        {}
+
+        std::atomic<std::uint64_t> *_slot;
+        T const *_value;
+    };
+
+    class Reader
+    {
+    public:
+        // Takes a free slot of the cell, isValid() tells whether there was one.
+        explicit Reader(Rcu const &rcu)
+            : _rcu(&rcu)
+        {
+            for (auto &s : rcu._slots) {
+                bool expected = false;
+                if (s.taken.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    _slot = &s;
+                    break;
+                }
+            }
+        }
+
+        Reader(Reader const &) = delete;
+        Reader &operator=(Reader const &) = delete;
+
+        ~Reader()
+        {
+            if (_slot)
+                _slot->taken.store(false, std::memory_order_release);
+        }
+
+        bool isValid() const { return _slot != nullptr; }
+
+        // One guard per reader at a time, guards do not nest.
+        Guard lock() const
+        {
+            // announce before loading, so the writer either sees us or we see its new version
+            _slot->epoch.store(_rcu->_epoch.load(std::memory_order_seq_cst),
+                               std::memory_order_seq_cst);
+            return Guard(&_slot->epoch, _rcu->_current.load(std::memory_order_seq_cst));
+        }
+
+    private:
+        Rcu const *_rcu;
+        Slot *_slot{};
+    };
+
+    explicit Rcu(std::unique_ptr<T> initial)
+        : _current(initial.release())
+    {}
+
+    Rcu(Rcu const &) = delete;
+    Rcu &operator=(Rcu const &) = delete;
+
+    // All readers must be gone.
+    ~Rcu()
+    {
+        delete _current.load(std::memory_order_relaxed);
+        for (auto &r : _retired)
+            delete r.value;
+    }
+
+    // Writer side only: makes value the current version and frees what no reader sees anymore.
+    void publish(std::unique_ptr<T> value)
+    {
+        auto epoch = _epoch.load(std::memory_order_relaxed);
+        auto old = _current.exchange(value.release(), std::memory_order_seq_cst);
+        _retired.push_back({old, epoch});
+        _epoch.store(epoch + 1, std::memory_order_seq_cst);
+        reclaim();
+    }
+
+    // Writer side only: the current version without entering an epoch, the writer is the only
+    // one replacing it.
+    T const &current() const { return *_current.load(std::memory_order_relaxed); }
+
+    // Writer side only: frees retired versions no reader can see anymore.
+    void reclaim()
+    {
+        auto oldest = Idle;
+        for (auto const &s : _slots)
+            oldest = std::min(oldest, s.epoch.load(std::memory_order_seq_cst));
+
+        std::erase_if(_retired, [oldest](Retired const &r) {
+            if (r.epoch >= oldest)
+                return false;
+            delete r.value;
+            return true;
+        });
+    }
+
+    // Versions waiting for readers to move on.
+    std::size_t retired() const { return _retired.size(); }
+
+private:
+    struct Retired
+    {
+        T const *value;
+        std::uint64_t epoch;
+    };
+
+    std::atomic<T const *> _current;
+    alignas(64) std::atomic<std::uint64_t> _epoch{0};
+    mutable std::array<Slot, MaxReaders> _slots;
+    std::vector<Retired> _retired;
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace Bd::Core {
+
+// Broadcast ring buffer for one producer and any number of consumers, each reading at its own
+// pace through its own Cursor. The producer never waits: it overwrites the oldest entry, and a
+// consumer that fell more than Capacity entries behind notices on its next read, skips to the
+// oldest entry still there and counts what it lost.
+//
+// Entries are stored as words of relaxed atomics guarded by a per-slot sequence number (a seqlock),
+// so readers racing with the producer get either the whole entry or a retry, never a torn copy.
+template<typename T, std::size_t Capacity>
+class BroadcastRing
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(std::has_single_bit(Capacity), "capacity must be a power of 2");
+
+    static constexpr std::size_t Words = (sizeof(T) + 7) / 8;
+    static constexpr std::uint64_t Writing = ~std::uint64_t(0);
+
+public:
+    class Cursor
+    {
+    public:
+        // Copies the next entry to out, false if there is none yet.
+        bool poll(T &out)
+        {
+            for (;;) {
+                auto head = _ring->_head.load(std::memory_order_acquire);
+                if (_next == head)
+                    return false;
+                if (head - _next > Capacity)
+                    skip(head - Capacity);
+                if (_ring->read(_next, out)) {
+                    ++_next;
+                    return true;
+                }
+                // overwritten while reading, the producer is at least one lap ahead now
+                skip(_next + 1);
+            }
+        }
+
+        // Blocks until an entry after the ones already read is published.
+        void wait() const
+        {
+            auto head = _ring->_head.load(std::memory_order_acquire);
+            while (head == _next) {
+                _ring->_head.wait(head, std::memory_order_acquire);
+                head = _ring->_head.load(std::memory_order_acquire);
+            }
+        }
+
+        // Entries published but not read yet, may exceed Capacity for a slow consumer.
+        std::uint64_t backlog() const
+        {
+            return _ring->_head.load(std::memory_order_acquire) - _next;
+        }
+
+        // Entries this consumer missed because the producer overtook it.
+        std::uint64_t lost() const { return _lost; }
+
+    private:
+        friend class BroadcastRing;
+
+        Cursor(BroadcastRing const *ring, std::uint64_t next)
+            : _ring(ring)
+            , _next(next)
+        {}
+
+        void skip(std::uint64_t to)
+        {
+            _lost += to - _next;
+            _ring->_lost.fetch_add(to - _next, std::memory_order_relaxed);
+            _next = to;
+        }
+
+        BroadcastRing const *_ring;
+        std::uint64_t _next;
+        std::uint64_t _lost{};
+    };
+
+    BroadcastRing()
+    {
+        for (auto &slot : _slots)
+            slot.seq.store(Writing, std::memory_order_relaxed);
+    }
+
+    BroadcastRing(BroadcastRing const &) = delete;
+    BroadcastRing &operator=(BroadcastRing const &) = delete;
+
+    // Producer side only.
+    void publish(T const &value)
+    {
+        auto seq = _head.load(std::memory_order_relaxed);
+        auto &slot = _slots[seq & (Capacity - 1)];
+
+        std::array<std::uint64_t, Words> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+
+        slot.seq.store(Writing, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < Words; ++i)
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        slot.seq.store(seq, std::memory_order_release);
+
+        _head.store(seq + 1, std::memory_order_release);
+        _head.notify_all();
+    }
+
+    // A consumer starting with the next entry published.
+    Cursor subscribe() const { return Cursor(this, _head.load(std::memory_order_acquire)); }
+
+    std::uint64_t published() const { return _head.load(std::memory_order_acquire); }
+
+    // Sum of Cursor::lost() over all consumers.
+    std::uint64_t lost() const { return _lost.load(std::memory_order_relaxed); }
+
+    static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> seq;
+        std::array<std::atomic<std::uint64_t>, Words> words;
+    };
+
+    bool read(std::uint64_t seq, T &out) const
+    {
+        auto const &slot = _slots[seq & (Capacity - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != seq)
+            return false;
+
+        std::array<std::uint64_t, Words> words;
+        for (std::size_t i = 0; i < Words; ++i)
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq)
+            return false;
+
+        std::memcpy(&out, words.data(), sizeof(T));
+        return true;
+    }
+
+    std::array<Slot, Capacity> _slots;
+    alignas(64) std::atomic<std::uint64_t> _head{0};
+    alignas(64) mutable std::atomic<std::uint64_t> _lost{0};
+};
+
+} // namespace Bd::Core
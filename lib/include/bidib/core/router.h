@@ -0,0 +1,245 @@
+#pragma once
+
+#include <bidib/core/address.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace Bd::Core {
+
+// Set of message types, one bit per type.
+class TypeMask
+{
+public:
+    constexpr TypeMask() = default;
+
+    constexpr TypeMask(std::initializer_list<std::uint8_t> types)
+    {
+        for (auto t : types)
+            set(t);
+    }
+
+    // All types from first to last inclusive, e.g. one message class.
+    static constexpr TypeMask range(std::uint8_t first, std::uint8_t last)
+    {
+        TypeMask m;
+        for (std::size_t t = first; t <= last; ++t)
+            m.set(std::uint8_t(t));
+        return m;
+    }
+
+    static constexpr TypeMask all() { return range(0, 255); }
+
+    constexpr void set(std::uint8_t type) { _bits[type / 64] |= std::uint64_t(1) << (type % 64); }
+
+    constexpr bool test(std::uint8_t type) const
+    {
+        return _bits[type / 64] & (std::uint64_t(1) << (type % 64));
+    }
+
+    constexpr bool empty() const { return !(_bits[0] | _bits[1] | _bits[2] | _bits[3]); }
+
+    constexpr TypeMask &operator|=(TypeMask const &rhs)
+    {
+        for (std::size_t i = 0; i < _bits.size(); ++i)
+            _bits[i] |= rhs._bits[i];
+        return *this;
+    }
+
+    constexpr bool operator==(TypeMask const &rhs) const = default;
+
+private:
+    std::array<std::uint64_t, 4> _bits{};
+};
+
+// Subscriptions by message type and address prefix. The prefixes form a trie over the address
+// bytes, each trie node knowing the union of the type masks subscribed there, so routing a message
+// walks at most five trie nodes and only looks at subscribers that want its type.
+//
+// Handlers may subscribe and unsubscribe while a message is routed; a subscriber added on the way
+// may or may not see the current message, one removed on the way does not.
+template<typename Handler>
+class Router
+{
+public:
+    using Id = std::uint32_t;
+
+    // The empty prefix, i.e. the local node address, matches every message.
+    Id subscribe(TypeMask types, Address prefix, Handler handler)
+    {
+        std::uint32_t node = 0;
+        auto stack = prefix.stack();
+        for (std::size_t i = 0; i < prefix.size(); ++i)
+            node = child(node, std::uint8_t(stack >> (8 * i)), true);
+
+        std::uint32_t slot;
+        if (!_free.empty()) {
+            slot = _free.back();
+            _free.pop_back();
+        } else {
+            slot = std::uint32_t(_subscribers.size());
+            _subscribers.emplace_back();
+        }
+        auto &s = _subscribers[slot];
+        s.types = types;
+        s.handler = std::move(handler);
+        s.node = node;
+        s.id = _nextId++;
+        s.live = true;
+        s.released = false;
+
+        _trie[node].subscribers.push_back(slot);
+        _trie[node].types |= types;
+        ++_size;
+        return s.id;
+    }
+
+    bool unsubscribe(Id id)
+    {
+        for (std::uint32_t slot = 0; slot < _subscribers.size(); ++slot) {
+            auto &s = _subscribers[slot];
+            if (!s.live || s.id != id)
+                continue;
+            s.live = false;
+            s.types = {};
+            --_size;
+            // the handler may be running right now, its slot is freed once routing is done
+            if (_routing)
+                _stale = true;
+            else
+                release(slot);
+            return true;
+        }
+        return false;
+    }
+
+    std::size_t size() const { return _size; }
+
+    // Whether any subscriber wants the message, without calling anyone.
+    bool wants(Address address, std::uint8_t type) const
+    {
+        bool found = false;
+        walk(address, [&](TrieNode const &n) {
+            found = found || n.types.test(type);
+            return !found;
+        });
+        return found;
+    }
+
+    // Calls every matching handler with args, returns how many there were.
+    template<typename... Args>
+    std::size_t route(Address address, std::uint8_t type, Args const &...args)
+    {
+        std::size_t delivered = 0;
+        ++_routing;
+        std::uint32_t node = 0;
+        auto stack = address.stack();
+        for (std::size_t depth = 0;; ++depth) {
+            if (_trie[node].types.test(type)) {
+                // by index, handlers may add subscribers to this very list
+                for (std::size_t i = 0; i < _trie[node].subscribers.size(); ++i) {
+                    auto &s = _subscribers[_trie[node].subscribers[i]];
+                    if (s.live && s.types.test(type)) {
+                        s.handler(args...);
+                        ++delivered;
+                    }
+                }
+            }
+            if (depth == address.size())
+                break;
+            node = child(node, std::uint8_t(stack >> (8 * depth)), false);
+            if (node == NoNode)
+                break;
+        }
+        if (--_routing == 0 && _stale) {
+            _stale = false;
+            for (std::uint32_t slot = 0; slot < _subscribers.size(); ++slot) {
+                if (!_subscribers[slot].live && !_subscribers[slot].released)
+                    release(slot);
+            }
+        }
+        return delivered;
+    }
+
+private:
+    static constexpr std::uint32_t NoNode = 0xffffffff;
+
+    struct Subscriber
+    {
+        TypeMask types;
+        Handler handler{};
+        std::uint32_t node{};
+        Id id{};
+        bool live{false};
+        bool released{false};
+    };
+
+    struct TrieNode
+    {
+        TypeMask types; // union of the subscribers here
+        std::vector<std::uint32_t> subscribers;
+        std::vector<std::pair<std::uint8_t, std::uint32_t>> children;
+    };
+
+    std::uint32_t child(std::uint32_t node, std::uint8_t byte, bool create)
+    {
+        for (auto [b, c] : _trie[node].children) {
+            if (b == byte)
+                return c;
+        }
+        if (!create)
+            return NoNode;
+        auto c = std::uint32_t(_trie.size());
+        _trie.emplace_back();
+        _trie[node].children.emplace_back(byte, c);
+        return c;
+    }
+
+    template<typename F>
+    void walk(Address address, F &&visit) const
+    {
+        std::uint32_t node = 0;
+        auto stack = address.stack();
+        for (std::size_t depth = 0;; ++depth) {
+            if (!visit(_trie[node]) || depth == address.size())
+                return;
+            auto next = NoNode;
+            for (auto [b, c] : _trie[node].children) {
+                if (b == std::uint8_t(stack >> (8 * depth)))
+                    next = c;
+            }
+            if (next == NoNode)
+                return;
+            node = next;
+        }
+    }
+
+    void release(std::uint32_t slot)
+    {
+        auto &s = _subscribers[slot];
+        auto &n = _trie[s.node];
+        std::erase(n.subscribers, slot);
+        n.types = {};
+        for (auto other : n.subscribers)
+            n.types |= _subscribers[other].types;
+        s.handler = Handler{};
+        s.released = true;
+        _free.push_back(slot);
+    }
+
+    // a deque keeps handlers in place while new subscribers are added from within one
+    std::deque<Subscriber> _subscribers;
+    std::vector<std::uint32_t> _free;
+    std::vector<TrieNode> _trie{1};
+    Id _nextId{1};
+    std::size_t _size{};
+    int _routing{};
+    bool _stale{};
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace Bd::Core {
+
+// One bit per detector section of an occupancy node, section n is bit n. Updates work on whole
+// 64 bit words and return the sections they changed as another set, the XOR of before and after.
+class SectionSet
+{
+public:
+    static constexpr std::size_t Size = 256;
+
+    constexpr SectionSet() = default;
+
+    // Sections first up to first + count, clipped at Size.
+    static constexpr SectionSet range(std::size_t first, std::size_t count)
+    {
+        SectionSet s;
+        auto end = first + count < Size ? first + count : Size;
+        for (std::size_t w = 0; w < Words; ++w) {
+            auto lo = w * 64;
+            if (end <= lo || first >= lo + 64)
+                continue;
+            auto from = first > lo ? first - lo : 0;
+            auto to = end < lo + 64 ? end - lo : 64;
+            auto bits = to - from == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << (to - from)) - 1;
+            s._words[w] = bits << from;
+        }
+        return s;
+    }
+
+    constexpr bool test(std::uint8_t section) const
+    {
+        return _words[section / 64] >> (section % 64) & 1;
+    }
+
+    // Returns the changed section, if any.
+    constexpr SectionSet set(std::uint8_t section, bool occupied)
+    {
+        SectionSet bit;
+        bit._words[section / 64] = std::uint64_t(1) << (section % 64);
+        return assign(bit, occupied ? bit : SectionSet{});
+    }
+
+    // Replaces the sections in mask with those of value, returns the ones that changed.
+    constexpr SectionSet assign(SectionSet const &mask, SectionSet const &value)
+    {
+        SectionSet changed;
+        for (std::size_t w = 0; w < Words; ++w) {
+            auto next = (_words[w] & ~mask._words[w]) | (value._words[w] & mask._words[w]);
+            changed._words[w] = _words[w] ^ next;
+            _words[w] = next;
+        }
+        return changed;
+    }
+
+    // Applies a MSG_BM_MULTIPLE style bitfield: count sections from first on, LSB first in the
+    // bytes of data. Returns the sections that changed.
+    constexpr SectionSet assign(std::size_t first,
+                                std::size_t count,
+                                std::uint8_t const *data,
+                                std::size_t size)
+    {
+        auto mask = range(first, count);
+        SectionSet value;
+        for (std::size_t i = 0; i < size && first + 8 * i < Size; ++i) {
+            auto pos = first + 8 * i;
+            value._words[pos / 64] |= std::uint64_t(data[i]) << (pos % 64);
+            // a byte not starting on a byte boundary may spill into the next word
+            if (pos % 64 > 56 && pos / 64 + 1 < Words)
+                value._words[pos / 64 + 1] |= std::uint64_t(data[i]) >> (64 - pos % 64);
+        }
+        return assign(mask, value);
+    }
+
+    constexpr bool empty() const { return !(_words[0] | _words[1] | _words[2] | _words[3]); }
+
+    constexpr std::size_t count() const
+    {
+        std::size_t n = 0;
+        for (auto w : _words)
+            n += std::popcount(w);
+        return n;
+    }
+
+    // Calls f with every section in the set, in ascending order.
+    template<typename F>
+    constexpr void forEach(F &&f) const
+    {
+        for (std::size_t w = 0; w < Words; ++w) {
+            for (auto bits = _words[w]; bits; bits &= bits - 1)
+                f(std::uint8_t(w * 64 + std::countr_zero(bits)));
+        }
+    }
+
+    // Bytes LSB first as in MSG_BM_MULTIPLE, count sections from first on, first a multiple of 8.
+    template<typename Out>
+    constexpr void bytes(std::size_t first, std::size_t count, Out &&out) const
+    {
+        for (std::size_t pos = first; pos < first + count && pos < Size; pos += 8)
+            out(std::uint8_t(_words[pos / 64] >> (pos % 64)));
+    }
+
+    constexpr SectionSet &operator&=(SectionSet const &rhs)
+    {
+        for (std::size_t w = 0; w < Words; ++w)
+            _words[w] &= rhs._words[w];
+        return *this;
+    }
+
+    constexpr SectionSet &operator|=(SectionSet const &rhs)
+    {
+        for (std::size_t w = 0; w < Words; ++w)
+            _words[w] |= rhs._words[w];
+        return *this;
+    }
+
+    friend constexpr SectionSet operator&(SectionSet lhs, SectionSet const &rhs)
+    {
+        return lhs &= rhs;
+    }
+
+    friend constexpr SectionSet operator|(SectionSet lhs, SectionSet const &rhs)
+    {
+        return lhs |= rhs;
+    }
+
+    constexpr bool operator==(SectionSet const &rhs) const = default;
+
+private:
+    static constexpr std::size_t Words = Size / 64;
+
+    std::array<std::uint64_t, Words> _words{};
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Bd::Core {
+
+// Hierarchical timer wheel: four levels of 64 slots, level n covering 64^(n+1) ticks. A timer
+// goes into the slot of the coarsest level it fits and moves down a level each time the finer
+// levels wrap around, so inserting and cancelling are constant time and advancing costs one
+// slot per tick plus the timers due. Timers further out than 64^4 ticks wait in the top level
+// and are placed again when they come around.
+//
+// Handlers may schedule and cancel timers, also themselves, while being called.
+template<typename Handler>
+class TimerWheel
+{
+    static constexpr std::size_t Bits = 6;
+    static constexpr std::size_t Slots = std::size_t(1) << Bits;
+    static constexpr std::size_t Levels = 4;
+    static constexpr std::uint32_t Nil = 0xffffffff;
+
+public:
+    // Generation in the upper half and timer index in the lower half, never 0.
+    using Id = std::uint64_t;
+
+    // Calls handler once at tick, or at tick and then every period ticks until cancelled.
+    // A tick already passed counts as the next one.
+    Id schedule(std::uint64_t tick, Handler handler, std::uint64_t period = 0)
+    {
+        std::uint32_t index;
+        if (_free != Nil) {
+            index = _free;
+            _free = _timers[index].next;
+        } else {
+            index = std::uint32_t(_timers.size());
+            _timers.emplace_back();
+        }
+        auto &t = _timers[index];
+        t.handler = std::move(handler);
+        t.period = period;
+        t.state = Pending;
+        ++_size;
+        insert(index, tick);
+        return id(index);
+    }
+
+    // False if the timer already went off for good or was cancelled before.
+    bool cancel(Id timer)
+    {
+        auto index = std::uint32_t(timer);
+        if (index >= _timers.size() || id(index) != timer)
+            return false;
+        auto &t = _timers[index];
+        switch (t.state) {
+        case Pending:
+            unlink(index);
+            release(index);
+            return true;
+        case Firing:
+            // released once its handler returns
+            t.state = Cancelled;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Runs everything due up to and including tick, calling fire(handler) for each timer. Ticks
+    // with nothing to do are skipped over.
+    template<typename F>
+    void advance(std::uint64_t tick, F &&fire)
+    {
+        while (_now <= tick) {
+            auto next = nextTick();
+            if (!next || *next > tick) {
+                _now = tick + 1;
+                return;
+            }
+            _now = std::max(_now, *next);
+
+            auto slot = _now & (Slots - 1);
+            // the finer levels wrapped around, move the next slot of each coarser level down
+            for (std::size_t level = 1; slot == 0 && level < Levels; ++level) {
+                auto upper = (_now >> (Bits * level)) & (Slots - 1);
+                cascade(level, upper);
+                if (upper != 0)
+                    break;
+            }
+            while (_slots[0][slot].head != Nil)
+                run(_slots[0][slot].head, fire);
+            ++_now;
+        }
+    }
+
+    // The earliest tick anything may become due at, either a timer or a slot to cascade.
+    std::optional<std::uint64_t> nextTick() const
+    {
+        std::optional<std::uint64_t> next;
+        for (std::size_t level = 0; level < Levels; ++level) {
+            auto bits = _occupied[level];
+            if (!bits)
+                continue;
+            auto shift = Bits * level;
+            auto current = (_now >> shift) & (Slots - 1);
+            // level 0 slots are due at their own tick, coarser ones when they cascade, the current
+            // one only if that is the tick about to be processed
+            auto aligned = (_now & ((std::uint64_t(1) << shift) - 1)) == 0;
+            auto from = level == 0 || aligned ? current : current + 1;
+            auto distance = std::countr_zero(std::rotr(bits, int(from % Slots))) + from - current;
+            auto tick = level == 0 ? _now + distance : ((_now >> shift) + distance) << shift;
+            if (!next || tick < *next)
+                next = tick;
+        }
+        return next;
+    }
+
+    // The next tick advance() will process.
+    std::uint64_t now() const { return _now; }
+    std::size_t size() const { return _size; }
+
+private:
+    enum State : std::uint8_t {
+        Free,
+        Pending,
+        Firing,
+        Cancelled,
+    };
+
+    struct Timer
+    {
+        Handler handler{};
+        std::uint64_t expiry{};
+        std::uint64_t period{};
+        std::uint32_t prev{Nil};
+        std::uint32_t next{Nil};
+        std::uint32_t generation{1};
+        std::uint8_t level{};
+        std::uint8_t slot{};
+        State state{Free};
+    };
+
+    struct Slot
+    {
+        std::uint32_t head{Nil};
+    };
+
+    Id id(std::uint32_t index) const
+    {
+        return Id(_timers[index].generation) << 32 | index;
+    }
+
+    void insert(std::uint32_t index, std::uint64_t expiry)
+    {
+        auto &t = _timers[index];
+        t.expiry = expiry < _now ? _now : expiry;
+        auto delta = t.expiry - _now;
+
+        std::size_t level = 0;
+        while (level + 1 < Levels && delta >= (std::uint64_t(1) << (Bits * (level + 1))))
+            ++level;
+        auto at = t.expiry;
+        // too far out for the wheel: park in the last slot of the top level, placed again there
+        if (delta >= (std::uint64_t(1) << (Bits * Levels)))
+            at = _now + (std::uint64_t(Slots - 1) << (Bits * (Levels - 1)));
+        auto slot = (at >> (Bits * level)) & (Slots - 1);
+
+        auto &s = _slots[level][slot];
+        t.level = std::uint8_t(level);
+        t.slot = std::uint8_t(slot);
+        t.prev = Nil;
+        t.next = s.head;
+        if (s.head != Nil)
+            _timers[s.head].prev = index;
+        s.head = index;
+        _occupied[level] |= std::uint64_t(1) << slot;
+    }
+
+    void unlink(std::uint32_t index)
+    {
+        auto &t = _timers[index];
+        auto &s = _slots[t.level][t.slot];
+        if (t.prev != Nil)
+            _timers[t.prev].next = t.next;
+        else
+            s.head = t.next;
+        if (t.next != Nil)
+            _timers[t.next].prev = t.prev;
+        if (s.head == Nil)
+            _occupied[t.level] &= ~(std::uint64_t(1) << t.slot);
+    }
+
+    void release(std::uint32_t index)
+    {
+        auto &t = _timers[index];
+        t.handler = Handler{};
+        t.state = Free;
+        ++t.generation;
+        t.next = _free;
+        _free = index;
+        --_size;
+    }
+
+    void cascade(std::size_t level, std::size_t slot)
+    {
+        auto index = std::exchange(_slots[level][slot].head, Nil);
+        _occupied[level] &= ~(std::uint64_t(1) << slot);
+        while (index != Nil) {
+            auto next = _timers[index].next;
+            insert(index, _timers[index].expiry);
+            index = next;
+        }
+    }
+
+    template<typename F>
+    void run(std::uint32_t index, F &fire)
+    {
+        unlink(index);
+        _timers[index].state = Firing;
+        // handlers may schedule timers, which can move the timer table
+        auto handler = std::move(_timers[index].handler);
+        fire(handler);
+
+        auto &t = _timers[index];
+        if (t.state == Firing && t.period > 0) {
+            t.handler = std::move(handler);
+            t.state = Pending;
+            insert(index, t.expiry + t.period);
+        } else {
+            release(index);
+        }
+    }
+
+    std::vector<Timer> _timers;
+    std::array<std::array<Slot, Slots>, Levels> _slots{};
+    std::array<std::uint64_t, Levels> _occupied{};
+    std::uint32_t _free{Nil};
+    std::size_t _size{};
+    std::uint64_t _now{};
+};
+
+} // namespace Bd::Core
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+namespace Bd::Core {
+
+// One value or, at a coarser resolution, the values of one interval starting at time.
+struct SeriesPoint
+{
+    std::int64_t time;
+    std::int32_t min;
+    std::int32_t max;
+    std::int32_t mean;
+
+    constexpr bool operator==(SeriesPoint const &rhs) const = default;
+};
+
+// Points of one resolution, compressed into blocks as they come in: every point is stored as
+// the delta to the one before, zigzag and varint encoded, so a slowly changing measurement taken
+// at a steady rate costs three to five bytes per point. Points must come in time order.
+class SeriesBlock
+{
+public:
+    static constexpr std::size_t Capacity = 512;
+
+    explicit SeriesBlock(bool aggregated)
+        : _aggregated(aggregated)
+    {}
+
+    bool full() const { return _data.size() + MaxPointSize > Capacity; }
+    std::int64_t first() const { return _first; }
+    std::int64_t last() const { return _last; }
+    std::size_t size() const { return _size; }
+    std::size_t bytes() const { return _data.capacity(); }
+
+    void append(SeriesPoint const &p)
+    {
+        if (_size == 0) {
+            _data.reserve(Capacity);
+            // the first point is stored as delta to time first() and value 0
+            _first = _last = p.time;
+        }
+        putVarint(std::uint64_t(std::max<std::int64_t>(p.time - _last, 0)));
+        putVarint(zigzag(std::int64_t(p.min) - _min));
+        if (_aggregated) {
+            putVarint(std::uint64_t(std::int64_t(p.max) - p.min));
+            putVarint(std::uint64_t(std::int64_t(p.mean) - p.min));
+        }
+        _last = std::max(_last, p.time);
+        _min = p.min;
+        ++_size;
+    }
+
+    // Drops the spare capacity of a block that is complete.
+    void seal() { _data.shrink_to_fit(); }
+
+    // Calls visit with every point from from to to inclusive, in time order.
+    template<typename F>
+    void decode(std::int64_t from, std::int64_t to, F &&visit) const
+    {
+        std::size_t pos = 0;
+        std::int64_t time = _first;
+        std::int64_t min = 0;
+        for (std::size_t i = 0; i < _size; ++i) {
+            time += std::int64_t(getVarint(pos));
+            min += unzigzag(getVarint(pos));
+            std::int64_t max = min;
+            std::int64_t mean = min;
+            if (_aggregated) {
+                max = min + std::int64_t(getVarint(pos));
+                mean = min + std::int64_t(getVarint(pos));
+            }
+            if (time > to)
+                return;
+            if (time >= from)
+                visit(SeriesPoint{time, std::int32_t(min), std::int32_t(max), std::int32_t(mean)});
+        }
+    }
+
+private:
+    static constexpr std::size_t MaxPointSize = 4 * 10;
+
+    static constexpr std::uint64_t zigzag(std::int64_t v)
+    {
+        return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63);
+    }
+
+    static constexpr std::int64_t unzigzag(std::uint64_t v)
+    {
+        return std::int64_t(v >> 1) ^ -std::int64_t(v & 1);
+    }
+
+    void putVarint(std::uint64_t v)
+    {
+        while (v >= 0x80) {
+            _data.push_back(std::uint8_t(v | 0x80));
+            v >>= 7;
+        }
+        _data.push_back(std::uint8_t(v));
+    }
+
+    std::uint64_t getVarint(std::size_t &pos) const
+    {
+        std::uint64_t v = 0;
+        for (int shift = 0;; shift += 7) {
+            auto b = _data[pos++];
+            v |= std::uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+    }
+
+    std::vector<std::uint8_t> _data;
+    std::int64_t _first{};
+    std::int64_t _last{};
+    std::int32_t _min{};
+    std::uint32_t _size{};
+    bool _aggregated;
+};
+
+// How long TimeSeries keeps each resolution, in milliseconds.
+struct SeriesRetention
+{
+    std::int64_t raw = 2 * 3600 * 1000ll;
+    std::int64_t second = 24 * 3600 * 1000ll;
+    std::int64_t minute = 8 * 7 * 24 * 3600 * 1000ll;
+};
+
+// History of one measured value at three resolutions: every value as it came in, and min, max and
+// mean per second and per minute. Each resolution is a ring of compressed blocks: the oldest
+// block is dropped once everything in it is older than the retention of its resolution, so the
+// fine resolutions cover the recent past and the minute resolution weeks at little memory.
+//
+// Times are in milliseconds and must not go backwards, later values at an earlier time are
+// stored at the latest time seen.
+class TimeSeries
+{
+public:
+    enum Resolution : std::uint8_t {
+        Raw,
+        Second,
+        Minute,
+    };
+    static constexpr std::size_t Resolutions = 3;
+
+    using Retention = SeriesRetention;
+
+    explicit TimeSeries(Retention retention = {})
+        : _retention{retention.raw, retention.second, retention.minute}
+    {}
+
+    void append(std::int64_t time, std::int32_t value)
+    {
+        time = std::max(time, _latest.value_or(time));
+        _latest = time;
+        add(Raw, SeriesPoint{time, value, value, value});
+
+        for (std::size_t r = Second; r < Resolutions; ++r) {
+            auto &b = _buckets[r - Second];
+            auto start = time - time % Intervals[r];
+            if (b.count > 0 && b.start != start)
+                add(r, b.point());
+            if (b.count == 0 || b.start != start)
+                b = Bucket{start, value, value, 0, 0};
+            b.min = std::min(b.min, value);
+            b.max = std::max(b.max, value);
+            b.sum += value;
+            ++b.count;
+        }
+    }
+
+    // Calls visit with every point of the resolution from from to to inclusive, in time order.
+    // For Second and Minute the interval still being filled comes last.
+    template<typename F>
+    void query(Resolution resolution, std::int64_t from, std::int64_t to, F &&visit) const
+    {
+        auto const &blocks = _tiers[resolution];
+        // blocks are in time order, skip straight to the first one reaching from
+        auto it = std::partition_point(blocks.begin(), blocks.end(), [from](auto const &b) {
+            return b.last() < from;
+        });
+        for (; it != blocks.end() && it->first() <= to; ++it)
+            it->decode(from, to, visit);
+
+        if (resolution != Raw) {
+            auto const &b = _buckets[resolution - Second];
+            if (b.count > 0 && b.start >= from && b.start <= to)
+                visit(b.point());
+        }
+    }
+
+    std::vector<SeriesPoint> range(Resolution resolution, std::int64_t from, std::int64_t to) const
+    {
+        std::vector<SeriesPoint> points;
+        query(resolution, from, to, [&](SeriesPoint const &p) { points.push_back(p); });
+        return points;
+    }
+
+    // Points stored at the resolution, not counting an interval still being filled.
+    std::size_t size(Resolution resolution) const
+    {
+        std::size_t n = 0;
+        for (auto const &b : _tiers[resolution])
+            n += b.size();
+        return n;
+    }
+
+    // Memory taken by the compressed blocks.
+    std::size_t bytes() const
+    {
+        std::size_t n = 0;
+        for (auto const &tier : _tiers) {
+            for (auto const &b : tier)
+                n += sizeof(SeriesBlock) + b.bytes();
+        }
+        return n;
+    }
+
+    std::optional<std::int64_t> latest() const { return _latest; }
+
+private:
+    static constexpr std::array<std::int64_t, Resolutions> Intervals{0, 1000, 60 * 1000};
+
+    struct Bucket
+    {
+        std::int64_t start{};
+        std::int32_t min{};
+        std::int32_t max{};
+        std::int64_t sum{};
+        std::uint32_t count{};
+
+        SeriesPoint point() const
+        {
+            return {start, min, max, std::int32_t(sum / std::int64_t(count))};
+        }
+    };
+
+    void add(std::size_t resolution, SeriesPoint const &p)
+    {
+        auto &blocks = _tiers[resolution];
+        if (blocks.empty() || blocks.back().full()) {
+            if (!blocks.empty())
+                blocks.back().seal();
+            blocks.emplace_back(resolution != Raw);
+        }
+        blocks.back().append(p);
+        // the ring: whole blocks go once their newest point is past retention
+        while (blocks.size() > 1 && blocks.front().last() < p.time - _retention[resolution])
+            blocks.pop_front();
+    }
+
+    std::array<std::deque<SeriesBlock>, Resolutions> _tiers;
+    std::array<Bucket, Resolutions - 1> _buckets{};
+    std::array<std::int64_t, Resolutions> _retention;
+    std::optional<std::int64_t> _latest;
+};
+
+} // namespace Bd::Core
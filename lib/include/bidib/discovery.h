@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/error.h>
+#include <bidib/uniqueid.h>
+
+#include <chrono>
+
+namespace Bd {
+
+class DiscoveryPrivate;
+class Host;
+
+struct DiscoveredNode
+{
+    Address address;
+    UniqueId uniqueId;
+    quint8 nodeTabVersion; // of the node's own table, 0 for nodes without subnodes
+    qsizetype parent;      // index into Discovery::nodes(), -1 for the root
+};
+
+// Builds the node tree below a root node. Every hub is enumerated as soon as its parent
+// reported it, so all subtrees are read concurrently with one node table enumeration in flight
+// per hub, and the total time follows the deepest path rather than the number of nodes.
+class Discovery : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void nodeDiscovered(Bd::Address const &address, Bd::UniqueId const &uniqueId);
+    void progress(qsizetype discovered, qsizetype pending);
+    // Hubs that failed to answer are reported here, their subtree stays unknown.
+    void hubFailed(Bd::Address const &address, Bd::Error error);
+    void finished(std::chrono::milliseconds elapsed);
+
+public:
+    explicit Discovery(Host *host);
+    ~Discovery() override;
+
+    void start(Address const &root = Address::localNode());
+    bool isRunning() const;
+
+    QList<DiscoveredNode> const &nodes() const;
+    std::chrono::milliseconds elapsed() const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, Discovery)
+    QScopedPointer<DiscoveryPrivate> const _d;
+};
+
+} // namespace Bd
@@ -1,10 +1,16 @@
 #pragma once
 
+// The error codes are shared with the Qt-free core, so the meta-object bits are only compiled
+// in when building against QtCore.
+#ifdef QT_CORE_LIB
 #include <QtCore/QObject>
+#endif
 
 namespace Bd {
 
+#ifdef QT_CORE_LIB
 Q_NAMESPACE
+#endif
 
 enum class Error {
     OutOfData,
@@ -16,8 +22,12 @@ enum class Error {
     EscapingIncomplete,
     BadChecksum,
     MessageMalformed,
+    Timeout,
+    NotAvailable,
 };
 
+#ifdef QT_CORE_LIB
 Q_ENUM_NS(Error);
+#endif
 
 }
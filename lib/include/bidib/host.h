@@ -0,0 +1,152 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/core/features.h>
+#include <bidib/error.h>
+#include <bidib/message.h>
+#include <bidib/nodecache.h>
+
+#include <chrono>
+#include <coroutine>
+#include <optional>
+
+namespace Bd {
+
+class Host;
+class HostPrivate;
+
+// Payload of MSG_ACCESSORY_STATE and MSG_ACCESSORY_NOTIFY.
+struct AccessoryState
+{
+    quint8 number;
+    quint8 aspect;
+    quint8 total;
+    quint8 execute;
+    quint8 wait;
+
+    bool operator==(AccessoryState const &rhs) const = default;
+};
+
+// Which message answers a request: the reply type, optionally the type a node refuses the request
+// with, and the payload prefix both must carry, e.g. the feature number.
+struct ReplyFilter
+{
+    quint8 type;
+    std::optional<quint8> refusal{};
+    QByteArray key{};
+};
+
+// Awaitable single request/reply, see Host::request(). The request goes out when the coroutine
+// suspends, the coroutine resumes with the reply or Error::Timeout. Destroying a suspended
+// coroutine withdraws the request.
+class PendingReply
+{
+public:
+    PendingReply(Host *host, Address const &address, Message const &request, ReplyFilter filter);
+    ~PendingReply();
+
+    PendingReply(PendingReply const &) = delete;
+    PendingReply &operator=(PendingReply const &) = delete;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    tl::expected<Message, Error> await_resume();
+
+private:
+    QPointer<Host> _host;
+    Address _address;
+    Message _request;
+    ReplyFilter _filter;
+    quint64 _id{};
+    std::optional<tl::expected<Message, Error>> _result;
+    std::coroutine_handle<> _handle;
+    bool _suspending{false};
+};
+
+// Host side of a BiDiB system. Runs the multi message conversations with the nodes on top of
+// a message transport: connect messageToSend() to the transport and feed everything received
+// into handleMessage().
+class Host : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void messageToSend(Bd::Address const &address, Bd::Message const &msg);
+
+    void featuresRead(Bd::Address const &address, Bd::Core::FeatureTable const &features);
+    void nodeRead(Bd::Address const &address, Bd::NodeInfo const &info, bool fromCache);
+    void nodeTabRead(Bd::Address const &address,
+                     quint8 version,
+                     QList<Bd::NodeTabEntry> const &entries);
+    void accessoriesRead(Bd::Address const &address, QList<Bd::AccessoryState> const &states);
+    // Spontaneous node table changes, already acknowledged with MSG_NODE_CHANGED_ACK.
+    void nodeNew(Bd::Address const &address, quint8 version, Bd::NodeTabEntry const &entry);
+    void nodeLost(Bd::Address const &address, quint8 version, Bd::NodeTabEntry const &entry);
+    void requestFailed(Bd::Address const &address, quint8 type, Bd::Error error);
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    enum class FeatureMode {
+        // one MSG_FEATURE_GETNEXT round trip per feature
+        Stepped,
+        // the node pushes all features at once, nodes that cannot stream fall back to Stepped
+        Streamed,
+    };
+    Q_ENUM(FeatureMode)
+
+    explicit Host(QObject *parent = nullptr);
+    ~Host() override;
+
+    // Reads all features of the node, answered by featuresRead() or requestFailed().
+    void readFeatures(Address const &address, FeatureMode mode = FeatureMode::Streamed);
+
+    // Reads unique ID, software version, node table, features and strings of the node, answered
+    // by nodeRead() or requestFailed(). With a cache, a known node with unchanged software
+    // version is answered from the cache without reading features and strings. For a node with
+    // subnodes the node table count and the version from its first entry have to match too.
+    void readNode(Address const &address);
+
+    // Enumerates the node table of the node, answered by nodeTabRead() or requestFailed(). Entry 0
+    // is the node itself. With a cache, a node whose count and table version still match its
+    // record is answered from the cache after the first entry, and a full enumeration updates
+    // the record.
+    void readNodeTab(Address const &address);
+
+    // Reads the state of accessories 0 up to count with a single MSG_ACCESSORY_GETALL, answered
+    // by accessoriesRead() in accessory order or requestFailed(). count is the node's
+    // FEATURE_ACCESSORY_COUNT.
+    void readAccessories(Address const &address, quint8 count);
+
+    // Sends request and waits for the first reply matching filter, to be used with co_await.
+    // Any number of requests may be pending at the same time, also for the same node. Per node
+    // at most window() of them are on the wire, and no more bytes than the node reported with
+    // MSG_PKT_CAPACITY; the others are sent in order as replies come in. Replies are matched
+    // in any order.
+    PendingReply request(Address const &address, Message const &request, ReplyFilter filter);
+
+    // Requests per node that may wait for their reply at the same time, default 8.
+    void setWindow(qsizetype requests);
+    qsizetype window() const;
+
+    // The cache is not owned and must outlive the host.
+    void setCache(NodeCache *cache);
+    NodeCache *cache() const;
+
+    // Time a node may stay silent in the middle of a conversation.
+    void setTimeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds timeout() const;
+
+private:
+    friend class PendingReply;
+
+    Q_DECLARE_PRIVATE_D(_d, Host)
+    QScopedPointer<HostPrivate> const _d;
+};
+
+} // namespace Bd
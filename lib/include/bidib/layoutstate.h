@@ -0,0 +1,98 @@
+#pragma once
+
+#include <bidib/address.h>
+#include <bidib/core/rcu.h>
+#include <bidib/message.h>
+#include <bidib/remotenode.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bitset>
+#include <optional>
+
+namespace Bd {
+
+class LayoutStatePrivate;
+
+struct BoosterState
+{
+    quint8 state{};
+    // raw MSG_BOOST_DIAGNOSTIC values, unset until the booster reported them
+    std::optional<quint8> current;
+    std::optional<quint8> voltage;
+    std::optional<quint8> temperature;
+
+    bool operator==(BoosterState const &rhs) const = default;
+};
+
+// What the layout looked like at one point in time. Never changes once published, so any number
+// of threads may read it at the same time.
+class LayoutSnapshot
+{
+public:
+    // Counts the publications, the first one is 1.
+    quint64 epoch() const;
+
+    bool occupied(Address const &node, quint8 section) const;
+    std::bitset<256> occupancy(Address const &node) const;
+    // DCC addresses detected in the section.
+    QList<quint16> locos(Address const &node, quint8 section) const;
+    std::optional<AccessoryState> accessory(Address const &node, quint8 number) const;
+    std::optional<BoosterState> booster(Address const &node) const;
+    std::optional<quint8> port(Address const &node, quint8 type, quint8 number) const;
+
+private:
+    friend class LayoutStatePrivate;
+
+    quint64 _epoch{};
+    // the containers are implicitly shared between snapshots: the first write to a container
+    // after a publish detaches it, copying that whole container, the untouched ones stay shared
+    QHash<quint32, std::bitset<256>> _occupancy;
+    QHash<quint64, QList<quint16>> _locos;       // stack << 8 | section
+    QHash<quint64, AccessoryState> _accessories; // stack << 8 | number
+    QHash<quint32, BoosterState> _boosters;
+    QHash<quint64, quint8> _ports; // stack << 16 | type << 8 | number
+};
+
+// Host side mirror of the layout, kept up to date from the upstream messages of all nodes:
+// occupancy, detected locos, accessory, booster and port states.
+//
+// Changes are applied on the thread the state lives on and become visible in batches: the
+// messages handled in one event loop pass end up in one new snapshot. Other threads read
+// snapshots through their own Reader without locks, see Core::Rcu.
+class LayoutState : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void published(quint64 epoch);
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    using Snapshots = Core::Rcu<LayoutSnapshot>;
+    using Reader = Snapshots::Reader;
+
+    explicit LayoutState(QObject *parent = nullptr);
+    ~LayoutState() override;
+
+    // Applies msg without publishing it, returns false for messages that change nothing.
+    bool apply(Address const &address, Message const &msg);
+    // Publishes everything applied so far right away.
+    void publish();
+
+    // For Reader, one per reading thread: Reader reader(state.snapshots());
+    Snapshots const &snapshots() const;
+    // The latest published snapshot, on the owning thread only.
+    LayoutSnapshot const &current() const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, LayoutState)
+    QScopedPointer<LayoutStatePrivate> const _d;
+};
+
+} // namespace Bd
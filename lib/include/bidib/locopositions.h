@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/core/locoindex.h>
+#include <bidib/message.h>
+
+namespace Bd {
+
+class LocoPositionsPrivate;
+
+// Which sections detect which loco, from the MSG_BM_ADDRESS reports of occupancy nodes with
+// address detection (e.g. RailCom) and MSG_BM_FREE. Both directions are looked up in constant
+// time, see Core::LocoIndex; every loco entering or leaving a section is signalled.
+class LocoPositions : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void locoEntered(quint16 loco, Bd::Address const &node, quint8 section);
+    void locoLeft(quint16 loco, Bd::Address const &node, quint8 section);
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    explicit LocoPositions(QObject *parent = nullptr);
+    ~LocoPositions() override;
+
+    QList<Core::SectionKey> sections(quint16 loco) const;
+    QList<quint16> locos(Address const &node, quint8 section) const;
+    // Locos detected anywhere.
+    qsizetype size() const;
+
+    // Forgets the sections of the node, e.g. after MSG_NODE_LOST, reporting the locos as left.
+    void removeNode(Address const &node);
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, LocoPositions)
+    QScopedPointer<LocoPositionsPrivate> const _d;
+};
+
+} // namespace Bd
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bidib/address.h>
+#include <bidib/core/ring.h>
+#include <bidib/message.h>
+#include <bidib/serialtransport.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+
+namespace Bd {
+
+// A received message as carried by the MessageBus: a plain copy of the wire data with the time
+// it arrived.
+struct BusMessage
+{
+    qint64 timestamp; // steady clock, nanoseconds
+    quint32 address;  // Core::Address stack
+    quint8 num;
+    quint8 type;
+    quint8 size;
+    quint8 reserved;
+    std::array<std::byte, 64> payload;
+
+    Address sender() const { return Address(address); }
+    std::span<const std::byte> data() const { return {payload.data(), size}; }
+    Message message() const;
+};
+
+// Fans the decoded message stream out to consumers on other threads. Each consumer reads at its
+// own pace through a cursor from subscribe(); the decoder never waits for anyone, consumers that
+// fall too far behind lose the oldest messages and have that counted, see Core::BroadcastRing.
+//
+// The bus is a TransportSink and passes everything on to the next sink, so it can sit in front
+// of a MessageRouter. Messages from elsewhere go in through publish(). Publishing must happen on
+// one thread.
+class MessageBus : public TransportSink
+{
+public:
+    static constexpr std::size_t Capacity = 4096;
+    using Ring = Core::BroadcastRing<BusMessage, Capacity>;
+    using Cursor = Ring::Cursor;
+
+    explicit MessageBus(TransportSink *next = nullptr);
+    ~MessageBus() override;
+
+    MessageBus(MessageBus const &) = delete;
+    MessageBus &operator=(MessageBus const &) = delete;
+
+    void publish(Address const &address, Message const &msg);
+
+    // A cursor starting at the next message published, valid as long as the bus.
+    Cursor subscribe() const;
+    quint64 published() const;
+    // Messages lost by slow consumers, summed over all of them.
+    quint64 lost() const;
+
+    // TransportSink
+    void frameReceived(std::span<const std::byte> frame) override;
+    void messageReceived(Core::MessageView const &msg) override;
+    void errorOccurred(Error error, std::span<const std::byte> data) override;
+
+private:
+    void publish(Core::Address address,
+                 quint8 num,
+                 quint8 type,
+                 std::span<const std::byte> payload);
+
+    std::unique_ptr<Ring> _ring;
+    TransportSink *_next;
+};
+
+} // namespace Bd
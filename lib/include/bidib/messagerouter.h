@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bidib/address.h>
+#include <bidib/core/router.h>
+#include <bidib/message.h>
+#include <bidib/serialtransport.h>
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <functional>
+
+namespace Bd {
+
+class MessageRouterPrivate;
+
+// Hands received messages only to the consumers that asked for them, by message type and address
+// prefix (see Core::Router). Install it as the sink of a SerialTransport, or feed it through
+// route() from any other source. Messages nobody subscribed to are dropped before a Message is
+// even built from the frame.
+class MessageRouter : public QObject, public TransportSink
+{
+    Q_OBJECT
+
+public slots:
+    void route(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    using Id = quint32;
+    using Handler = std::function<void(Address const &, Message const &)>;
+
+    explicit MessageRouter(QObject *parent = nullptr);
+    ~MessageRouter() override;
+
+    // The local node address as prefix subscribes to the whole tree.
+    Id subscribe(Core::TypeMask types, Address const &prefix, Handler handler);
+    // Unsubscribes by itself once context is destroyed.
+    Id subscribe(Core::TypeMask types, Address const &prefix, QObject *context, Handler handler);
+    void unsubscribe(Id id);
+    qsizetype subscriberCount() const;
+
+    // TransportSink
+    void messageReceived(Core::MessageView const &msg) override;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, MessageRouter)
+    QScopedPointer<MessageRouterPrivate> const _d;
+};
+
+} // namespace Bd
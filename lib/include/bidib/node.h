@@ -1,7 +1,9 @@
 #pragma once
 
 #include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
 
+#include <bidib/core/features.h>
 #include <bidib/message.h>
 
 namespace Bd {
@@ -20,9 +22,14 @@ public slots:
 
 public:
     Node();
+    ~Node() override;
+
+    void setFeature(quint8 id, quint8 value);
+    Core::FeatureTable const &features() const;
 
 private:
-    Q_DECLARE_PRIVATE(Node)
+    Q_DECLARE_PRIVATE_D(_d, Node)
+    QScopedPointer<NodePrivate> const _d;
 };
 
 } // namespace Bd
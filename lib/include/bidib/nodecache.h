@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bidib/core/features.h>
+#include <bidib/uniqueid.h>
+
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include <optional>
+
+namespace Bd {
+
+struct NodeTabEntry
+{
+    quint8 local;
+    UniqueId uniqueId;
+
+    bool operator==(NodeTabEntry const &rhs) const = default;
+};
+
+// Everything the host learns about a node while bringing it up.
+struct NodeInfo
+{
+    UniqueId uniqueId{};
+    quint32 softwareVersion{}; // major << 16 | minor << 8 | sub
+    // of nodes with subnodes, entry 0 is the node itself
+    quint8 nodeTabVersion{};
+    quint8 nodeTabCount{};
+    QList<NodeTabEntry> nodeTab;
+    Core::FeatureTable features;
+    QString productName;
+    QString userName;
+
+    bool operator==(NodeInfo const &rhs) const = default;
+};
+
+// Persistent NodeInfo store backed by a memory mapped file of fixed size records, keyed by the
+// vendor and product of the unique ID. A record is only trusted as long as the node reports the
+// same software version, see lookup(), and its node table only as long as the node reports the
+// same table version and count.
+class NodeCache
+{
+public:
+    explicit NodeCache(QString const &path);
+    ~NodeCache();
+
+    NodeCache(NodeCache const &) = delete;
+    NodeCache &operator=(NodeCache const &) = delete;
+
+    bool isOpen() const;
+    qsizetype size() const;
+
+    std::optional<NodeInfo> find(UniqueId const &id) const;
+    std::optional<NodeInfo> lookup(UniqueId const &id, quint32 softwareVersion) const;
+    bool store(NodeInfo const &info);
+    void remove(UniqueId const &id);
+    void clear();
+
+private:
+    struct Header;
+    struct Record;
+
+    bool open();
+    bool map(qsizetype capacity);
+    Header *header() const;
+    Record *record(qsizetype index) const;
+
+    QFile _file;
+    uchar *_data{};
+    QHash<quint64, qsizetype> _index;
+};
+
+} // namespace Bd
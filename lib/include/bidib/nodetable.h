@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/host.h>
+#include <bidib/uniqueid.h>
+
+#include <optional>
+
+namespace Bd {
+
+class NodeTablePrivate;
+
+// Host side copy of the node tables of all hubs. Full enumerations seen on the host fill it,
+// afterwards MSG_NODE_NEW/MSG_NODE_LOST are applied as deltas as long as their version follows
+// the known one. Only a gap in the versions triggers a new enumeration of that one hub.
+class NodeTable : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void nodeAdded(Bd::Address const &address, Bd::UniqueId const &uniqueId);
+    void nodeRemoved(Bd::Address const &address, Bd::UniqueId const &uniqueId);
+    void resyncStarted(Bd::Address const &hub);
+
+public:
+    explicit NodeTable(Host *host);
+    ~NodeTable() override;
+
+    std::optional<quint8> version(Address const &hub) const;
+    // Sorted by local number, entry 0 is the hub itself.
+    QList<NodeTabEntry> entries(Address const &hub) const;
+    qsizetype resyncCount() const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, NodeTable)
+    QScopedPointer<NodeTablePrivate> const _d;
+};
+
+} // namespace Bd
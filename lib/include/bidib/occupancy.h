@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/core/sections.h>
+#include <bidib/message.h>
+
+namespace Bd {
+
+class OccupancyPrivate;
+
+// Occupancy of all detector sections, one SectionSet per occupancy node. Keeps itself up to date
+// from MSG_BM_OCC, MSG_BM_FREE and MSG_BM_MULTIPLE and reports each message as one change mask,
+// a bulk report of many sections is a few word operations and a single changed() signal.
+//
+// Like Host it talks to the nodes through messageToSend() and handleMessage(): reports are
+// acknowledged with the matching MSG_BM_MIRROR_* message, which nodes with secure acknowledge
+// (FEATURE_BM_SECACK_ON) expect and the others ignore.
+class Occupancy : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void messageToSend(Bd::Address const &address, Bd::Message const &msg);
+    // Sections whose state changed, and the state of all sections of the node afterwards.
+    void changed(Bd::Address const &node,
+                 Bd::Core::SectionSet const &changes,
+                 Bd::Core::SectionSet const &occupied);
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    explicit Occupancy(QObject *parent = nullptr);
+    ~Occupancy() override;
+
+    Core::SectionSet sections(Address const &node) const;
+    bool occupied(Address const &node, quint8 section) const;
+
+    // Asks the node for the state of sections first up to end with MSG_BM_GET_RANGE, e.g. after
+    // it appeared or missed acknowledgements. The bounds are multiples of 8.
+    void resync(Address const &node, quint8 first = 0, quint8 end = 128);
+
+    // Whether reports are mirrored back, on by default.
+    void setAcknowledge(bool acknowledge);
+    bool acknowledge() const;
+
+    // Forgets the node, e.g. after MSG_NODE_LOST.
+    void remove(Address const &node);
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, Occupancy)
+    QScopedPointer<OccupancyPrivate> const _d;
+};
+
+} // namespace Bd
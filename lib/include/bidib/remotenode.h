@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bidib/address.h>
+#include <bidib/host.h>
+#include <bidib/task.h>
+#include <bidib/uniqueid.h>
+
+#include <QtCore/QList>
+#include <QtCore/QtTypes>
+
+#include <utility>
+
+namespace Bd {
+
+// Host side handle of one node with awaitable requests:
+//
+//     auto volt = co_await node.getFeature(FEATURE_BST_VOLT);
+//
+// Every operation sends its request right away and finishes with the matching reply,
+// Error::NotAvailable if the node refuses it or Error::Timeout after the host timeout. Operations
+// do not depend on each other, so independent ones can be started together and awaited later.
+// The handle is cheap to copy, the host must outlive all running operations.
+class RemoteNode
+{
+public:
+    using Request = std::pair<Message, ReplyFilter>;
+
+    RemoteNode(Host *host, Address const &address);
+
+    Host *host() const;
+    Address address() const;
+
+    Task<UniqueId> getUniqueId() const;
+    Task<quint8> getFeature(quint8 feature) const;
+    // Finishes with the value the node actually took.
+    Task<quint8> setFeature(quint8 feature, quint8 value) const;
+    // Finishes with the first MSG_ACCESSORY_STATE, the movement may still be going on.
+    Task<AccessoryState> setAccessory(quint8 number, quint8 aspect) const;
+
+    // Bulk reads go out back to back through the host window, see Host::request(). The results
+    // come in request order once all are answered, each with its own error.
+    Task<QList<tl::expected<quint8, Error>>> getFeatures(QList<quint8> const &features) const;
+    Task<QList<tl::expected<Message, Error>>> requestAll(QList<Request> const &requests) const;
+
+private:
+    Host *_host;
+    Address _address;
+};
+
+} // namespace Bd
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <chrono>
+#include <functional>
+
+namespace Bd {
+
+class SchedulerPrivate;
+
+// Timers of the thread the scheduler lives on, kept in a Core::TimerWheel with a resolution of
+// one millisecond behind a single QTimer. Scheduling and cancelling are constant time, however
+// many timers are pending, e.g. request timeouts of a host talking to thousands of nodes or
+// execution delays of thousands of simulated accessories.
+class Scheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 0 is never a valid timer.
+    using Id = quint64;
+
+    explicit Scheduler(QObject *parent = nullptr);
+    ~Scheduler() override;
+
+    // Calls callback once after delay.
+    Id schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+    // Calls callback every interval until cancelled, at least one millisecond apart.
+    Id every(std::chrono::milliseconds interval, std::function<void()> callback);
+    // False if the timer went off already or was cancelled before. Cancelling 0 does nothing.
+    bool cancel(Id timer);
+
+    // Pending timers.
+    qsizetype size() const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, Scheduler)
+    QScopedPointer<SchedulerPrivate> const _d;
+};
+
+} // namespace Bd
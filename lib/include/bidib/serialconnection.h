@@ -1,29 +1,59 @@
 #pragma once
 
 #include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <chrono>
+
+class QSerialPort;
 
 namespace Bd {
 
 class SerialConnectionPrivate;
 
+// Per baud rate tuning of the serial link. Faster links get larger read chunks so that a
+// single readyRead() drains a whole burst, slow links keep chunks small to bound latency.
+struct SerialProfile
+{
+    qint32 baudRate;
+    qint64 readChunkSize;
+    bool lowLatency;
+
+    bool operator==(SerialProfile const &rhs) const = default;
+};
+
 class SerialConnection : public QObject
 {
     Q_OBJECT
 
 signals:
     void dataReceived(QByteArray const &data);
+    void baudRateDetected(qint32 baudRate);
+    void baudRateDetectionFailed();
 
 public slots:
     void sendData(QByteArray const &data);
 
 public:
     explicit SerialConnection(QString const &port);
+    ~SerialConnection() override;
+
+    bool open(SerialProfile const &profile);
+    void close();
+    SerialProfile profile() const;
+
+    void detectBaudRate(std::chrono::milliseconds probeTimeout = std::chrono::milliseconds(250));
+
+    static QList<SerialProfile> const &profiles();
+    static SerialProfile profileForBaudRate(qint32 baudRate);
+    static bool applyProfile(QSerialPort &serial, SerialProfile const &profile);
 
 private slots:
     void readData();
 
 private:
-    Q_DECLARE_PRIVATE(SerialConnection)
+    Q_DECLARE_PRIVATE_D(_d, SerialConnection)
+    QScopedPointer<SerialConnectionPrivate> const _d;
 };
 
 } // namespace Bd
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <bidib/core/message.h>
 #include <bidib/error.h>
 
 #include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <chrono>
+#include <span>
 
 #include <expected.hpp>
 
@@ -12,6 +17,23 @@ class SerialTransportPrivate;
 class Message;
 class Address;
 
+// Direct, synchronous receiver of everything a SerialTransport decodes. The views point into the
+// decoder's frame buffer and are only valid during the call.
+class TransportSink
+{
+public:
+    virtual ~TransportSink() = default;
+
+    virtual void frameReceived(std::span<const std::byte> /*frame*/) {}
+    virtual void messageReceived(Core::MessageView const &msg) = 0;
+    virtual void errorOccurred(Error /*error*/, std::span<const std::byte> /*data*/) {}
+};
+
+// Qt adapter around Core::FrameDecoder. Decoded data goes to the installed sink first; the
+// signals are only materialized when something is connected to them.
+//
+// Every error is counted, but errorOccurred() is rate limited so that a line full of garbage
+// does not turn into a flood of copied frames.
 class SerialTransport : public QObject
 {
     Q_OBJECT
@@ -28,11 +50,22 @@ public slots:
 public:
     static QByteArray escape(QByteArray const &ba);
     static tl::expected<QByteArray, Error> unescape(QByteArray const &ba);
+    static QByteArray frame(QByteArray const &messages);
 
     SerialTransport(QObject *parent = nullptr);
+    ~SerialTransport() override;
+
+    void setSink(TransportSink *sink);
+    TransportSink *sink() const;
+
+    quint64 errorCount(Error error) const;
+    quint64 totalErrorCount() const;
+    void resetErrorCounts();
+    void setErrorSampling(quint32 burst, std::chrono::milliseconds interval);
 
 private:
-    Q_DECLARE_PRIVATE(SerialTransport)
+    Q_DECLARE_PRIVATE_D(_d, SerialTransport)
+    QScopedPointer<SerialTransportPrivate> const _d;
 };
 
 } // namespace Bd
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/message.h>
+#include <bidib/uniqueid.h>
+
+namespace Bd {
+
+class SimulatorPrivate;
+
+// Hosts a tree of virtual nodes behind a single interface. Per node state is kept in flat
+// columns indexed by node, messages are routed by address, so a simulated layout of thousands
+// of nodes costs a few vectors instead of thousands of objects.
+class Simulator : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void messageOut(Bd::Address const &address, Bd::Message const &msg);
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    using NodeIndex = qsizetype;
+
+    enum class NodeKind : quint8 {
+        Interface,
+        Hub,
+        Occupancy,
+        Booster,
+        Accessory,
+        LightControl,
+    };
+    Q_ENUM(NodeKind)
+
+    // The interface itself is node 0 at the local address.
+    Simulator();
+    ~Simulator() override;
+
+    // Returns -1 if the parent is no hub, has no free node number or sits at the maximum depth.
+    // The parent reports the new node with MSG_NODE_NEW.
+    NodeIndex addNode(NodeIndex parent, NodeKind kind);
+
+    // Removes the node with everything below it, the parent reports it with MSG_NODE_LOST.
+    // Indices of removed nodes stay valid but are no longer present.
+    bool removeNode(NodeIndex node);
+
+    // Fills the tree breadth first with up to fanout children per hub.
+    void populate(qsizetype count, qsizetype fanout = 32);
+
+    // Occupancy nodes only, a change is reported with MSG_BM_OCC or MSG_BM_FREE.
+    bool setOccupied(NodeIndex node, quint8 section, bool occupied);
+
+    // Accessory nodes only: the accessory reports error, one of the BIDIB_ACC_STATE_ERROR_*
+    // codes, with MSG_ACCESSORY_NOTIFY. The next MSG_ACCESSORY_SET clears it.
+    bool failAccessory(NodeIndex node, quint8 number, quint8 error);
+
+    qsizetype nodeCount() const;
+    bool isPresent(NodeIndex node) const;
+    NodeIndex find(Address const &address) const;
+    Address address(NodeIndex node) const;
+    NodeKind kind(NodeIndex node) const;
+    UniqueId uniqueId(NodeIndex node) const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, Simulator)
+    QScopedPointer<SimulatorPrivate> const _d;
+};
+
+} // namespace Bd
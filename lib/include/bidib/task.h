@@ -0,0 +1,118 @@
+#pragma once
+
+#include <bidib/error.h>
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include <expected.hpp>
+
+namespace Bd {
+
+// Result of an asynchronous operation written as a coroutine. The coroutine starts right away and
+// suspends at every co_await without blocking the thread. Other coroutines co_await the task, plain
+// code registers a callback with then(). A task dropped before it finished keeps running and frees
+// itself at the end.
+template<typename T>
+class Task
+{
+public:
+    using Result = tl::expected<T, Error>;
+
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(Handle handle) noexcept
+        {
+            auto &p = handle.promise();
+            if (p.callback) {
+                // the callback may drop the task, which only marks it detached while finishing
+                p.finishing = true;
+                std::exchange(p.callback, {})(*p.result);
+                p.finishing = false;
+            }
+            if (p.continuation)
+                return p.continuation;
+            if (p.detached)
+                handle.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    struct promise_type
+    {
+        // not an aggregate, else it would be initialized from the coroutine arguments
+        promise_type() = default;
+
+        std::optional<Result> result;
+        std::coroutine_handle<> continuation;
+        std::function<void(Result const &)> callback;
+        bool detached{false};
+        bool finishing{false};
+
+        Task get_return_object() { return Task(Handle::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(Result value) { result = std::move(value); }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept
+        : _handle(std::exchange(other._handle, {}))
+    {}
+
+    Task(Task const &) = delete;
+    Task &operator=(Task const &) = delete;
+    Task &operator=(Task &&) = delete;
+
+    ~Task()
+    {
+        if (!_handle)
+            return;
+        auto &p = _handle.promise();
+        if (_handle.done() && !p.finishing)
+            _handle.destroy();
+        else
+            p.detached = true;
+    }
+
+    bool isReady() const { return _handle && _handle.promise().result.has_value(); }
+
+    // Only valid once isReady().
+    Result const &result() const { return *_handle.promise().result; }
+
+    // Calls callback with the result, right away if the task is already done.
+    template<typename F>
+    void then(F &&callback)
+    {
+        if (isReady())
+            std::forward<F>(callback)(result());
+        else
+            _handle.promise().callback = std::forward<F>(callback);
+    }
+
+    bool await_ready() const noexcept { return isReady(); }
+    void await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        _handle.promise().continuation = continuation;
+    }
+    Result await_resume() { return std::move(*_handle.promise().result); }
+
+private:
+    explicit Task(Handle handle)
+        : _handle(handle)
+    {}
+
+    Handle _handle;
+};
+
+} // namespace Bd
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QScopedPointer>
+
+#include <bidib/address.h>
+#include <bidib/core/timeseries.h>
+#include <bidib/message.h>
+
+namespace Bd {
+
+class TelemetryPrivate;
+
+// History of the measurements nodes report on their own: booster current, voltage and
+// temperature from MSG_BOOST_DIAGNOSTIC, detector current from MSG_BM_CURRENT and loco speed
+// from MSG_BM_SPEED. Every channel is a Core::TimeSeries, kept raw for the recent past and
+// downsampled to seconds and minutes for the weeks before.
+//
+// Values are stored as reported, e.g. currents in the BiDiB current encoding.
+class Telemetry : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void handleMessage(Bd::Address const &address, Bd::Message const &msg);
+
+public:
+    enum class Quantity : quint8 {
+        BoosterCurrent,
+        BoosterVoltage,
+        BoosterTemperature,
+        // per section
+        DetectorCurrent,
+        // per loco address
+        LocoSpeed,
+    };
+    Q_ENUM(Quantity)
+
+    struct Channel
+    {
+        quint32 node;
+        Quantity quantity;
+        quint16 index{};
+
+        bool operator==(Channel const &rhs) const = default;
+    };
+
+    explicit Telemetry(QObject *parent = nullptr);
+    ~Telemetry() override;
+
+    // Applies to channels created afterwards.
+    void setRetention(Core::SeriesRetention retention);
+    Core::SeriesRetention retention() const;
+
+    // Adds a value at time, in milliseconds since the epoch. handleMessage() records at the
+    // current time.
+    void record(Channel const &channel, qint64 time, qint32 value);
+
+    // Points from from to to inclusive, in time order.
+    QList<Core::SeriesPoint> query(Channel const &channel,
+                                   qint64 from,
+                                   qint64 to,
+                                   Core::TimeSeries::Resolution resolution
+                                   = Core::TimeSeries::Raw) const;
+
+    QList<Channel> channels() const;
+    // Bytes taken by the compressed history of all channels.
+    qsizetype memoryUsage() const;
+
+private:
+    Q_DECLARE_PRIVATE_D(_d, Telemetry)
+    QScopedPointer<TelemetryPrivate> const _d;
+};
+
+} // namespace Bd
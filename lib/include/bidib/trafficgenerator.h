@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QRandomGenerator>
+
+#include <array>
+#include <chrono>
+
+namespace Bd {
+
+// Shape of the generated upstream traffic. Rates are average messages per second, the events of
+// each class follow a Poisson process.
+struct TrafficProfile
+{
+    double occupancyRate{20.0};  // bursts of MSG_BM_OCC / MSG_BM_FREE / MSG_BM_MULTIPLE
+    int occupancyBurst{4};       // section changes per burst
+    double railcomRate{10.0};    // MSG_BM_ADDRESS
+    double diagnosticsRate{2.0}; // MSG_BOOST_DIAGNOSTIC
+    double driveAckRate{10.0};   // MSG_CS_DRIVE_ACK
+    double featureRate{1.0};     // MSG_FEATURE during feature enumeration
+
+    int detectorNodes{8};
+    int sectionsPerNode{16};
+    int boosterNodes{2};
+    int locos{20};
+
+    TrafficProfile scaled(double factor) const;
+};
+
+// Deterministic BiDiB traffic source producing escaped, checksummed wire frames as an interface
+// would send them. The same profile and seed always yield the same byte stream.
+class TrafficGenerator
+{
+public:
+    enum Kind { Occupancy, Railcom, Diagnostics, DriveAck, Feature, KindCount };
+
+    explicit TrafficGenerator(TrafficProfile const &profile, quint32 seed = 1);
+
+    // Wire data of all events within the next duration of simulated time.
+    QByteArray generate(std::chrono::microseconds duration);
+
+    std::chrono::microseconds elapsed() const;
+    quint64 messageCount() const;
+    quint64 frameCount() const;
+
+private:
+    double rate(Kind kind) const;
+    void schedule(Kind kind);
+    void emitEvent(Kind kind, QByteArray &out);
+    void appendMessage(QByteArray &frame,
+                       QByteArray &out,
+                       quint32 address,
+                       quint8 type,
+                       QByteArray const &payload);
+    void finishFrame(QByteArray &frame, QByteArray &out);
+
+    TrafficProfile _profile;
+    QRandomGenerator _random;
+    std::chrono::microseconds _now{};
+    std::array<std::chrono::microseconds, KindCount> _next{};
+    QHash<quint32, quint8> _sequence;
+    QList<quint32> _occupancy;
+    quint8 _feature{};
+    quint64 _messages{};
+    quint64 _frames{};
+};
+
+} // namespace Bd
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QtCore/QtTypes>
+
+class QDebug;
+
+namespace Bd {
+
+struct __attribute__((packed)) UniqueId
+{
+    enum Class : quint8 {
+        ClassSwitch = 0x01,
+        ClassBooster = 0x02,
+        ClassAccessory = 0x04,
+        ClassDccProg = 0x08,
+        ClassDccMain = 0x10,
+        ClassUi = 0x20,
+        ClassOccupancy = 0x40,
+        ClassBridge = 0x80,
+    };
+
+    quint8 classId;
+    quint8 classIdEx;
+    quint8 vendorId;
+    quint32 productId;
+
+    // vendor and product identify a node, the class bits may change with its configuration
+    quint64 key() const { return quint64(vendorId) << 32 | productId; }
+
+    bool operator==(UniqueId const &rhs) const = default;
+};
+static_assert(sizeof(UniqueId) == 7);
+
+QDebug operator<<(QDebug d, UniqueId const &id);
+
+} // namespace Bd
@@ -0,0 +1,298 @@
+#include "layoutstate.h"
+#include "bidib_messages.h"
+
+namespace Bd {
+
+static quint32 key(Address const &node)
+{
+    return node.core().stack();
+}
+
+static quint64 key(Address const &node, quint8 number)
+{
+    return quint64(node.core().stack()) << 8 | number;
+}
+
+static quint64 key(Address const &node, quint8 type, quint8 number)
+{
+    return quint64(node.core().stack()) << 16 | quint64(type) << 8 | number;
+}
+
+quint64 LayoutSnapshot::epoch() const
+{
+    return _epoch;
+}
+
+bool LayoutSnapshot::occupied(Address const &node, quint8 section) const
+{
+    return _occupancy.value(key(node)).test(section);
+}
+
+std::bitset<256> LayoutSnapshot::occupancy(Address const &node) const
+{
+    return _occupancy.value(key(node));
+}
+
+QList<quint16> LayoutSnapshot::locos(Address const &node, quint8 section) const
+{
+    return _locos.value(key(node, section));
+}
+
+std::optional<AccessoryState> LayoutSnapshot::accessory(Address const &node, quint8 number) const
+{
+    auto it = _accessories.constFind(key(node, number));
+    if (it == _accessories.cend())
+        return std::nullopt;
+    return *it;
+}
+
+std::optional<BoosterState> LayoutSnapshot::booster(Address const &node) const
+{
+    auto it = _boosters.constFind(key(node));
+    if (it == _boosters.cend())
+        return std::nullopt;
+    return *it;
+}
+
+std::optional<quint8> LayoutSnapshot::port(Address const &node, quint8 type, quint8 number) const
+{
+    auto it = _ports.constFind(key(node, type, number));
+    if (it == _ports.cend())
+        return std::nullopt;
+    return *it;
+}
+
+class LayoutStatePrivate
+{
+    Q_DECLARE_PUBLIC(LayoutState)
+
+public:
+    explicit LayoutStatePrivate(LayoutState *q)
+        : q_ptr(q)
+    {}
+
+    bool occupancy(Address const &address, Message const &msg);
+    bool multiple(Address const &address, Message const &msg);
+    bool locos(Address const &address, Message const &msg);
+    bool accessory(Address const &address, Message const &msg);
+    bool boosterState(Address const &address, Message const &msg);
+    bool boosterDiagnostic(Address const &address, Message const &msg);
+    bool port(Address const &address, Message const &msg);
+    void publish();
+
+    LayoutState *const q_ptr;
+    // written here only, copied into every published snapshot
+    LayoutSnapshot working;
+    LayoutState::Snapshots snapshots{std::make_unique<LayoutSnapshot>()};
+    bool dirty{false};
+    bool publishScheduled{false};
+};
+
+bool LayoutStatePrivate::occupancy(Address const &address, Message const &msg)
+{
+    auto args = Unpacker::unpack<quint8>(msg.payload());
+    if (!args)
+        return false;
+    auto section = std::get<0>(*args);
+    bool occupied = msg.type() == MSG_BM_OCC;
+
+    auto &bits = working._occupancy[key(address)];
+    if (bits.test(section) == occupied)
+        return false;
+    bits.set(section, occupied);
+    // nothing left to detect in a free section
+    if (!occupied)
+        working._locos.remove(key(address, section));
+    return true;
+}
+
+bool LayoutStatePrivate::multiple(Address const &address, Message const &msg)
+{
+    auto const &p = msg.payload();
+    if (p.size() < 2)
+        return false;
+    quint8 base = p[0];
+    quint8 size = p[1];
+    if (p.size() < 2 + (size + 7) / 8)
+        return false;
+
+    auto &bits = working._occupancy[key(address)];
+    auto before = bits;
+    for (int i = 0; i < size && base + i < 256; ++i)
+        bits.set(base + i, (quint8(p[2 + i / 8]) >> (i % 8)) & 1);
+    return bits != before;
+}
+
+bool LayoutStatePrivate::locos(Address const &address, Message const &msg)
+{
+    auto const &p = msg.payload();
+    if (p.isEmpty())
+        return false;
+    quint8 section = p[0];
+
+    QList<quint16> locos;
+    for (qsizetype i = 1; i + 1 < p.size(); i += 2) {
+        // the top bits carry the direction
+        auto loco = quint16(quint8(p[i]) | quint8(p[i + 1]) << 8) & 0x3fff;
+        if (loco != 0)
+            locos << loco;
+    }
+
+    auto k = key(address, section);
+    if (working._locos.value(k) == locos)
+        return false;
+    if (locos.isEmpty())
+        working._locos.remove(k);
+    else
+        working._locos.insert(k, locos);
+    return true;
+}
+
+bool LayoutStatePrivate::accessory(Address const &address, Message const &msg)
+{
+    auto args = Unpacker::unpack<quint8, quint8, quint8, quint8, quint8>(msg.payload());
+    if (!args)
+        return false;
+    auto [number, aspect, total, execute, wait] = *args;
+
+    AccessoryState state{number, aspect, total, execute, wait};
+    auto k = key(address, number);
+    auto it = working._accessories.constFind(k);
+    if (it != working._accessories.cend() && *it == state)
+        return false;
+    working._accessories.insert(k, state);
+    return true;
+}
+
+bool LayoutStatePrivate::boosterState(Address const &address, Message const &msg)
+{
+    auto args = Unpacker::unpack<quint8>(msg.payload());
+    if (!args)
+        return false;
+
+    auto &booster = working._boosters[key(address)];
+    if (booster.state == std::get<0>(*args))
+        return false;
+    booster.state = std::get<0>(*args);
+    return true;
+}
+
+bool LayoutStatePrivate::boosterDiagnostic(Address const &address, Message const &msg)
+{
+    auto const &p = msg.payload();
+    auto &booster = working._boosters[key(address)];
+    auto before = booster;
+    for (qsizetype i = 0; i + 1 < p.size(); i += 2) {
+        quint8 value = p[i + 1];
+        switch (quint8(p[i])) {
+        case BIDIB_BST_DIAG_I:
+            booster.current = value;
+            break;
+        case BIDIB_BST_DIAG_V:
+            booster.voltage = value;
+            break;
+        case BIDIB_BST_DIAG_T:
+            booster.temperature = value;
+            break;
+        }
+    }
+    return booster != before;
+}
+
+bool LayoutStatePrivate::port(Address const &address, Message const &msg)
+{
+    auto args = Unpacker::unpack<quint8, quint8, quint8>(msg.payload());
+    if (!args)
+        return false;
+    auto [type, number, state] = *args;
+
+    auto k = key(address, type, number);
+    auto it = working._ports.constFind(k);
+    if (it != working._ports.cend() && *it == state)
+        return false;
+    working._ports.insert(k, state);
+    return true;
+}
+
+void LayoutStatePrivate::publish()
+{
+    Q_Q(LayoutState);
+    publishScheduled = false;
+    if (!dirty)
+        return;
+    dirty = false;
+
+    ++working._epoch;
+    snapshots.publish(std::make_unique<LayoutSnapshot>(working));
+    emit q->published(working._epoch);
+}
+
+LayoutState::LayoutState(QObject *parent)
+    : QObject(parent)
+    , _d(new LayoutStatePrivate(this))
+{}
+
+LayoutState::~LayoutState() = default;
+
+bool LayoutState::apply(Address const &address, Message const &msg)
+{
+    Q_D(LayoutState);
+    bool changed = false;
+    switch (msg.type()) {
+    case MSG_BM_OCC:
+    case MSG_BM_FREE:
+        changed = d->occupancy(address, msg);
+        break;
+    case MSG_BM_MULTIPLE:
+        changed = d->multiple(address, msg);
+        break;
+    case MSG_BM_ADDRESS:
+        changed = d->locos(address, msg);
+        break;
+    case MSG_ACCESSORY_STATE:
+    case MSG_ACCESSORY_NOTIFY:
+        changed = d->accessory(address, msg);
+        break;
+    case MSG_BOOST_STAT:
+        changed = d->boosterState(address, msg);
+        break;
+    case MSG_BOOST_DIAGNOSTIC:
+        changed = d->boosterDiagnostic(address, msg);
+        break;
+    case MSG_LC_STAT:
+        changed = d->port(address, msg);
+        break;
+    }
+    d->dirty = d->dirty || changed;
+    return changed;
+}
+
+void LayoutState::publish()
+{
+    Q_D(LayoutState);
+    d->publish();
+}
+
+void LayoutState::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(LayoutState);
+    if (!apply(address, msg) || d->publishScheduled)
+        return;
+    // everything arriving in this event loop pass goes into the same snapshot
+    d->publishScheduled = true;
+    QMetaObject::invokeMethod(this, [d] { d->publish(); }, Qt::QueuedConnection);
+}
+
+LayoutState::Snapshots const &LayoutState::snapshots() const
+{
+    Q_D(const LayoutState);
+    return d->snapshots;
+}
+
+LayoutSnapshot const &LayoutState::current() const
+{
+    Q_D(const LayoutState);
+    return d->snapshots.current();
+}
+
+} // namespace Bd
@@ -0,0 +1,121 @@
+#include "locopositions.h"
+#include "bidib_messages.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QVarLengthArray>
+
+namespace Bd {
+
+class LocoPositionsPrivate
+{
+    Q_DECLARE_PUBLIC(LocoPositions)
+
+public:
+    explicit LocoPositionsPrivate(LocoPositions *q)
+        : q_ptr(q)
+    {}
+
+    void address(Address const &node, Message const &msg);
+    void free(Address const &node, Message const &msg);
+    void changed(quint16 loco, Core::SectionKey section, bool entered);
+
+    LocoPositions *const q_ptr;
+    Core::LocoIndex index;
+};
+
+void LocoPositionsPrivate::address(Address const &node, Message const &msg)
+{
+    auto const &p = msg.payload();
+    if (p.isEmpty()) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+
+    // address 0 means the section detects something without an address
+    QVarLengthArray<quint16, 8> locos;
+    for (qsizetype i = 1; i + 1 < p.size(); i += 2) {
+        // the top two bits tell the direction the loco faces
+        auto loco = quint16(quint8(p[i]) | quint8(p[i + 1]) << 8) & 0x3fff;
+        if (loco != 0)
+            locos.append(loco);
+    }
+
+    Core::SectionKey section(node.core(), quint8(p[0]));
+    auto detected = std::span<quint16 const>(locos.data(), locos.size());
+    index.assign(section, detected, [this](quint16 loco, Core::SectionKey s, bool entered) {
+        changed(loco, s, entered);
+    });
+}
+
+void LocoPositionsPrivate::free(Address const &node, Message const &msg)
+{
+    auto args = Unpacker::unpack<quint8>(msg.payload());
+    if (!args) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+
+    Core::SectionKey section(node.core(), std::get<0>(*args));
+    index.clear(section, [this](quint16 loco, Core::SectionKey s, bool entered) {
+        changed(loco, s, entered);
+    });
+}
+
+void LocoPositionsPrivate::changed(quint16 loco, Core::SectionKey section, bool entered)
+{
+    Q_Q(LocoPositions);
+    if (entered)
+        emit q->locoEntered(loco, Address(section.node()), section.section());
+    else
+        emit q->locoLeft(loco, Address(section.node()), section.section());
+}
+
+LocoPositions::LocoPositions(QObject *parent)
+    : QObject(parent)
+    , _d(new LocoPositionsPrivate(this))
+{}
+
+LocoPositions::~LocoPositions() = default;
+
+void LocoPositions::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(LocoPositions);
+    switch (msg.type()) {
+    case MSG_BM_ADDRESS:
+        d->address(address, msg);
+        break;
+    case MSG_BM_FREE:
+        d->free(address, msg);
+        break;
+    }
+}
+
+QList<Core::SectionKey> LocoPositions::sections(quint16 loco) const
+{
+    Q_D(const LocoPositions);
+    auto s = d->index.sections(loco);
+    return QList<Core::SectionKey>(s.begin(), s.end());
+}
+
+QList<quint16> LocoPositions::locos(Address const &node, quint8 section) const
+{
+    Q_D(const LocoPositions);
+    auto l = d->index.locos(Core::SectionKey(node.core(), section));
+    return QList<quint16>(l.begin(), l.end());
+}
+
+qsizetype LocoPositions::size() const
+{
+    Q_D(const LocoPositions);
+    return qsizetype(d->index.size());
+}
+
+void LocoPositions::removeNode(Address const &node)
+{
+    Q_D(LocoPositions);
+    d->index.clearNode(node.core(), [d](quint16 loco, Core::SectionKey s, bool entered) {
+        d->changed(loco, s, entered);
+    });
+}
+
+} // namespace Bd
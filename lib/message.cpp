@@ -1,12 +1,15 @@
 #include "message.h"
+#include "bytes.h"
 #include "messagenames.h"
 
+#include <bidib/core/message.h>
+
 #include <QString>
 #include <QDebug>
 
-namespace Bd {
+#include <array>
 
-static constexpr auto MAX_MESSAGE_SIZE = 63;
+namespace Bd {
 
 Message::Message(quint8 type, QByteArray const &payload)
     : _type(type)
@@ -20,16 +23,11 @@ QString Message::name(quint8 type)
 
 tl::expected<QByteArray, Error> Message::toSendBuffer(Address address, quint8 number) const
 {
-    auto size = 3 + address.size() + _payload.size();
-    if (size > MAX_MESSAGE_SIZE)
-        return tl::make_unexpected(Error::MessageTooLarge);
-    QByteArray buf;
-    buf.append(size);
-    buf.append(address.toByteArray());
-    buf.append(number);
-    buf.append(_type);
-    buf.append(_payload);
-    return buf;
+    std::array<std::byte, Core::MaxMessageSize + 1> buf;
+    auto size = Core::encodeMessage(buf, address.core(), number, _type, asBytes(_payload));
+    if (!size)
+        return tl::make_unexpected(size.error());
+    return toByteArray(std::span(buf).first(*size));
 }
 
 bool Message::operator==(const Message &rhs) const
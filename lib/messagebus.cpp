@@ -0,0 +1,83 @@
+#include "messagebus.h"
+#include "bytes.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Bd {
+
+static_assert(std::is_trivially_copyable_v<BusMessage>);
+static_assert(sizeof(BusMessage) % 8 == 0);
+
+Message BusMessage::message() const
+{
+    return Message(type, toByteArray(data()));
+}
+
+MessageBus::MessageBus(TransportSink *next)
+    : _ring(std::make_unique<Ring>())
+    , _next(next)
+{}
+
+MessageBus::~MessageBus() = default;
+
+void MessageBus::publish(Address const &address, Message const &msg)
+{
+    publish(address.core(), 0, msg.type(), asBytes(msg.payload()));
+}
+
+MessageBus::Cursor MessageBus::subscribe() const
+{
+    return _ring->subscribe();
+}
+
+quint64 MessageBus::published() const
+{
+    return _ring->published();
+}
+
+quint64 MessageBus::lost() const
+{
+    return _ring->lost();
+}
+
+void MessageBus::frameReceived(std::span<const std::byte> frame)
+{
+    if (_next)
+        _next->frameReceived(frame);
+}
+
+void MessageBus::messageReceived(Core::MessageView const &msg)
+{
+    publish(msg.address, msg.num, msg.type, msg.payload);
+    if (_next)
+        _next->messageReceived(msg);
+}
+
+void MessageBus::errorOccurred(Error error, std::span<const std::byte> data)
+{
+    if (_next)
+        _next->errorOccurred(error, data);
+}
+
+void MessageBus::publish(Core::Address address,
+                         quint8 num,
+                         quint8 type,
+                         std::span<const std::byte> payload)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+    BusMessage m;
+    m.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    m.address = address.stack();
+    m.num = num;
+    m.type = type;
+    // a decoded message never carries more, see Core::MaxMessageSize
+    m.size = static_cast<quint8>(std::min(payload.size(), m.payload.size()));
+    m.reserved = 0;
+    std::copy_n(payload.begin(), m.size, m.payload.begin());
+    std::fill(m.payload.begin() + m.size, m.payload.end(), std::byte{0});
+    _ring->publish(m);
+}
+
+} // namespace Bd
@@ -0,0 +1,73 @@
+#include "messagerouter.h"
+#include "bytes.h"
+
+namespace Bd {
+
+class MessageRouterPrivate
+{
+    Q_DECLARE_PUBLIC(MessageRouter)
+
+public:
+    explicit MessageRouterPrivate(MessageRouter *q)
+        : q_ptr(q)
+    {}
+
+    MessageRouter *const q_ptr;
+    Core::Router<MessageRouter::Handler> router;
+};
+
+MessageRouter::MessageRouter(QObject *parent)
+    : QObject(parent)
+    , _d(new MessageRouterPrivate(this))
+{}
+
+MessageRouter::~MessageRouter() = default;
+
+MessageRouter::Id MessageRouter::subscribe(Core::TypeMask types,
+                                           Address const &prefix,
+                                           Handler handler)
+{
+    Q_D(MessageRouter);
+    return d->router.subscribe(types, prefix.core(), std::move(handler));
+}
+
+MessageRouter::Id MessageRouter::subscribe(Core::TypeMask types,
+                                           Address const &prefix,
+                                           QObject *context,
+                                           Handler handler)
+{
+    auto id = subscribe(types, prefix, std::move(handler));
+    connect(context, &QObject::destroyed, this, [this, id] { unsubscribe(id); });
+    return id;
+}
+
+void MessageRouter::unsubscribe(Id id)
+{
+    Q_D(MessageRouter);
+    d->router.unsubscribe(id);
+}
+
+qsizetype MessageRouter::subscriberCount() const
+{
+    Q_D(const MessageRouter);
+    return static_cast<qsizetype>(d->router.size());
+}
+
+void MessageRouter::route(Address const &address, Message const &msg)
+{
+    Q_D(MessageRouter);
+    d->router.route(address.core(), msg.type(), address, msg);
+}
+
+void MessageRouter::messageReceived(Core::MessageView const &msg)
+{
+    Q_D(MessageRouter);
+    if (!d->router.wants(msg.address, msg.type))
+        return;
+    d->router.route(msg.address,
+                    msg.type,
+                    Address(msg.address),
+                    Message(msg.type, toByteArray(msg.payload)));
+}
+
+} // namespace Bd
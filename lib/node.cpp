@@ -1,7 +1,13 @@
 #include "node.h"
 #include "bidib_messages.h"
 
-#include <QtCore/private/qobject_p.h>
+#include <QtCore/QDebug>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QSharedPointer>
+
+#include <functional>
+#include <optional>
 
 namespace Bd {
 
@@ -16,11 +22,15 @@ using MessageHandler = std::function<void(Message)>;
     HandlerRegistration __msgReg_##msg{this, msg, &NodePrivate::__handle_##msg}; \
     void __handle_##msg(__VA_ARGS__)
 
-class NodePrivate : public QObjectPrivate
+class NodePrivate
 {
     Q_DECLARE_PUBLIC(Node)
 
 public:
+    explicit NodePrivate(Node *q)
+        : q_ptr(q)
+    {}
+
     void handleMessage(Message const &msg)
     {
         if (auto handler = _handlers[msg.type()])
@@ -103,8 +113,11 @@ private:
         _handlers[id] = [msg](auto) { return msg; };
     }
 
+    Node *const q_ptr;
     QList<int> _nodes;
     quint8 _nodeTabVersion{1};
+    Core::FeatureTable _features;
+    quint16 _featureCursor{0x100};
     MessageHandler _handlers[255];
 
     HANDLER(MSG_NODETAB_GETALL, void)
@@ -122,12 +135,69 @@ private:
             registerReply(MSG_NODETAB_GETNEXT, NodeNA);
         }
     }
+
+    HANDLER(MSG_FEATURE_GETALL, std::optional<quint8> shouldStream)
+    {
+        if (shouldStream.value_or(0) != 1) {
+            _featureCursor = 0;
+            sendMessage<quint8>(MSG_FEATURE_COUNT, _features.size());
+            return;
+        }
+
+        _featureCursor = 0x100;
+        sendMessage<quint8, quint8>(MSG_FEATURE_COUNT, _features.size(), 1);
+        for (auto e : _features)
+            sendMessage(MSG_FEATURE, e.id, e.value);
+    }
+
+    HANDLER(MSG_FEATURE_GETNEXT, void)
+    {
+        auto id = _features.next(_featureCursor);
+        if (!id) {
+            Q_Q(Node);
+            _featureCursor = 0x100;
+            emit q->messageToSend(FeatureNA);
+            return;
+        }
+        _featureCursor = *id + 1;
+        sendMessage<quint8, quint8>(MSG_FEATURE, *id, *_features.value(*id));
+    }
+
+    HANDLER(MSG_FEATURE_GET, quint8 id)
+    {
+        if (auto value = _features.value(id))
+            sendMessage<quint8, quint8>(MSG_FEATURE, id, *value);
+        else
+            sendMessage<quint8>(MSG_FEATURE_NA, id);
+    }
+
+    HANDLER(MSG_FEATURE_SET, quint8 id, quint8 value)
+    {
+        if (_features.update(id, value))
+            sendMessage<quint8, quint8>(MSG_FEATURE, id, value);
+        else
+            sendMessage<quint8>(MSG_FEATURE_NA, id);
+    }
 };
 
 Node::Node()
-    : QObject(*new NodePrivate)
+    : _d(new NodePrivate(this))
 {}
 
+Node::~Node() = default;
+
+void Node::setFeature(quint8 id, quint8 value)
+{
+    Q_D(Node);
+    d->_features.set(id, value);
+}
+
+Core::FeatureTable const &Node::features() const
+{
+    Q_D(const Node);
+    return d->_features;
+}
+
 void Node::handleMessage(Message const &msg)
 {
     Q_D(Node);
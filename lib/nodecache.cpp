@@ -0,0 +1,222 @@
+#include "nodecache.h"
+
+#include <QtCore/QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace Bd {
+
+static constexpr char Magic[8] = {'B', 'D', 'N', 'C', 'A', 'C', 'H', 'E'};
+static constexpr quint32 FormatVersion = 1;
+static constexpr qsizetype InitialCapacity = 64;
+// FEATURE_STRING_SIZE allows at most 24 characters
+static constexpr qsizetype MaxString = 24;
+// the node itself and local numbers 1 to 127
+static constexpr qsizetype MaxNodeTab = 128;
+
+struct NodeCache::Header
+{
+    char magic[8];
+    quint32 formatVersion;
+    quint32 recordSize;
+    quint32 slots; // used and freed records, freed ones are reused first
+    quint32 capacity;
+};
+
+struct NodeCache::Record
+{
+    quint8 used;
+    UniqueId uniqueId;
+    quint32 softwareVersion;
+    quint8 nodeTabVersion;
+    quint8 nodeTabCount;
+    quint8 nodeTabSize;
+    NodeTabEntry nodeTab[MaxNodeTab];
+    Core::FeatureTable features;
+    quint8 productName[MaxString + 1]; // length, then latin1
+    quint8 userName[MaxString + 1];
+};
+
+// records are copied into the mapping as they are
+static_assert(std::is_trivially_copyable_v<Core::FeatureTable>);
+static_assert(std::is_trivially_copyable_v<NodeTabEntry>);
+
+static void putString(quint8 *out, QString const &s)
+{
+    auto latin1 = s.toLatin1().left(MaxString);
+    out[0] = static_cast<quint8>(latin1.size());
+    std::memcpy(out + 1, latin1.constData(), latin1.size());
+}
+
+static QString getString(quint8 const *in)
+{
+    auto size = std::min<qsizetype>(in[0], MaxString);
+    return QString::fromLatin1(reinterpret_cast<char const *>(in + 1), size);
+}
+
+NodeCache::NodeCache(QString const &path)
+    : _file(path)
+{
+    if (!open())
+        qWarning() << "cannot open node cache" << path << _file.errorString();
+}
+
+NodeCache::~NodeCache()
+{
+    if (_data)
+        _file.unmap(_data);
+}
+
+bool NodeCache::isOpen() const
+{
+    return _data != nullptr;
+}
+
+qsizetype NodeCache::size() const
+{
+    return _index.size();
+}
+
+std::optional<NodeInfo> NodeCache::find(UniqueId const &id) const
+{
+    auto it = _index.constFind(id.key());
+    if (it == _index.cend())
+        return std::nullopt;
+
+    auto r = record(*it);
+    NodeInfo info;
+    info.uniqueId = r->uniqueId;
+    info.softwareVersion = r->softwareVersion;
+    info.nodeTabVersion = r->nodeTabVersion;
+    info.nodeTabCount = r->nodeTabCount;
+    auto nodeTabSize = std::min<qsizetype>(r->nodeTabSize, MaxNodeTab);
+    info.nodeTab = QList<NodeTabEntry>(r->nodeTab, r->nodeTab + nodeTabSize);
+    info.features = r->features;
+    info.productName = getString(r->productName);
+    info.userName = getString(r->userName);
+    return info;
+}
+
+std::optional<NodeInfo> NodeCache::lookup(UniqueId const &id, quint32 softwareVersion) const
+{
+    auto info = find(id);
+    if (info && info->softwareVersion != softwareVersion)
+        return std::nullopt;
+    return info;
+}
+
+bool NodeCache::store(NodeInfo const &info)
+{
+    if (!isOpen())
+        return false;
+
+    auto index = _index.value(info.uniqueId.key(), -1);
+    if (index < 0) {
+        for (qsizetype i = 0; i < header()->slots && index < 0; ++i) {
+            if (!record(i)->used)
+                index = i;
+        }
+    }
+    if (index < 0) {
+        if (header()->slots == header()->capacity && !map(header()->capacity * 2))
+            return false;
+        index = header()->slots++;
+    }
+
+    auto r = record(index);
+    std::memset(r, 0, sizeof(Record));
+    r->used = 1;
+    r->uniqueId = info.uniqueId;
+    r->softwareVersion = info.softwareVersion;
+    r->nodeTabVersion = info.nodeTabVersion;
+    r->nodeTabCount = info.nodeTabCount;
+    r->nodeTabSize = quint8(std::min(info.nodeTab.size(), MaxNodeTab));
+    std::copy_n(info.nodeTab.cbegin(), r->nodeTabSize, r->nodeTab);
+    r->features = info.features;
+    putString(r->productName, info.productName);
+    putString(r->userName, info.userName);
+
+    _index.insert(info.uniqueId.key(), index);
+    return true;
+}
+
+void NodeCache::remove(UniqueId const &id)
+{
+    auto index = _index.value(id.key(), -1);
+    if (index < 0)
+        return;
+    _index.remove(id.key());
+    record(index)->used = 0;
+}
+
+void NodeCache::clear()
+{
+    if (!isOpen())
+        return;
+    header()->slots = 0;
+    _index.clear();
+}
+
+bool NodeCache::open()
+{
+    if (!_file.open(QIODevice::ReadWrite))
+        return false;
+
+    if (_file.size() >= qint64(sizeof(Header))) {
+        Header h;
+        _file.read(reinterpret_cast<char *>(&h), sizeof(h));
+        bool valid = std::memcmp(h.magic, Magic, sizeof(Magic)) == 0
+                     && h.formatVersion == FormatVersion && h.recordSize == sizeof(Record)
+                     && h.slots <= h.capacity
+                     && _file.size() >= qint64(sizeof(Header) + h.capacity * sizeof(Record));
+        if (valid && map(h.capacity)) {
+            for (qsizetype i = 0; i < header()->slots; ++i) {
+                if (record(i)->used)
+                    _index.insert(record(i)->uniqueId.key(), i);
+            }
+            return true;
+        }
+        // written by another version or truncated, start over
+    }
+
+    if (!map(InitialCapacity))
+        return false;
+    auto h = header();
+    std::memcpy(h->magic, Magic, sizeof(Magic));
+    h->formatVersion = FormatVersion;
+    h->recordSize = sizeof(Record);
+    h->slots = 0;
+    return true;
+}
+
+bool NodeCache::map(qsizetype capacity)
+{
+    if (_data) {
+        _file.unmap(_data);
+        _data = nullptr;
+    }
+
+    auto size = qint64(sizeof(Header) + capacity * sizeof(Record));
+    if (_file.size() < size && !_file.resize(size))
+        return false;
+    _data = _file.map(0, size);
+    if (!_data)
+        return false;
+    header()->capacity = static_cast<quint32>(capacity);
+    return true;
+}
+
+NodeCache::Header *NodeCache::header() const
+{
+    return reinterpret_cast<Header *>(_data);
+}
+
+NodeCache::Record *NodeCache::record(qsizetype index) const
+{
+    static_assert(sizeof(Header) % alignof(Record) == 0);
+    return reinterpret_cast<Record *>(_data + sizeof(Header)) + index;
+}
+
+} // namespace Bd
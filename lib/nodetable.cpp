@@ -0,0 +1,211 @@
+#include "nodetable.h"
+#include "bidib_messages.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
+
+namespace Bd {
+
+// node table versions run from 1 to 255, 0 is never used
+static quint8 nextVersion(quint8 version)
+{
+    return version == 255 ? 1 : version + 1;
+}
+
+class NodeTablePrivate
+{
+    Q_DECLARE_PUBLIC(NodeTable)
+
+public:
+    NodeTablePrivate(NodeTable *q, Host *host)
+        : q_ptr(q)
+        , host(host)
+    {}
+
+    struct Table
+    {
+        quint8 version{};
+        QMap<quint8, UniqueId> nodes;
+    };
+
+    void nodeTabRead(Address const &hub, quint8 version, QList<NodeTabEntry> const &entries);
+    void nodeNew(Address const &hub, quint8 version, NodeTabEntry const &entry);
+    void nodeLost(Address const &hub, quint8 version, NodeTabEntry const &entry);
+    bool follows(Address const &hub, quint8 version);
+    void resync(Address const &hub);
+    void added(Address const &hub, quint8 local, UniqueId const &uid);
+    void removed(Address const &hub, quint8 local, UniqueId const &uid);
+
+    NodeTable *const q_ptr;
+    Host *const host;
+
+    QHash<quint32, Table> tables;
+    QSet<quint32> resyncing;
+    qsizetype resyncs{0};
+};
+
+void NodeTablePrivate::nodeTabRead(Address const &hub,
+                                   quint8 version,
+                                   QList<NodeTabEntry> const &entries)
+{
+    QMap<quint8, UniqueId> nodes;
+    for (auto const &e : entries)
+        nodes.insert(e.local, e.uniqueId);
+
+    auto &table = tables[hub.core().stack()];
+    auto old = std::exchange(table.nodes, nodes);
+    table.version = version;
+    resyncing.remove(hub.core().stack());
+
+    // report the difference to what was known before
+    for (auto it = old.cbegin(); it != old.cend(); ++it) {
+        if (it.key() != 0 && nodes.value(it.key()) != it.value())
+            removed(hub, it.key(), it.value());
+    }
+    for (auto it = nodes.cbegin(); it != nodes.cend(); ++it) {
+        if (it.key() != 0 && (!old.contains(it.key()) || old.value(it.key()) != it.value()))
+            added(hub, it.key(), it.value());
+    }
+}
+
+void NodeTablePrivate::nodeNew(Address const &hub, quint8 version, NodeTabEntry const &entry)
+{
+    if (!follows(hub, version))
+        return;
+
+    auto &table = tables[hub.core().stack()];
+    table.version = version;
+    if (auto it = table.nodes.constFind(entry.local); it != table.nodes.cend())
+        removed(hub, entry.local, *it);
+    table.nodes.insert(entry.local, entry.uniqueId);
+    added(hub, entry.local, entry.uniqueId);
+}
+
+void NodeTablePrivate::nodeLost(Address const &hub, quint8 version, NodeTabEntry const &entry)
+{
+    if (!follows(hub, version))
+        return;
+
+    auto &table = tables[hub.core().stack()];
+    table.version = version;
+    table.nodes.remove(entry.local);
+    removed(hub, entry.local, entry.uniqueId);
+}
+
+// Whether a change with this version applies on top of the known table. Repeated changes are
+// dropped, anything else starts a full enumeration of the hub.
+bool NodeTablePrivate::follows(Address const &hub, quint8 version)
+{
+    auto stack = hub.core().stack();
+    if (resyncing.contains(stack))
+        return false;
+
+    auto it = tables.constFind(stack);
+    if (it != tables.cend()) {
+        if (it->version == version)
+            return false;
+        if (nextVersion(it->version) == version)
+            return true;
+    }
+
+    resync(hub);
+    return false;
+}
+
+void NodeTablePrivate::resync(Address const &hub)
+{
+    Q_Q(NodeTable);
+    resyncing.insert(hub.core().stack());
+    ++resyncs;
+    emit q->resyncStarted(hub);
+    host->readNodeTab(hub);
+}
+
+void NodeTablePrivate::added(Address const &hub, quint8 local, UniqueId const &uid)
+{
+    Q_Q(NodeTable);
+    if (auto child = hub.child(local))
+        emit q->nodeAdded(*child, uid);
+}
+
+void NodeTablePrivate::removed(Address const &hub, quint8 local, UniqueId const &uid)
+{
+    Q_Q(NodeTable);
+    auto child = hub.child(local);
+    if (!child)
+        return;
+
+    // the tables of everything below the node are gone with it
+    auto size = child->size();
+    auto mask = size == 4 ? ~quint32(0) : (quint32(1) << (8 * size)) - 1;
+    auto stack = child->core().stack();
+    tables.removeIf([&](auto const &it) { return (it.key() & mask) == stack; });
+    resyncing.removeIf([&](quint32 s) { return (s & mask) == stack; });
+
+    emit q->nodeRemoved(*child, uid);
+}
+
+NodeTable::NodeTable(Host *host)
+    : _d(new NodeTablePrivate(this, host))
+{
+    Q_D(NodeTable);
+    connect(host,
+            &Host::nodeTabRead,
+            this,
+            [d](Address const &hub, quint8 version, QList<NodeTabEntry> const &entries) {
+                d->nodeTabRead(hub, version, entries);
+            });
+    connect(host,
+            &Host::nodeNew,
+            this,
+            [d](Address const &hub, quint8 version, NodeTabEntry const &entry) {
+                d->nodeNew(hub, version, entry);
+            });
+    connect(host,
+            &Host::nodeLost,
+            this,
+            [d](Address const &hub, quint8 version, NodeTabEntry const &entry) {
+                d->nodeLost(hub, version, entry);
+            });
+    connect(host,
+            &Host::requestFailed,
+            this,
+            [d](Address const &hub, quint8 type, Error) {
+                // let the next change try again
+                if (type == MSG_NODETAB_GETALL)
+                    d->resyncing.remove(hub.core().stack());
+            });
+}
+
+NodeTable::~NodeTable() = default;
+
+std::optional<quint8> NodeTable::version(Address const &hub) const
+{
+    Q_D(const NodeTable);
+    auto it = d->tables.constFind(hub.core().stack());
+    if (it == d->tables.cend())
+        return std::nullopt;
+    return it->version;
+}
+
+QList<NodeTabEntry> NodeTable::entries(Address const &hub) const
+{
+    Q_D(const NodeTable);
+    QList<NodeTabEntry> result;
+    auto it = d->tables.constFind(hub.core().stack());
+    if (it == d->tables.cend())
+        return result;
+    for (auto e = it->nodes.cbegin(); e != it->nodes.cend(); ++e)
+        result << NodeTabEntry{e.key(), e.value()};
+    return result;
+}
+
+qsizetype NodeTable::resyncCount() const
+{
+    Q_D(const NodeTable);
+    return d->resyncs;
+}
+
+} // namespace Bd
@@ -0,0 +1,130 @@
+#include "occupancy.h"
+#include "bidib_messages.h"
+
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+
+namespace Bd {
+
+class OccupancyPrivate
+{
+    Q_DECLARE_PUBLIC(Occupancy)
+
+public:
+    explicit OccupancyPrivate(Occupancy *q)
+        : q_ptr(q)
+    {}
+
+    void single(Address const &address, Message const &msg);
+    void multiple(Address const &address, Message const &msg);
+    void report(Address const &address, Core::SectionSet const &changes);
+    void mirror(Address const &address, quint8 type, QByteArray const &payload);
+
+    Occupancy *const q_ptr;
+    QHash<quint32, Core::SectionSet> nodes;
+    bool acknowledge{true};
+};
+
+void OccupancyPrivate::single(Address const &address, Message const &msg)
+{
+    // MSG_BM_OCC may carry the time the section took to trigger, only the number matters here
+    auto args = Unpacker::unpack<quint8, std::optional<quint16>>(msg.payload());
+    if (!args) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+    auto section = std::get<0>(*args);
+    bool occupied = msg.type() == MSG_BM_OCC;
+
+    mirror(address,
+           occupied ? MSG_BM_MIRROR_OCC : MSG_BM_MIRROR_FREE,
+           Packer::pack(section));
+    report(address, nodes[address.core().stack()].set(section, occupied));
+}
+
+void OccupancyPrivate::multiple(Address const &address, Message const &msg)
+{
+    auto const &p = msg.payload();
+    if (p.size() < 2) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+    quint8 first = p[0];
+    quint8 count = p[1];
+    auto data = reinterpret_cast<std::uint8_t const *>(p.constData()) + 2;
+    auto size = std::min<std::size_t>(p.size() - 2, (count + 7) / 8);
+
+    mirror(address, MSG_BM_MIRROR_MULTIPLE, p);
+    report(address, nodes[address.core().stack()].assign(first, count, data, size));
+}
+
+void OccupancyPrivate::report(Address const &address, Core::SectionSet const &changes)
+{
+    Q_Q(Occupancy);
+    if (!changes.empty())
+        emit q->changed(address, changes, nodes.value(address.core().stack()));
+}
+
+void OccupancyPrivate::mirror(Address const &address, quint8 type, QByteArray const &payload)
+{
+    Q_Q(Occupancy);
+    if (acknowledge)
+        emit q->messageToSend(address, Message(type, payload));
+}
+
+Occupancy::Occupancy(QObject *parent)
+    : QObject(parent)
+    , _d(new OccupancyPrivate(this))
+{}
+
+Occupancy::~Occupancy() = default;
+
+void Occupancy::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(Occupancy);
+    switch (msg.type()) {
+    case MSG_BM_OCC:
+    case MSG_BM_FREE:
+        d->single(address, msg);
+        break;
+    case MSG_BM_MULTIPLE:
+        d->multiple(address, msg);
+        break;
+    }
+}
+
+Core::SectionSet Occupancy::sections(Address const &node) const
+{
+    Q_D(const Occupancy);
+    return d->nodes.value(node.core().stack());
+}
+
+bool Occupancy::occupied(Address const &node, quint8 section) const
+{
+    return sections(node).test(section);
+}
+
+void Occupancy::resync(Address const &node, quint8 first, quint8 end)
+{
+    emit messageToSend(node, Message::create<quint8, quint8>(MSG_BM_GET_RANGE, first, end));
+}
+
+void Occupancy::setAcknowledge(bool acknowledge)
+{
+    Q_D(Occupancy);
+    d->acknowledge = acknowledge;
+}
+
+bool Occupancy::acknowledge() const
+{
+    Q_D(const Occupancy);
+    return d->acknowledge;
+}
+
+void Occupancy::remove(Address const &node)
+{
+    Q_D(Occupancy);
+    d->nodes.remove(node.core().stack());
+}
+
+} // namespace Bd
@@ -0,0 +1,162 @@
+#include "remotenode.h"
+#include "bidib_messages.h"
+#include "host.h"
+
+#include <vector>
+
+namespace Bd {
+
+// The coroutines take host and address by value, a RemoteNode may be gone while they wait.
+
+static Task<UniqueId> uniqueIdRequest(Host *host, Address address)
+{
+    auto reply = co_await host->request(address,
+                                        Message(MSG_SYS_GET_UNIQUE_ID, {}),
+                                        {MSG_SYS_UNIQUE_ID});
+    if (!reply)
+        co_return tl::make_unexpected(reply.error());
+
+    auto args = Unpacker::unpack<UniqueId>(reply->payload());
+    if (!args)
+        co_return tl::make_unexpected(args.error());
+    co_return std::get<0>(*args);
+}
+
+static ReplyFilter featureFilter(quint8 feature)
+{
+    return {MSG_FEATURE, MSG_FEATURE_NA, Packer::pack(feature)};
+}
+
+static tl::expected<quint8, Error> featureValue(tl::expected<Message, Error> const &reply)
+{
+    if (!reply)
+        return tl::make_unexpected(reply.error());
+    if (reply->type() == MSG_FEATURE_NA)
+        return tl::make_unexpected(Error::NotAvailable);
+
+    auto args = Unpacker::unpack<quint8, quint8>(reply->payload());
+    if (!args)
+        return tl::make_unexpected(args.error());
+    return std::get<1>(*args);
+}
+
+static Task<quint8> featureRequest(Host *host, Address address, Message request, quint8 feature)
+{
+    co_return featureValue(co_await host->request(address, request, featureFilter(feature)));
+}
+
+static Task<Message> singleRequest(Host *host, Address address, Message request, ReplyFilter filter)
+{
+    co_return co_await host->request(address, request, std::move(filter));
+}
+
+static Task<QList<tl::expected<Message, Error>>> bulkRequest(Host *host,
+                                                            Address address,
+                                                            QList<RemoteNode::Request> requests)
+{
+    // all of them are queued at the host right away, its window paces them
+    std::vector<Task<Message>> pending;
+    pending.reserve(requests.size());
+    for (auto const &[request, filter] : std::as_const(requests))
+        pending.push_back(singleRequest(host, address, request, filter));
+
+    QList<tl::expected<Message, Error>> replies;
+    replies.reserve(requests.size());
+    for (auto &task : pending)
+        replies << co_await std::move(task);
+    co_return replies;
+}
+
+static Task<QList<tl::expected<quint8, Error>>> featuresRequest(Host *host,
+                                                               Address address,
+                                                               QList<quint8> features)
+{
+    QList<RemoteNode::Request> requests;
+    requests.reserve(features.size());
+    for (auto feature : std::as_const(features))
+        requests.append({Message::create<quint8>(MSG_FEATURE_GET, feature),
+                         featureFilter(feature)});
+
+    auto replies = co_await bulkRequest(host, address, requests);
+    QList<tl::expected<quint8, Error>> values;
+    values.reserve(features.size());
+    for (auto const &reply : std::as_const(*replies))
+        values << featureValue(reply);
+    co_return values;
+}
+
+static Task<AccessoryState> accessoryRequest(Host *host,
+                                             Address address,
+                                             Message request,
+                                             quint8 number)
+{
+    auto reply = co_await host->request(address,
+                                        request,
+                                        {MSG_ACCESSORY_STATE, {}, Packer::pack(number)});
+    if (!reply)
+        co_return tl::make_unexpected(reply.error());
+
+    auto args = Unpacker::unpack<quint8, quint8, quint8, quint8, quint8>(reply->payload());
+    if (!args)
+        co_return tl::make_unexpected(args.error());
+    auto [anum, aspect, total, execute, wait] = *args;
+    co_return AccessoryState{anum, aspect, total, execute, wait};
+}
+
+RemoteNode::RemoteNode(Host *host, Address const &address)
+    : _host(host)
+    , _address(address)
+{}
+
+Host *RemoteNode::host() const
+{
+    return _host;
+}
+
+Address RemoteNode::address() const
+{
+    return _address;
+}
+
+Task<UniqueId> RemoteNode::getUniqueId() const
+{
+    return uniqueIdRequest(_host, _address);
+}
+
+Task<quint8> RemoteNode::getFeature(quint8 feature) const
+{
+    return featureRequest(_host,
+                          _address,
+                          Message::create<quint8>(MSG_FEATURE_GET, feature),
+                          feature);
+}
+
+Task<quint8> RemoteNode::setFeature(quint8 feature, quint8 value) const
+{
+    return featureRequest(_host,
+                          _address,
+                          Message::create<quint8, quint8>(MSG_FEATURE_SET, feature, value),
+                          feature);
+}
+
+Task<QList<tl::expected<quint8, Error>>> RemoteNode::getFeatures(
+    QList<quint8> const &features) const
+{
+    return featuresRequest(_host, _address, features);
+}
+
+Task<QList<tl::expected<Message, Error>>> RemoteNode::requestAll(
+    QList<Request> const &requests) const
+{
+    return bulkRequest(_host, _address, requests);
+}
+
+Task<AccessoryState> RemoteNode::setAccessory(quint8 number, quint8 aspect) const
+{
+    return accessoryRequest(_host,
+                            _address,
+                            Message::create<quint8, quint8>(MSG_ACCESSORY_SET, number, aspect),
+                            number);
+}
+
+} // namespace Bd
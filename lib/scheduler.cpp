@@ -0,0 +1,103 @@
+#include "scheduler.h"
+
+#include <bidib/core/timerwheel.h>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTimer>
+
+namespace Bd {
+
+class SchedulerPrivate
+{
+    Q_DECLARE_PUBLIC(Scheduler)
+
+public:
+    explicit SchedulerPrivate(Scheduler *q)
+        : q_ptr(q)
+    {}
+
+    quint64 now() const { return quint64(clock.elapsed()); }
+    void run();
+    void arm();
+
+    Scheduler *const q_ptr;
+    Core::TimerWheel<std::function<void()>> wheel;
+    QElapsedTimer clock;
+    QTimer timer;
+    // the tick the timer goes off at while active
+    quint64 armed{};
+    bool running{false};
+};
+
+void SchedulerPrivate::run()
+{
+    running = true;
+    wheel.advance(now(), [](std::function<void()> &callback) { callback(); });
+    running = false;
+    arm();
+}
+
+// Wakes up for the next tick anything is due at, which is never earlier than needed and at most
+// once per cascade of the wheel for timers far out.
+void SchedulerPrivate::arm()
+{
+    if (running)
+        return;
+    auto next = wheel.nextTick();
+    if (!next) {
+        timer.stop();
+        return;
+    }
+    if (timer.isActive() && armed <= *next)
+        return;
+    armed = *next;
+    auto delay = *next > now() ? *next - now() : 0;
+    timer.start(std::chrono::milliseconds(delay));
+}
+
+Scheduler::Scheduler(QObject *parent)
+    : QObject(parent)
+    , _d(new SchedulerPrivate(this))
+{
+    Q_D(Scheduler);
+    d->clock.start();
+    d->timer.setSingleShot(true);
+    d->timer.setTimerType(Qt::PreciseTimer);
+    connect(&d->timer, &QTimer::timeout, this, [d] { d->run(); });
+}
+
+Scheduler::~Scheduler() = default;
+
+Scheduler::Id Scheduler::schedule(std::chrono::milliseconds delay, std::function<void()> callback)
+{
+    Q_D(Scheduler);
+    // the current millisecond may be processed already, round up so nothing goes off early
+    auto id = d->wheel.schedule(d->now() + std::max<qint64>(delay.count(), 0) + 1,
+                                std::move(callback));
+    d->arm();
+    return id;
+}
+
+Scheduler::Id Scheduler::every(std::chrono::milliseconds interval, std::function<void()> callback)
+{
+    Q_D(Scheduler);
+    auto period = quint64(std::max<qint64>(interval.count(), 1));
+    auto id = d->wheel.schedule(d->now() + period + 1, std::move(callback), period);
+    d->arm();
+    return id;
+}
+
+bool Scheduler::cancel(Id timer)
+{
+    Q_D(Scheduler);
+    // the QTimer may go off for nothing once, cheaper than finding the next timer again
+    return timer != 0 && d->wheel.cancel(timer);
+}
+
+qsizetype Scheduler::size() const
+{
+    Q_D(const Scheduler);
+    return qsizetype(d->wheel.size());
+}
+
+} // namespace Bd
@@ -1,31 +1,191 @@
 #include "serialconnection.h"
+#include "address.h"
+#include "bidib_messages.h"
+#include "message.h"
+#include "serialtransport.h"
 
 #include <QSerialPort>
+#include <QTimer>
 
-#include <QtCore/private/qobject_p.h>
+#ifdef Q_OS_LINUX
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
 
 namespace Bd {
 
-class SerialConnectionPrivate : public QObjectPrivate
+class SerialConnectionPrivate
 {
 public:
     Q_DECLARE_PUBLIC(SerialConnection)
+
+    explicit SerialConnectionPrivate(SerialConnection *q)
+        : q_ptr(q)
+    {}
+
+    void probeNext();
+    void probeMessage(Address const &address, Message const &msg);
+
+    SerialConnection *const q_ptr;
     QSerialPort serial;
+    SerialProfile profile{SerialConnection::profileForBaudRate(QSerialPort::Baud115200)};
+
+    // baud rate detection
+    QList<SerialProfile> candidates;
+    QTimer probeTimer;
+    QScopedPointer<SerialTransport> probe;
 };
 
+void SerialConnectionPrivate::probeNext()
+{
+    Q_Q(SerialConnection);
+
+    // candidates are sorted ascending, so the first rate that answers is the fastest one
+    while (!candidates.isEmpty()) {
+        auto candidate = candidates.takeLast();
+        if (!q->open(candidate))
+            continue;
+
+        probe.reset(new SerialTransport);
+        QObject::connect(probe.data(),
+                         &SerialTransport::messageReceived,
+                         q,
+                         [this](Address address, Message msg) { probeMessage(address, msg); });
+
+        serial.clear();
+        auto magic = Message(MSG_SYS_GET_MAGIC, {}).toSendBuffer(Address::localNode(), 0);
+        serial.write(SerialTransport::frame(*magic));
+        probeTimer.start();
+        return;
+    }
+
+    probe.reset();
+    emit q->baudRateDetectionFailed();
+}
+
+void SerialConnectionPrivate::probeMessage(Address const &address, Message const &msg)
+{
+    Q_Q(SerialConnection);
+
+    if (!address.isLocalNode() || msg.type() != MSG_SYS_MAGIC)
+        return;
+
+    probeTimer.stop();
+    candidates.clear();
+    // the transport is still emitting, so it must not be deleted right here
+    probe.take()->deleteLater();
+    emit q->baudRateDetected(profile.baudRate);
+}
+
 SerialConnection::SerialConnection(QString const &port)
-    : QObject(*new SerialConnectionPrivate)
+    : _d(new SerialConnectionPrivate(this))
 {
     Q_D(SerialConnection);
+    d->serial.setPortName(port);
+    d->probeTimer.setSingleShot(true);
     connect(&d->serial, &QSerialPort::readyRead, this, &SerialConnection::readData);
+    connect(&d->probeTimer, &QTimer::timeout, this, [d] { d->probeNext(); });
+}
+
+SerialConnection::~SerialConnection() = default;
+
+bool SerialConnection::open(SerialProfile const &profile)
+{
+    Q_D(SerialConnection);
+    if (!d->serial.isOpen() && !d->serial.open(QIODevice::ReadWrite))
+        return false;
+    if (!applyProfile(d->serial, profile))
+        return false;
+    d->profile = profile;
+    return true;
+}
+
+void SerialConnection::close()
+{
+    Q_D(SerialConnection);
+    d->probeTimer.stop();
+    d->candidates.clear();
+    d->probe.reset();
+    d->serial.close();
+}
+
+SerialProfile SerialConnection::profile() const
+{
+    Q_D(const SerialConnection);
+    return d->profile;
+}
+
+void SerialConnection::detectBaudRate(std::chrono::milliseconds probeTimeout)
+{
+    Q_D(SerialConnection);
+    d->candidates = profiles();
+    d->probeTimer.setInterval(probeTimeout);
+    d->probeNext();
+}
+
+QList<SerialProfile> const &SerialConnection::profiles()
+{
+    static const QList<SerialProfile> Profiles{
+        {19200, 64, false},
+        {115200, 256, true},
+        {1000000, 1024, true},
+        {1500000, 2048, true},
+        {2000000, 4096, true},
+        {3000000, 4096, true},
+    };
+    return Profiles;
+}
+
+SerialProfile SerialConnection::profileForBaudRate(qint32 baudRate)
+{
+    // unknown rates use the tuning of the next slower known rate
+    auto result = profiles().first();
+    for (auto const &p : profiles()) {
+        if (p.baudRate > baudRate)
+            break;
+        result = p;
+    }
+    result.baudRate = baudRate;
+    return result;
+}
+
+bool SerialConnection::applyProfile(QSerialPort &serial, SerialProfile const &profile)
+{
+    if (!serial.setBaudRate(profile.baudRate))
+        return false;
+    serial.setDataBits(QSerialPort::Data8);
+    serial.setParity(QSerialPort::NoParity);
+    serial.setStopBits(QSerialPort::OneStop);
+
+#ifdef Q_OS_LINUX
+    if (serial.isOpen()) {
+        // not supported by ptys and some USB adapters, so failing here is not an error
+        serial_struct ss{};
+        if (::ioctl(serial.handle(), TIOCGSERIAL, &ss) == 0) {
+            if (profile.lowLatency)
+                ss.flags |= ASYNC_LOW_LATENCY;
+            else
+                ss.flags &= ~ASYNC_LOW_LATENCY;
+            ::ioctl(serial.handle(), TIOCSSERIAL, &ss);
+        }
+    }
+#endif
+
+    return true;
 }
 
 void SerialConnection::readData()
 {
     Q_D(SerialConnection);
-    auto data = d->serial.readAll();
-    if (!data.isEmpty())
-        emit dataReceived(data);
+    while (d->serial.bytesAvailable() > 0) {
+        auto data = d->serial.read(d->profile.readChunkSize);
+        if (data.isEmpty())
+            break;
+        if (d->probe)
+            d->probe->processData(data);
+        else
+            emit dataReceived(data);
+    }
 }
 
 void SerialConnection::sendData(QByteArray const &data)
@@ -1,124 +1,124 @@
 #include "serialtransport.h"
 #include "bidib_messages.h"
+#include "bytes.h"
 #include "crc.h"
 #include "message.h"
 
-#include <QtCore/private/qobject_p.h>
+#include <bidib/core/errors.h>
+#include <bidib/core/frame.h>
+
+#include <QtCore/QMetaMethod>
 
 namespace Bd {
 
-class SerialTransportPrivate : public QObjectPrivate
+class SerialTransportPrivate
 {
 public:
     Q_DECLARE_PUBLIC(SerialTransport)
 
-    void processData(QByteArray data);
-    void processFrame(QByteArray frame);
-    tl::expected<std::tuple<Address, Message>, Error> parseMessageData(QByteArrayView data);
+    explicit SerialTransportPrivate(SerialTransport *q)
+        : q_ptr(q)
+    {}
+
+    // Core::FrameSink
+    void frame(std::span<const std::byte> frame);
+    void message(Core::MessageView const &msg);
+    void error(Error error, std::span<const std::byte> data);
 
-    QByteArray currentFrame;
+    SerialTransport *const q_ptr;
+    Core::FrameDecoder<> decoder;
+    TransportSink *sink{};
+    Core::ErrorCounters errors;
+    Core::SampleLimiter errorSampler{8, std::chrono::milliseconds(100)};
 };
 
-void SerialTransportPrivate::processData(QByteArray data)
+void SerialTransportPrivate::frame(std::span<const std::byte> frame)
 {
     Q_Q(SerialTransport);
+    static const auto signal = QMetaMethod::fromSignal(&SerialTransport::frameReceived);
 
-    auto from = 0;
-    auto to = data.indexOf(static_cast<quint8>(BIDIB_PKT_MAGIC), from);
-
-    // skip leading garbage
-    if (currentFrame.isEmpty() && to > 0)
-        from = to;
-
-    while (to >= 0) {
-        auto count = to - from;
-        if (count) {
-            currentFrame.append(data.sliced(from, count));
-            if (!currentFrame.isEmpty()) {
-                emit q->frameReceived(currentFrame);
-                processFrame(currentFrame);
-                currentFrame.clear();
-            }
-        }
-        from = to + 1;
-        to = data.indexOf(static_cast<quint8>(BIDIB_PKT_MAGIC), from);
-    }
-    currentFrame.append(data.sliced(from));
+    if (sink)
+        sink->frameReceived(frame);
+    if (q->isSignalConnected(signal))
+        emit q->frameReceived(toByteArray(frame));
 }
 
-void SerialTransportPrivate::processFrame(QByteArray frame)
+void SerialTransportPrivate::message(Core::MessageView const &msg)
 {
     Q_Q(SerialTransport);
+    static const auto signal = QMetaMethod::fromSignal(&SerialTransport::messageReceived);
 
-    if (frame.isEmpty())
-        // empty frame is no error
-        return;
+    if (sink)
+        sink->messageReceived(msg);
+    if (q->isSignalConnected(signal))
+        emit q->messageReceived(Address(msg.address), Message(msg.type, toByteArray(msg.payload)));
+}
 
-    if (computeCrc8(frame) != 0) {
-        emit q->errorOccurred(Error::BadChecksum, frame);
-        return;
-    }
+void SerialTransportPrivate::error(Error error, std::span<const std::byte> data)
+{
+    Q_Q(SerialTransport);
+    static const auto signal = QMetaMethod::fromSignal(&SerialTransport::errorOccurred);
 
-    // remove checksum byte
-    auto data = frame.first(frame.size() - 1);
+    errors.count(error);
+    if (sink)
+        sink->errorOccurred(error, data);
+    if (q->isSignalConnected(signal) && errorSampler.admit(Core::SampleLimiter::Clock::now()))
+        emit q->errorOccurred(error, toByteArray(data));
+}
 
-    int pos = 0;
-    // the last byte contains the checksum
-    while (pos < data.size()) {
-        quint8 len = data[pos];
+SerialTransport::SerialTransport(QObject *parent)
+    : QObject(parent)
+    , _d(new SerialTransportPrivate(this))
+{}
 
-        auto msgData = data.mid(pos + 1, len);
-        if (msgData.size() < len) {
-            emit q->errorOccurred(Error::OutOfData, msgData);
-            return;
-        }
+SerialTransport::~SerialTransport() = default;
 
-        auto parsed = parseMessageData(msgData);
-        if (parsed) {
-            auto [address, message] = *parsed;
-            emit q->messageReceived(address, message);
-        } else {
-            emit q->errorOccurred(parsed.error(), msgData);
-        }
+void SerialTransport::setSink(TransportSink *sink)
+{
+    Q_D(SerialTransport);
+    d->sink = sink;
+}
 
-        pos += len + 1;
-    }
+TransportSink *SerialTransport::sink() const
+{
+    Q_D(const SerialTransport);
+    return d->sink;
 }
 
-tl::expected<std::tuple<Address, Message>, Error> SerialTransportPrivate::parseMessageData(
-    QByteArrayView data)
+quint64 SerialTransport::errorCount(Error error) const
 {
-    auto address = Address::parse(data);
-    if (!address)
-        return tl::make_unexpected(address.error());
-
-    auto i = address->size() + 1; // skip trailing zero
-    if (data.size() - i < 2)
-        return tl::make_unexpected(Error::MessageMalformed);
-
-    // TODO: implement sequence check
-    auto num = data[i++];
-    auto type = data[i++];
-    QByteArray payload;
-    if (i < data.size())
-        payload = data.sliced(i).toByteArray();
-    return std::make_tuple(*address, Message(type, payload));
+    Q_D(const SerialTransport);
+    return d->errors.count(error);
 }
 
-SerialTransport::SerialTransport(QObject *parent)
-    : QObject(*new SerialTransportPrivate, parent)
-{}
+quint64 SerialTransport::totalErrorCount() const
+{
+    Q_D(const SerialTransport);
+    return d->errors.total();
+}
+
+void SerialTransport::resetErrorCounts()
+{
+    Q_D(SerialTransport);
+    d->errors.reset();
+}
+
+void SerialTransport::setErrorSampling(quint32 burst, std::chrono::milliseconds interval)
+{
+    Q_D(SerialTransport);
+    d->errorSampler = Core::SampleLimiter(burst, interval);
+}
 
 void SerialTransport::processData(QByteArray data)
 {
     Q_D(SerialTransport);
-    d->processData(data);
+    d->decoder.feed(asBytes(data), *d);
 }
 
 void SerialTransport::processFrame(QByteArray frame)
 {
     Q_D(SerialTransport);
-    d->processFrame(frame);
+    Core::decodeFrame(asBytes(frame), *d);
 }
 
 QByteArray SerialTransport::escape(QByteArray const &ba)
@@ -140,6 +140,16 @@ QByteArray SerialTransport::escape(QByteArray const &ba)
     return result;
 }
 
+QByteArray SerialTransport::frame(QByteArray const &messages)
+{
+    auto data = messages;
+    data.append(computeCrc8(messages));
+    auto result = escape(data);
+    result.prepend(static_cast<quint8>(BIDIB_PKT_MAGIC));
+    result.append(static_cast<quint8>(BIDIB_PKT_MAGIC));
+    return result;
+}
+
 tl::expected<QByteArray, Error> SerialTransport::unescape(QByteArray const &ba)
 {
     if (ba.isEmpty())
@@ -0,0 +1,1012 @@
+#include "simulator.h"
+#include "bidib_messages.h"
+
+#include <bidib/core/accessories.h>
+#include <bidib/core/features.h>
+#include <bidib/core/macros.h>
+#include <bidib/core/portconfig.h>
+#include <bidib/core/ports.h>
+#include <bidib/scheduler.h>
+
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+
+#include <array>
+#include <bitset>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace Bd {
+
+using NodeIndex = Simulator::NodeIndex;
+using NodeKind = Simulator::NodeKind;
+
+static constexpr NodeIndex NoNode = -1;
+static constexpr quint8 MaxChildren = 127;
+static constexpr quint8 SectionsPerNode = 16;
+static constexpr quint8 AccessoriesPerNode = 16;
+static constexpr quint8 AspectsPerAccessory = 2;
+// in MSG_ACCESSORY_STATE units of 100 ms
+static constexpr quint8 AccessoryWait = 2;
+static constexpr quint8 MacrosPerNode = 16;
+static constexpr quint8 StepsPerMacro = 32;
+static constexpr std::chrono::milliseconds MacroTick{20};
+static constexpr quint16 FeatureCursorIdle = 0x100;
+static constexpr NodeIndex NodeTabCursorIdle = -2;
+static constexpr NodeIndex NodeTabCursorSelf = -1;
+
+// node table versions run from 1 to 255, 0 is never used
+static quint8 nextVersion(quint8 version)
+{
+    return version == 255 ? 1 : version + 1;
+}
+
+struct Version
+{
+    quint8 patch, minor, major;
+};
+static_assert(sizeof(Version) == 3);
+
+struct KeyValue8
+{
+    quint8 id;
+    quint8 value;
+};
+
+class SimulatorPrivate
+{
+    Q_DECLARE_PUBLIC(Simulator)
+
+public:
+    explicit SimulatorPrivate(Simulator *q)
+        : q_ptr(q)
+    {}
+
+    NodeIndex addNode(NodeIndex parent, quint32 address, NodeKind kind);
+    void removeSubtree(NodeIndex node);
+    quint8 local(NodeIndex node) const;
+    void handleMessage(NodeIndex node, Message const &msg);
+    void measure(NodeIndex node);
+    void startMeasurement(NodeIndex node);
+    void sendPortConfig(NodeIndex node, quint16 index);
+    void setPort(NodeIndex node, quint16 port, quint8 state);
+    void startMacro(NodeIndex node, quint8 macro);
+    void tickMacros();
+
+    template<class... Types>
+    void send(NodeIndex node, int type, Types const &...t)
+    {
+        Q_Q(Simulator);
+        emit q->messageOut(Address(address[node]), Message::create(type, t...));
+    }
+
+    Simulator *const q_ptr;
+
+    // one entry per node in every column
+    std::vector<quint32> address;
+    std::vector<NodeKind> kind;
+    std::vector<UniqueId> uniqueId;
+    std::vector<NodeIndex> parent;
+    std::vector<NodeIndex> firstChild;
+    std::vector<NodeIndex> lastChild;
+    std::vector<NodeIndex> nextSibling;
+    std::vector<quint8> childCount;
+    std::vector<quint8> present;
+    std::vector<quint8> nodeTabVersion;
+    std::vector<NodeIndex> nodeTabCursor;
+    std::vector<Core::FeatureTable> features;
+    std::vector<quint16> featureCursor;
+    std::vector<QString> userName;
+    std::vector<quint8> boosterState;
+    std::vector<quint16> occupancy;
+    // empty for all but light control nodes
+    std::vector<Core::PortTable> ports;
+    std::vector<Core::PortConfig> portConfig;
+    std::vector<Core::MacroEngine> macros;
+    // light control nodes with running macros, all ticked by one timer while there are any
+    QList<NodeIndex> macroNodes;
+    Scheduler::Id macroTimer{};
+    quint64 macroTick{};
+    // empty for all but accessory nodes
+    std::vector<Core::AccessoryBank> accessories;
+    // running movements by node << 8 | accessory
+    QHash<qint64, Scheduler::Id> movements;
+
+    QHash<quint32, NodeIndex> byAddress;
+    // measurement timer of every booster, running at its FEATURE_BST_CURMEAS_INTERVAL
+    QHash<NodeIndex, Scheduler::Id> boosters;
+    // measurement intervals and other delayed node behaviour share one timer wheel
+    Scheduler scheduler;
+
+private:
+    void handleSysGetMagic(NodeIndex node);
+    void handleSysGetPVersion(NodeIndex node);
+    void handleSysGetUniqueId(NodeIndex node);
+    void handleSysGetSwVersion(NodeIndex node);
+    void handleSysPing(NodeIndex node, quint8 dat);
+    void handleGetPktCapacity(NodeIndex node);
+    void handleNodeTabGetAll(NodeIndex node);
+    void handleNodeTabGetNext(NodeIndex node);
+    void handleNodeChangedAck(NodeIndex node, quint8 version);
+    void handleFeatureGetAll(NodeIndex node, std::optional<quint8> shouldStream);
+    void handleFeatureGetNext(NodeIndex node);
+    void handleFeatureGet(NodeIndex node, quint8 id);
+    void handleFeatureSet(NodeIndex node, quint8 id, quint8 value);
+    void handleStringGet(NodeIndex node, quint8 ns, quint8 id);
+    void handleStringSet(NodeIndex node, quint8 ns, quint8 id, QString s);
+    void handleBoostOn(NodeIndex node, std::optional<quint8> unicast);
+    void handleBoostOff(NodeIndex node, std::optional<quint8> unicast);
+    void handleBoostQuery(NodeIndex node);
+    void handleBmGetRange(NodeIndex node, quint8 start, quint8 end);
+    void handleBmMirror(NodeIndex node);
+    void handleAccessorySet(NodeIndex node, quint8 number, quint8 aspect);
+    void handleAccessoryGet(NodeIndex node, quint8 number);
+    void handleAccessoryGetAll(NodeIndex node);
+    void handleLcOutput(NodeIndex node, quint16 port, quint8 state);
+    void handleLcPortQuery(NodeIndex node, quint16 port);
+    void handleLcPortQueryAll(NodeIndex node,
+                              std::optional<quint16> select,
+                              std::optional<quint16> start,
+                              std::optional<quint16> end);
+    void handleLcConfigXSet(NodeIndex node, quint16 port, std::span<const std::byte> params);
+    void handleLcConfigXGet(NodeIndex node, quint16 port);
+    void handleLcConfigXGetAll(NodeIndex node,
+                               std::optional<quint16> start,
+                               std::optional<quint16> end);
+    void handleLcMacroHandle(NodeIndex node, quint8 macro, quint8 opcode);
+    void handleLcMacroSet(NodeIndex node, quint8 macro, quint8 item, Core::MacroStep step);
+    void handleLcMacroGet(NodeIndex node, quint8 macro, quint8 item);
+    void handleLcMacroParaSet(NodeIndex node, quint8 macro, quint8 index, quint32 value);
+    void handleLcMacroParaGet(NodeIndex node, quint8 macro, quint8 index);
+
+    using Handler = void (*)(SimulatorPrivate &d, NodeIndex node, Message const &msg);
+
+    template<auto Fn>
+    struct Invoke;
+
+    template<typename... Args, void (SimulatorPrivate::*Fn)(NodeIndex, Args...)>
+    struct Invoke<Fn>
+    {
+        static void call(SimulatorPrivate &d, NodeIndex node, Message const &msg)
+        {
+            auto args = Unpacker::unpack<Args...>(msg.payload());
+            if (args)
+                std::apply([&](auto &&...a) { (d.*Fn)(node, a...); }, *args);
+            else
+                qCritical() << "error unpacking args:" << args.error() << msg;
+        }
+    };
+
+    static std::array<Handler, 256> const &handlers();
+};
+
+std::array<SimulatorPrivate::Handler, 256> const &SimulatorPrivate::handlers()
+{
+    // shared by all nodes, the node kind only changes which features are reported
+    static const auto Handlers = [] {
+        std::array<Handler, 256> h{};
+        h[MSG_SYS_GET_MAGIC] = &Invoke<&SimulatorPrivate::handleSysGetMagic>::call;
+        h[MSG_SYS_GET_P_VERSION] = &Invoke<&SimulatorPrivate::handleSysGetPVersion>::call;
+        h[MSG_SYS_GET_UNIQUE_ID] = &Invoke<&SimulatorPrivate::handleSysGetUniqueId>::call;
+        h[MSG_SYS_GET_SW_VERSION] = &Invoke<&SimulatorPrivate::handleSysGetSwVersion>::call;
+        h[MSG_SYS_PING] = &Invoke<&SimulatorPrivate::handleSysPing>::call;
+        h[MSG_GET_PKT_CAPACITY] = &Invoke<&SimulatorPrivate::handleGetPktCapacity>::call;
+        h[MSG_NODETAB_GETALL] = &Invoke<&SimulatorPrivate::handleNodeTabGetAll>::call;
+        h[MSG_NODETAB_GETNEXT] = &Invoke<&SimulatorPrivate::handleNodeTabGetNext>::call;
+        h[MSG_NODE_CHANGED_ACK] = &Invoke<&SimulatorPrivate::handleNodeChangedAck>::call;
+        h[MSG_FEATURE_GETALL] = &Invoke<&SimulatorPrivate::handleFeatureGetAll>::call;
+        h[MSG_FEATURE_GETNEXT] = &Invoke<&SimulatorPrivate::handleFeatureGetNext>::call;
+        h[MSG_FEATURE_GET] = &Invoke<&SimulatorPrivate::handleFeatureGet>::call;
+        h[MSG_FEATURE_SET] = &Invoke<&SimulatorPrivate::handleFeatureSet>::call;
+        h[MSG_STRING_GET] = &Invoke<&SimulatorPrivate::handleStringGet>::call;
+        h[MSG_STRING_SET] = &Invoke<&SimulatorPrivate::handleStringSet>::call;
+        h[MSG_BOOST_ON] = &Invoke<&SimulatorPrivate::handleBoostOn>::call;
+        h[MSG_BOOST_OFF] = &Invoke<&SimulatorPrivate::handleBoostOff>::call;
+        h[MSG_BOOST_QUERY] = &Invoke<&SimulatorPrivate::handleBoostQuery>::call;
+        h[MSG_BM_GET_RANGE] = &Invoke<&SimulatorPrivate::handleBmGetRange>::call;
+        h[MSG_BM_MIRROR_OCC] = &Invoke<&SimulatorPrivate::handleBmMirror>::call;
+        h[MSG_BM_MIRROR_FREE] = &Invoke<&SimulatorPrivate::handleBmMirror>::call;
+        h[MSG_BM_MIRROR_MULTIPLE] = &Invoke<&SimulatorPrivate::handleBmMirror>::call;
+        h[MSG_ACCESSORY_SET] = &Invoke<&SimulatorPrivate::handleAccessorySet>::call;
+        h[MSG_ACCESSORY_GET] = &Invoke<&SimulatorPrivate::handleAccessoryGet>::call;
+        h[MSG_ACCESSORY_GETALL] = &Invoke<&SimulatorPrivate::handleAccessoryGetAll>::call;
+        h[MSG_LC_OUTPUT] = &Invoke<&SimulatorPrivate::handleLcOutput>::call;
+        h[MSG_LC_PORT_QUERY] = &Invoke<&SimulatorPrivate::handleLcPortQuery>::call;
+        h[MSG_LC_PORT_QUERY_ALL] = &Invoke<&SimulatorPrivate::handleLcPortQueryAll>::call;
+        h[MSG_LC_CONFIGX_SET] = &Invoke<&SimulatorPrivate::handleLcConfigXSet>::call;
+        h[MSG_LC_CONFIGX_GET] = &Invoke<&SimulatorPrivate::handleLcConfigXGet>::call;
+        h[MSG_LC_CONFIGX_GET_ALL] = &Invoke<&SimulatorPrivate::handleLcConfigXGetAll>::call;
+        h[MSG_LC_MACRO_HANDLE] = &Invoke<&SimulatorPrivate::handleLcMacroHandle>::call;
+        h[MSG_LC_MACRO_SET] = &Invoke<&SimulatorPrivate::handleLcMacroSet>::call;
+        h[MSG_LC_MACRO_GET] = &Invoke<&SimulatorPrivate::handleLcMacroGet>::call;
+        h[MSG_LC_MACRO_PARA_SET] = &Invoke<&SimulatorPrivate::handleLcMacroParaSet>::call;
+        h[MSG_LC_MACRO_PARA_GET] = &Invoke<&SimulatorPrivate::handleLcMacroParaGet>::call;
+        return h;
+    }();
+    return Handlers;
+}
+
+// answer for an accessory number the node does not have
+static constexpr Core::AccessoryCell VoidAccessory{
+    0xff,
+    0,
+    Core::AccessoryCell::Error,
+    Core::AccessoryCell::ErrorVoid,
+};
+
+static quint8 classOf(NodeKind kind)
+{
+    switch (kind) {
+    case NodeKind::Interface:
+    case NodeKind::Hub:
+        return UniqueId::ClassBridge;
+    case NodeKind::Occupancy:
+        return UniqueId::ClassOccupancy;
+    case NodeKind::Booster:
+        return UniqueId::ClassBooster;
+    case NodeKind::Accessory:
+        return UniqueId::ClassAccessory;
+    case NodeKind::LightControl:
+        return UniqueId::ClassSwitch;
+    }
+    return 0;
+}
+
+static QString productName(NodeKind kind)
+{
+    switch (kind) {
+    case NodeKind::Interface:
+        return QStringLiteral("SimInterface");
+    case NodeKind::Hub:
+        return QStringLiteral("SimHub");
+    case NodeKind::Occupancy:
+        return QStringLiteral("SimOccupancy");
+    case NodeKind::Booster:
+        return QStringLiteral("SimBooster");
+    case NodeKind::Accessory:
+        return QStringLiteral("SimAccessory");
+    case NodeKind::LightControl:
+        return QStringLiteral("SimLightControl");
+    }
+    return {};
+}
+
+static Core::PortTable lightControlPorts()
+{
+    return {
+        {BIDIB_PORTTYPE_SWITCH, 32},
+        {BIDIB_PORTTYPE_LIGHT, 16},
+        {BIDIB_PORTTYPE_SERVO, 8},
+        {BIDIB_PORTTYPE_INPUT, 8},
+    };
+}
+
+// light and servo ports come configured, the others once the host sets something
+static Core::PortConfig defaultPortConfig(Core::PortTable const &ports)
+{
+    Core::PortConfig config(ports.size());
+    for (quint16 i = 0; i < ports.size(); ++i) {
+        switch (ports.type(i)) {
+        case BIDIB_PORTTYPE_LIGHT:
+            config.set(i, {BIDIB_PCFG_LEVEL_PORT_ON, 255});
+            config.set(i, {BIDIB_PCFG_LEVEL_PORT_OFF, 0});
+            config.set(i, {BIDIB_PCFG_DIMM_UP_8_8, 0x0800});
+            config.set(i, {BIDIB_PCFG_DIMM_DOWN_8_8, 0x0800});
+            break;
+        case BIDIB_PORTTYPE_SERVO:
+            config.set(i, {BIDIB_PCFG_SERVO_ADJ_L, 64});
+            config.set(i, {BIDIB_PCFG_SERVO_ADJ_H, 192});
+            config.set(i, {BIDIB_PCFG_SERVO_SPEED, 4});
+            break;
+        }
+    }
+    return config;
+}
+
+static Core::FeatureTable defaultFeatures(NodeKind kind)
+{
+    Core::FeatureTable f{{FEATURE_STRING_SIZE, 24}};
+    switch (kind) {
+    case NodeKind::Interface:
+    case NodeKind::Hub:
+        break;
+    case NodeKind::Occupancy:
+        f.set(FEATURE_BM_SIZE, SectionsPerNode);
+        f.set(FEATURE_BM_ON, 1);
+        break;
+    case NodeKind::Booster:
+        f.set(FEATURE_BST_AMPERE, 147);
+        f.set(FEATURE_BST_CURMEAS_INTERVAL, 100);
+        f.set(FEATURE_BST_CUTOUT_AVAILABLE, 1);
+        f.set(FEATURE_BST_VOLT, 12);
+        break;
+    case NodeKind::Accessory:
+        f.set(FEATURE_ACCESSORY_COUNT, AccessoriesPerNode);
+        break;
+    case NodeKind::LightControl: {
+        auto ports = lightControlPorts();
+        f.set(FEATURE_CTRL_INPUT_COUNT, ports.count(BIDIB_PORTTYPE_INPUT));
+        f.set(FEATURE_CTRL_SWITCH_COUNT, ports.count(BIDIB_PORTTYPE_SWITCH));
+        f.set(FEATURE_CTRL_LIGHT_COUNT, ports.count(BIDIB_PORTTYPE_LIGHT));
+        f.set(FEATURE_CTRL_SERVO_COUNT, ports.count(BIDIB_PORTTYPE_SERVO));
+        f.set(FEATURE_CTRL_MAC_LEVEL, 2);
+        f.set(FEATURE_CTRL_MAC_SAVE, MacrosPerNode);
+        f.set(FEATURE_CTRL_MAC_COUNT, MacrosPerNode);
+        f.set(FEATURE_CTRL_MAC_SIZE, StepsPerMacro);
+        f.set(FEATURE_CTRL_PORT_QUERY_AVAILABLE, 1);
+        // type model until the host sets it to anything but 0
+        f.set(FEATURE_CTRL_PORT_FLAT_MODEL, 0);
+        break;
+    }
+    }
+    return f;
+}
+
+NodeIndex SimulatorPrivate::addNode(NodeIndex p, quint32 stack, NodeKind k)
+{
+    NodeIndex node = static_cast<NodeIndex>(address.size());
+
+    address.push_back(stack);
+    kind.push_back(k);
+    uniqueId.push_back(UniqueId{
+        .classId = classOf(k),
+        .classIdEx = 0,
+        .vendorId = 0x0d,
+        .productId = static_cast<quint32>(quint32(k) << 24 | node),
+    });
+    parent.push_back(p);
+    firstChild.push_back(NoNode);
+    lastChild.push_back(NoNode);
+    nextSibling.push_back(NoNode);
+    childCount.push_back(0);
+    present.push_back(1);
+    nodeTabVersion.push_back(1);
+    nodeTabCursor.push_back(NodeTabCursorIdle);
+    features.push_back(defaultFeatures(k));
+    featureCursor.push_back(FeatureCursorIdle);
+    userName.push_back({});
+    boosterState.push_back(BIDIB_BST_STATE_OFF);
+    occupancy.push_back(0);
+
+    ports.push_back(k == NodeKind::LightControl ? lightControlPorts() : Core::PortTable{});
+    portConfig.push_back(defaultPortConfig(ports.back()));
+    if (k == NodeKind::LightControl)
+        macros.emplace_back(MacrosPerNode, StepsPerMacro);
+    else
+        macros.emplace_back();
+    accessories.emplace_back(k == NodeKind::Accessory ? AccessoriesPerNode : 0,
+                             AspectsPerAccessory);
+
+    if (k == NodeKind::Booster)
+        startMeasurement(node);
+
+    if (p != NoNode) {
+        if (lastChild[p] == NoNode)
+            firstChild[p] = node;
+        else
+            nextSibling[lastChild[p]] = node;
+        lastChild[p] = node;
+        ++childCount[p];
+        nodeTabVersion[p] = nextVersion(nodeTabVersion[p]);
+    }
+
+    byAddress.insert(stack, node);
+    if (p != NoNode)
+        send(p, MSG_NODE_NEW, nodeTabVersion[p], local(node), uniqueId[node]);
+    return node;
+}
+
+void SimulatorPrivate::removeSubtree(NodeIndex node)
+{
+    for (auto child = firstChild[node]; child != NoNode; child = nextSibling[child])
+        removeSubtree(child);
+
+    present[node] = 0;
+    byAddress.remove(address[node]);
+    scheduler.cancel(boosters.take(node));
+}
+
+quint8 SimulatorPrivate::local(NodeIndex node) const
+{
+    // the local number of a child is the top entry of its address stack
+    return static_cast<quint8>(address[node] >> (8 * Address(address[parent[node]]).size()));
+}
+
+void SimulatorPrivate::handleMessage(NodeIndex node, Message const &msg)
+{
+    if (auto handler = handlers()[msg.type()])
+        handler(*this, node, msg);
+    else
+        qDebug() << "unhandled message" << Address(address[node]) << msg;
+}
+
+void SimulatorPrivate::measure(NodeIndex node)
+{
+    if (boosterState[node] != BIDIB_BST_STATE_ON)
+        return;
+    quint8 v = features[node].value(FEATURE_BST_VOLT, 0) * 10;
+    send(node,
+         MSG_BOOST_DIAGNOSTIC,
+         KeyValue8{BIDIB_BST_DIAG_I, 100},
+         KeyValue8{BIDIB_BST_DIAG_V, v});
+}
+
+// (re)arms the measurement timer of a booster from its feature, in units of 10 ms
+void SimulatorPrivate::startMeasurement(NodeIndex node)
+{
+    auto interval = std::chrono::milliseconds(10)
+                    * features[node].value(FEATURE_BST_CURMEAS_INTERVAL, 100);
+    scheduler.cancel(boosters.value(node));
+    boosters.insert(node, scheduler.every(interval, [this, node] { measure(node); }));
+}
+
+void SimulatorPrivate::sendPortConfig(NodeIndex node, quint16 index)
+{
+    QByteArray params;
+    portConfig[node].bytes(index, [&params](quint8 b) { params.append(char(b)); });
+    send(node, MSG_LC_CONFIGX, ports[node].address(index), asBytes(params));
+}
+
+void SimulatorPrivate::setPort(NodeIndex node, quint16 port, quint8 state)
+{
+    auto &table = ports[node];
+    auto index = table.find(port);
+    if (!index || table.type(*index) == BIDIB_PORTTYPE_INPUT) {
+        send(node, MSG_LC_NA, port);
+        return;
+    }
+    table.set(*index, state);
+    send(node, MSG_LC_STAT, port, state);
+}
+
+void SimulatorPrivate::startMacro(NodeIndex node, quint8 macro)
+{
+    macros[node].start(macro, macroTick + 1);
+    if (!macroNodes.contains(node))
+        macroNodes << node;
+    if (!macroTimer)
+        macroTimer = scheduler.every(MacroTick, [this] { tickMacros(); });
+}
+
+void SimulatorPrivate::tickMacros()
+{
+    ++macroTick;
+    // steps of all nodes due at this tick run together, in the order the nodes started
+    for (auto node : std::as_const(macroNodes)) {
+        if (!present[node])
+            continue;
+        macros[node].advance(
+            macroTick,
+            [&](quint8, quint16 port, quint8 state) { setPort(node, port, state); },
+            [&](quint8 macro) { send(node, MSG_LC_MACRO_STATE, macro, quint8(BIDIB_MACRO_OFF)); });
+    }
+    macroNodes.removeIf([this](NodeIndex node) {
+        return !present[node] || macros[node].active() == 0;
+    });
+    if (macroNodes.isEmpty())
+        scheduler.cancel(std::exchange(macroTimer, 0));
+}
+
+void SimulatorPrivate::handleSysGetMagic(NodeIndex node)
+{
+    send(node, MSG_SYS_MAGIC, quint16{BIDIB_SYS_MAGIC});
+}
+
+void SimulatorPrivate::handleSysGetPVersion(NodeIndex node)
+{
+    send(node, MSG_SYS_P_VERSION, quint16{BIDIB_VERSION});
+}
+
+void SimulatorPrivate::handleSysGetUniqueId(NodeIndex node)
+{
+    send(node, MSG_SYS_UNIQUE_ID, uniqueId[node]);
+}
+
+void SimulatorPrivate::handleSysGetSwVersion(NodeIndex node)
+{
+    send(node, MSG_SYS_SW_VERSION, Version{0, 0, 1});
+}
+
+void SimulatorPrivate::handleSysPing(NodeIndex node, quint8 dat)
+{
+    send(node, MSG_SYS_PONG, dat);
+}
+
+void SimulatorPrivate::handleGetPktCapacity(NodeIndex node)
+{
+    send(node, MSG_PKT_CAPACITY, quint8(64));
+}
+
+void SimulatorPrivate::handleNodeTabGetAll(NodeIndex node)
+{
+    // the node itself is entry 0, followed by its children
+    nodeTabCursor[node] = NodeTabCursorSelf;
+    send(node, MSG_NODETAB_COUNT, quint8(childCount[node] + 1));
+}
+
+void SimulatorPrivate::handleNodeTabGetNext(NodeIndex node)
+{
+    auto cursor = nodeTabCursor[node];
+    if (cursor == NodeTabCursorIdle) {
+        send(node, MSG_NODE_NA, quint8(0xff));
+        return;
+    }
+
+    if (cursor == NodeTabCursorSelf) {
+        send(node, MSG_NODETAB, nodeTabVersion[node], quint8(0), uniqueId[node]);
+        cursor = firstChild[node];
+    } else {
+        send(node, MSG_NODETAB, nodeTabVersion[node], local(cursor), uniqueId[cursor]);
+        cursor = nextSibling[cursor];
+    }
+    nodeTabCursor[node] = cursor == NoNode ? NodeTabCursorIdle : cursor;
+}
+
+void SimulatorPrivate::handleNodeChangedAck(NodeIndex node, quint8 version)
+{
+    // changes are sent once, a real node would repeat MSG_NODE_NEW/LOST until acknowledged
+    Q_UNUSED(node);
+    Q_UNUSED(version);
+}
+
+void SimulatorPrivate::handleFeatureGetAll(NodeIndex node, std::optional<quint8> shouldStream)
+{
+    if (shouldStream.value_or(0) != 1) {
+        featureCursor[node] = 0;
+        send(node, MSG_FEATURE_COUNT, quint8(features[node].size()));
+        return;
+    }
+
+    // no GETNEXT round trips, the transport packs the replies into as few frames as possible
+    featureCursor[node] = FeatureCursorIdle;
+    send(node, MSG_FEATURE_COUNT, quint8(features[node].size()), quint8(1));
+    for (auto e : features[node])
+        send(node, MSG_FEATURE, e.id, e.value);
+}
+
+void SimulatorPrivate::handleFeatureGetNext(NodeIndex node)
+{
+    auto id = features[node].next(featureCursor[node]);
+    if (!id) {
+        featureCursor[node] = FeatureCursorIdle;
+        send(node, MSG_FEATURE_NA, quint8(0xff));
+        return;
+    }
+    featureCursor[node] = *id + 1;
+    send(node, MSG_FEATURE, *id, *features[node].value(*id));
+}
+
+void SimulatorPrivate::handleFeatureGet(NodeIndex node, quint8 id)
+{
+    if (auto value = features[node].value(id))
+        send(node, MSG_FEATURE, id, *value);
+    else
+        send(node, MSG_FEATURE_NA, id);
+}
+
+void SimulatorPrivate::handleFeatureSet(NodeIndex node, quint8 id, quint8 value)
+{
+    switch (id) {
+    case FEATURE_BST_VOLT:
+        value = std::clamp<quint8>(value, 3, 16);
+        break;
+    case FEATURE_BST_CURMEAS_INTERVAL:
+        value = std::max<quint8>(value, 10);
+        break;
+    case FEATURE_CTRL_PORT_FLAT_MODEL:
+        value = value ? quint8(ports[node].size()) : 0;
+        break;
+    }
+
+    if (!features[node].update(id, value)) {
+        send(node, MSG_FEATURE_NA, id);
+        return;
+    }
+    if (id == FEATURE_CTRL_PORT_FLAT_MODEL)
+        ports[node].setFlat(value != 0);
+    if (id == FEATURE_BST_CURMEAS_INTERVAL && boosters.contains(node))
+        startMeasurement(node);
+    send(node, MSG_FEATURE, id, value);
+}
+
+void SimulatorPrivate::handleStringGet(NodeIndex node, quint8 ns, quint8 id)
+{
+    QString s;
+    if (ns == 0 && id == 0)
+        s = productName(kind[node]);
+    else if (ns == 0 && id == 1)
+        s = userName[node];
+    send(node, MSG_STRING, ns, id, s);
+}
+
+void SimulatorPrivate::handleStringSet(NodeIndex node, quint8 ns, quint8 id, QString s)
+{
+    if (ns == 0 && id == 1)
+        userName[node] = s.left(features[node].value(FEATURE_STRING_SIZE, 0));
+    handleStringGet(node, ns, id);
+}
+
+void SimulatorPrivate::handleBoostOn(NodeIndex node, std::optional<quint8> unicast)
+{
+    Q_UNUSED(unicast);
+    if (kind[node] != NodeKind::Booster)
+        return;
+    boosterState[node] = BIDIB_BST_STATE_ON;
+    send(node, MSG_BOOST_STAT, boosterState[node]);
+}
+
+void SimulatorPrivate::handleBoostOff(NodeIndex node, std::optional<quint8> unicast)
+{
+    Q_UNUSED(unicast);
+    if (kind[node] != NodeKind::Booster)
+        return;
+    boosterState[node] = BIDIB_BST_STATE_OFF;
+    send(node, MSG_BOOST_STAT, boosterState[node]);
+}
+
+void SimulatorPrivate::handleBoostQuery(NodeIndex node)
+{
+    if (kind[node] == NodeKind::Booster)
+        send(node, MSG_BOOST_STAT, boosterState[node]);
+}
+
+void SimulatorPrivate::handleBmGetRange(NodeIndex node, quint8 start, quint8 end)
+{
+    if (kind[node] != NodeKind::Occupancy)
+        return;
+
+    // ranges are multiples of 8, one byte per group of 8 sections
+    start &= ~7;
+    end = quint8(std::min((end + 7) & ~7, int(SectionsPerNode)));
+    QByteArray payload;
+    payload.append(char(start));
+    payload.append(char(end > start ? end - start : 0));
+    for (auto base = start; base < end; base += 8)
+        payload.append(char(occupancy[node] >> base));
+    Q_Q(Simulator);
+    emit q->messageOut(Address(address[node]), Message(MSG_BM_MULTIPLE, payload));
+}
+
+void SimulatorPrivate::handleBmMirror(NodeIndex node)
+{
+    // secure acknowledge is not simulated, reports are never repeated
+    Q_UNUSED(node);
+}
+
+void SimulatorPrivate::handleAccessorySet(NodeIndex node, quint8 number, quint8 aspect)
+{
+    auto &bank = accessories[node];
+    if (!bank.contains(number)) {
+        send(node, MSG_ACCESSORY_STATE, number, VoidAccessory);
+        return;
+    }
+
+    auto state = bank.operate(number, aspect, AccessoryWait);
+    send(node, MSG_ACCESSORY_STATE, number, state);
+    if (state.failed())
+        return;
+
+    // a new operation replaces the movement still going on
+    auto key = qint64(node) << 8 | number;
+    scheduler.cancel(movements.take(key));
+    if (!state.moving())
+        return;
+    auto timer = scheduler.schedule(std::chrono::milliseconds(100 * AccessoryWait), [=, this] {
+        movements.remove(key);
+        if (present[node] && accessories[node].complete(number))
+            send(node, MSG_ACCESSORY_NOTIFY, number, accessories[node][number]);
+    });
+    movements.insert(key, timer);
+}
+
+void SimulatorPrivate::handleAccessoryGet(NodeIndex node, quint8 number)
+{
+    if (accessories[node].contains(number))
+        send(node, MSG_ACCESSORY_STATE, number, accessories[node][number]);
+    else
+        send(node, MSG_ACCESSORY_STATE, number, VoidAccessory);
+}
+
+void SimulatorPrivate::handleAccessoryGetAll(NodeIndex node)
+{
+    // all states back to back, the transport packs them into as few frames as possible
+    quint8 number = 0;
+    for (auto const &state : accessories[node])
+        send(node, MSG_ACCESSORY_STATE, number++, state);
+}
+
+void SimulatorPrivate::handleLcOutput(NodeIndex node, quint16 port, quint8 state)
+{
+    setPort(node, port, state);
+}
+
+void SimulatorPrivate::handleLcPortQuery(NodeIndex node, quint16 port)
+{
+    if (auto index = ports[node].find(port))
+        send(node, MSG_LC_STAT, port, ports[node].state(*index));
+    else
+        send(node, MSG_LC_NA, port);
+}
+
+void SimulatorPrivate::handleLcPortQueryAll(NodeIndex node,
+                                            std::optional<quint16> select,
+                                            std::optional<quint16> start,
+                                            std::optional<quint16> end)
+{
+    // all states back to back and MSG_LC_NA for the end, packed into frames by the transport
+    ports[node].query(select.value_or(0xffff),
+                      start.value_or(0),
+                      end.value_or(0xffff),
+                      [&](quint16 port, quint8 state) { send(node, MSG_LC_STAT, port, state); });
+    send(node, MSG_LC_NA, quint16(0xffff));
+}
+
+void SimulatorPrivate::handleLcConfigXSet(NodeIndex node,
+                                          quint16 port,
+                                          std::span<const std::byte> params)
+{
+    auto index = ports[node].find(port);
+    if (!index || !portConfig[node].apply(*index, params)) {
+        send(node, MSG_LC_NA, port);
+        return;
+    }
+    sendPortConfig(node, *index);
+}
+
+void SimulatorPrivate::handleLcConfigXGet(NodeIndex node, quint16 port)
+{
+    if (auto index = ports[node].find(port))
+        sendPortConfig(node, *index);
+    else
+        send(node, MSG_LC_NA, port);
+}
+
+void SimulatorPrivate::handleLcConfigXGetAll(NodeIndex node,
+                                             std::optional<quint16> start,
+                                             std::optional<quint16> end)
+{
+    // only ports with parameters are visited, however wide the range
+    portConfig[node].forEach([&](quint16 index, auto) {
+        auto port = ports[node].address(index);
+        if (port >= start.value_or(0) && port < end.value_or(0xffff))
+            sendPortConfig(node, index);
+    });
+}
+
+void SimulatorPrivate::handleLcMacroHandle(NodeIndex node, quint8 macro, quint8 opcode)
+{
+    auto &engine = macros[node];
+    quint8 state = BIDIB_MACRO_NOTEXIST;
+    if (engine.contains(macro)) {
+        state = opcode;
+        switch (opcode) {
+        case BIDIB_MACRO_OFF:
+            engine.stop(macro);
+            break;
+        case BIDIB_MACRO_START:
+            startMacro(node, macro);
+            state = BIDIB_MACRO_RUNNING;
+            break;
+        case BIDIB_MACRO_DELETE:
+            engine.remove(macro);
+            break;
+        case BIDIB_MACRO_SAVE:
+            engine.save(macro);
+            break;
+        case BIDIB_MACRO_RESTORE:
+            engine.restore(macro);
+            break;
+        default:
+            state = BIDIB_MACRO_NOTEXIST;
+            break;
+        }
+    }
+    send(node, MSG_LC_MACRO_STATE, macro, state);
+}
+
+void SimulatorPrivate::handleLcMacroSet(NodeIndex node,
+                                        quint8 macro,
+                                        quint8 item,
+                                        Core::MacroStep step)
+{
+    if (!macros[node].contains(macro, item)) {
+        send(node, MSG_LC_MACRO_STATE, macro, quint8(BIDIB_MACRO_NOTEXIST));
+        return;
+    }
+    macros[node].setStep(macro, item, step);
+    send(node, MSG_LC_MACRO, macro, item, step);
+}
+
+void SimulatorPrivate::handleLcMacroGet(NodeIndex node, quint8 macro, quint8 item)
+{
+    if (macros[node].contains(macro, item))
+        send(node, MSG_LC_MACRO, macro, item, macros[node].step(macro, item));
+    else
+        send(node, MSG_LC_MACRO_STATE, macro, quint8(BIDIB_MACRO_NOTEXIST));
+}
+
+void SimulatorPrivate::handleLcMacroParaSet(NodeIndex node,
+                                            quint8 macro,
+                                            quint8 index,
+                                            quint32 value)
+{
+    if (macros[node].contains(macro))
+        macros[node].setParameter(macro, index, value);
+    handleLcMacroParaGet(node, macro, index);
+}
+
+void SimulatorPrivate::handleLcMacroParaGet(NodeIndex node, quint8 macro, quint8 index)
+{
+    if (macros[node].contains(macro))
+        send(node, MSG_LC_MACRO_PARA, macro, index, macros[node].parameter(macro, index));
+    else
+        send(node, MSG_LC_MACRO_STATE, macro, quint8(BIDIB_MACRO_NOTEXIST));
+}
+
+Simulator::Simulator()
+    : _d(new SimulatorPrivate(this))
+{
+    Q_D(Simulator);
+    d->addNode(NoNode, 0, NodeKind::Interface);
+}
+
+Simulator::~Simulator() = default;
+
+NodeIndex Simulator::addNode(NodeIndex parent, NodeKind kind)
+{
+    Q_D(Simulator);
+    if (parent < 0 || parent >= nodeCount() || !d->present[parent])
+        return NoNode;
+    if (d->kind[parent] != NodeKind::Interface && d->kind[parent] != NodeKind::Hub)
+        return NoNode;
+    if (d->childCount[parent] == MaxChildren)
+        return NoNode;
+
+    auto depth = Address(d->address[parent]).size();
+    if (depth == Core::Address::MaxDepth)
+        return NoNode;
+
+    // lowest free local number, those of removed nodes are reused
+    std::bitset<256> used;
+    for (auto child = d->firstChild[parent]; child != NoNode; child = d->nextSibling[child])
+        used.set(d->local(child));
+    quint32 local = 1;
+    while (used.test(local))
+        ++local;
+
+    // the first address byte on the wire addresses the topmost hub, so children go above it
+    return d->addNode(parent, d->address[parent] | local << (8 * depth), kind);
+}
+
+bool Simulator::removeNode(NodeIndex node)
+{
+    Q_D(Simulator);
+    if (node <= 0 || node >= nodeCount() || !d->present[node])
+        return false;
+
+    auto p = d->parent[node];
+    auto local = d->local(node);
+
+    NodeIndex prev = NoNode;
+    for (auto child = d->firstChild[p]; child != node; child = d->nextSibling[child])
+        prev = child;
+    if (prev == NoNode)
+        d->firstChild[p] = d->nextSibling[node];
+    else
+        d->nextSibling[prev] = d->nextSibling[node];
+    if (d->lastChild[p] == node)
+        d->lastChild[p] = prev;
+    --d->childCount[p];
+    d->nodeTabVersion[p] = nextVersion(d->nodeTabVersion[p]);
+    // a running enumeration of the table is stale now
+    d->nodeTabCursor[p] = NodeTabCursorIdle;
+
+    d->removeSubtree(node);
+    d->send(p, MSG_NODE_LOST, d->nodeTabVersion[p], local, d->uniqueId[node]);
+    return true;
+}
+
+void Simulator::populate(qsizetype count, qsizetype fanout)
+{
+    static constexpr NodeKind Leaves[] = {
+        NodeKind::Occupancy,
+        NodeKind::Occupancy,
+        NodeKind::LightControl,
+        NodeKind::Accessory,
+        NodeKind::Occupancy,
+        NodeKind::Booster,
+    };
+
+    Q_D(Simulator);
+    QList<NodeIndex> hubs{0};
+    qsizetype n = 0;
+    for (qsizetype i = 0; i < hubs.size() && nodeCount() < count; ++i) {
+        for (qsizetype c = 0; c < fanout && nodeCount() < count; ++c, ++n) {
+            // every fourth child is a hub while there is depth left below it
+            bool hub = n % 4 == 0
+                       && Address(d->address[hubs[i]]).size() + 1 < Core::Address::MaxDepth;
+            auto node = addNode(hubs[i], hub ? NodeKind::Hub : Leaves[n % std::size(Leaves)]);
+            if (node == NoNode)
+                break;
+            if (hub)
+                hubs << node;
+        }
+    }
+}
+
+qsizetype Simulator::nodeCount() const
+{
+    Q_D(const Simulator);
+    return static_cast<qsizetype>(d->address.size());
+}
+
+bool Simulator::isPresent(NodeIndex node) const
+{
+    Q_D(const Simulator);
+    return node >= 0 && node < nodeCount() && d->present[node];
+}
+
+NodeIndex Simulator::find(Address const &address) const
+{
+    Q_D(const Simulator);
+    return d->byAddress.value(address.core().stack(), NoNode);
+}
+
+Address Simulator::address(NodeIndex node) const
+{
+    Q_D(const Simulator);
+    return Address(d->address[node]);
+}
+
+bool Simulator::setOccupied(NodeIndex node, quint8 section, bool occupied)
+{
+    Q_D(Simulator);
+    if (!isPresent(node) || d->kind[node] != NodeKind::Occupancy || section >= SectionsPerNode)
+        return false;
+
+    quint16 bit = 1 << section;
+    if (bool(d->occupancy[node] & bit) != occupied) {
+        d->occupancy[node] ^= bit;
+        d->send(node, occupied ? MSG_BM_OCC : MSG_BM_FREE, section);
+    }
+    return true;
+}
+
+bool Simulator::failAccessory(NodeIndex node, quint8 number, quint8 error)
+{
+    Q_D(Simulator);
+    if (!isPresent(node) || !d->accessories[node].contains(number))
+        return false;
+
+    d->scheduler.cancel(d->movements.take(qint64(node) << 8 | number));
+    if (d->accessories[node].fail(number, error))
+        d->send(node, MSG_ACCESSORY_NOTIFY, number, d->accessories[node][number]);
+    return true;
+}
+
+Simulator::NodeKind Simulator::kind(NodeIndex node) const
+{
+    Q_D(const Simulator);
+    return d->kind[node];
+}
+
+UniqueId Simulator::uniqueId(NodeIndex node) const
+{
+    Q_D(const Simulator);
+    return d->uniqueId[node];
+}
+
+void Simulator::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(Simulator);
+    auto node = find(address);
+    if (node == NoNode) {
+        qDebug() << "no node at" << address << msg;
+        return;
+    }
+    d->handleMessage(node, msg);
+}
+
+} // namespace Bd
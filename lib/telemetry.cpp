@@ -0,0 +1,165 @@
+#include "telemetry.h"
+#include "bidib_messages.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
+
+namespace Bd {
+
+static quint64 key(Telemetry::Channel const &channel)
+{
+    return quint64(channel.node) << 24 | quint64(channel.quantity) << 16 | channel.index;
+}
+
+static Telemetry::Channel channelOf(quint64 key)
+{
+    return {quint32(key >> 24), Telemetry::Quantity(quint8(key >> 16)), quint16(key)};
+}
+
+class TelemetryPrivate
+{
+    Q_DECLARE_PUBLIC(Telemetry)
+
+public:
+    explicit TelemetryPrivate(Telemetry *q)
+        : q_ptr(q)
+    {}
+
+    void boosterDiagnostic(Address const &address, Message const &msg, qint64 now);
+    void detectorCurrent(Address const &address, Message const &msg, qint64 now);
+    void locoSpeed(Address const &address, Message const &msg, qint64 now);
+
+    Telemetry *const q_ptr;
+    QHash<quint64, Core::TimeSeries> series;
+    Core::SeriesRetention retention;
+};
+
+void TelemetryPrivate::boosterDiagnostic(Address const &address, Message const &msg, qint64 now)
+{
+    Q_Q(Telemetry);
+    auto const &p = msg.payload();
+    for (qsizetype i = 0; i + 1 < p.size(); i += 2) {
+        Telemetry::Quantity quantity;
+        switch (quint8(p[i])) {
+        case BIDIB_BST_DIAG_I:
+            quantity = Telemetry::Quantity::BoosterCurrent;
+            break;
+        case BIDIB_BST_DIAG_V:
+            quantity = Telemetry::Quantity::BoosterVoltage;
+            break;
+        case BIDIB_BST_DIAG_T:
+            quantity = Telemetry::Quantity::BoosterTemperature;
+            break;
+        default:
+            continue;
+        }
+        q->record({address.core().stack(), quantity}, now, quint8(p[i + 1]));
+    }
+}
+
+void TelemetryPrivate::detectorCurrent(Address const &address, Message const &msg, qint64 now)
+{
+    Q_Q(Telemetry);
+    auto args = Unpacker::unpack<quint8, quint8>(msg.payload());
+    if (!args) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+    auto [section, current] = *args;
+    q->record({address.core().stack(), Telemetry::Quantity::DetectorCurrent, section},
+              now,
+              current);
+}
+
+void TelemetryPrivate::locoSpeed(Address const &address, Message const &msg, qint64 now)
+{
+    Q_Q(Telemetry);
+    auto args = Unpacker::unpack<quint16, quint16>(msg.payload());
+    if (!args) {
+        qDebug() << "malformed" << msg;
+        return;
+    }
+    auto [loco, speed] = *args;
+    q->record({address.core().stack(), Telemetry::Quantity::LocoSpeed, quint16(loco & 0x3fff)},
+              now,
+              speed);
+}
+
+Telemetry::Telemetry(QObject *parent)
+    : QObject(parent)
+    , _d(new TelemetryPrivate(this))
+{}
+
+Telemetry::~Telemetry() = default;
+
+void Telemetry::handleMessage(Address const &address, Message const &msg)
+{
+    Q_D(Telemetry);
+    switch (msg.type()) {
+    case MSG_BOOST_DIAGNOSTIC:
+        d->boosterDiagnostic(address, msg, QDateTime::currentMSecsSinceEpoch());
+        break;
+    case MSG_BM_CURRENT:
+        d->detectorCurrent(address, msg, QDateTime::currentMSecsSinceEpoch());
+        break;
+    case MSG_BM_SPEED:
+        d->locoSpeed(address, msg, QDateTime::currentMSecsSinceEpoch());
+        break;
+    }
+}
+
+void Telemetry::setRetention(Core::SeriesRetention retention)
+{
+    Q_D(Telemetry);
+    d->retention = retention;
+}
+
+Core::SeriesRetention Telemetry::retention() const
+{
+    Q_D(const Telemetry);
+    return d->retention;
+}
+
+void Telemetry::record(Channel const &channel, qint64 time, qint32 value)
+{
+    Q_D(Telemetry);
+    auto it = d->series.find(key(channel));
+    if (it == d->series.end())
+        it = d->series.insert(key(channel), Core::TimeSeries(d->retention));
+    it->append(time, value);
+}
+
+QList<Core::SeriesPoint> Telemetry::query(Channel const &channel,
+                                          qint64 from,
+                                          qint64 to,
+                                          Core::TimeSeries::Resolution resolution) const
+{
+    Q_D(const Telemetry);
+    QList<Core::SeriesPoint> points;
+    auto it = d->series.constFind(key(channel));
+    if (it != d->series.cend())
+        it->query(resolution, from, to, [&](Core::SeriesPoint const &p) { points << p; });
+    return points;
+}
+
+QList<Telemetry::Channel> Telemetry::channels() const
+{
+    Q_D(const Telemetry);
+    QList<Channel> channels;
+    channels.reserve(d->series.size());
+    for (auto it = d->series.cbegin(); it != d->series.cend(); ++it)
+        channels << channelOf(it.key());
+    return channels;
+}
+
+qsizetype Telemetry::memoryUsage() const
+{
+    Q_D(const Telemetry);
+    qsizetype bytes = 0;
+    for (auto const &s : d->series)
+        bytes += qsizetype(s.bytes());
+    return bytes;
+}
+
+} // namespace Bd
@@ -0,0 +1,207 @@
+#include "trafficgenerator.h"
+#include "address.h"
+#include "bidib_messages.h"
+#include "message.h"
+#include "pack.h"
+#include "serialtransport.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Bd {
+
+namespace {
+
+struct KeyValue8
+{
+    quint8 id;
+    quint8 value;
+};
+
+struct __attribute__((packed)) DriveAck
+{
+    quint16 addr;
+    quint8 ack;
+};
+
+} // namespace
+
+TrafficProfile TrafficProfile::scaled(double factor) const
+{
+    auto p = *this;
+    p.occupancyRate *= factor;
+    p.railcomRate *= factor;
+    p.diagnosticsRate *= factor;
+    p.driveAckRate *= factor;
+    p.featureRate *= factor;
+    return p;
+}
+
+TrafficGenerator::TrafficGenerator(TrafficProfile const &profile, quint32 seed)
+    : _profile(profile)
+    , _random(seed)
+    , _occupancy(std::max(profile.detectorNodes, 0), 0)
+{
+    for (int kind = 0; kind < KindCount; ++kind)
+        schedule(static_cast<Kind>(kind));
+}
+
+QByteArray TrafficGenerator::generate(std::chrono::microseconds duration)
+{
+    QByteArray out;
+    auto end = _now + duration;
+    while (true) {
+        auto kind = static_cast<Kind>(std::min_element(_next.begin(), _next.end()) - _next.begin());
+        if (_next[kind] >= end)
+            break;
+        _now = _next[kind];
+        emitEvent(kind, out);
+        schedule(kind);
+    }
+    _now = end;
+    return out;
+}
+
+std::chrono::microseconds TrafficGenerator::elapsed() const
+{
+    return _now;
+}
+
+quint64 TrafficGenerator::messageCount() const
+{
+    return _messages;
+}
+
+quint64 TrafficGenerator::frameCount() const
+{
+    return _frames;
+}
+
+double TrafficGenerator::rate(Kind kind) const
+{
+    switch (kind) {
+    case Occupancy:
+        return _profile.detectorNodes > 0 ? _profile.occupancyRate : 0;
+    case Railcom:
+        return _profile.detectorNodes > 0 && _profile.locos > 0 ? _profile.railcomRate : 0;
+    case Diagnostics:
+        return _profile.boosterNodes > 0 ? _profile.diagnosticsRate : 0;
+    case DriveAck:
+        return _profile.locos > 0 ? _profile.driveAckRate : 0;
+    case Feature:
+        return _profile.featureRate;
+    case KindCount:
+        break;
+    }
+    return 0;
+}
+
+void TrafficGenerator::schedule(Kind kind)
+{
+    auto r = rate(kind);
+    if (r <= 0) {
+        _next[kind] = std::chrono::microseconds::max();
+        return;
+    }
+    // exponentially distributed gaps, at least one microsecond to guarantee progress
+    auto gap = -std::log(1.0 - _random.generateDouble()) / r * 1e6;
+    _next[kind] = _now + std::chrono::microseconds(std::max<qint64>(1, std::llround(gap)));
+}
+
+void TrafficGenerator::emitEvent(Kind kind, QByteArray &out)
+{
+    QByteArray frame;
+
+    switch (kind) {
+    case Occupancy: {
+        auto node = _random.bounded(_profile.detectorNodes);
+        auto sections = std::clamp(_profile.sectionsPerNode, 1, 32);
+        auto &state = _occupancy[node];
+        auto address = quint32(node + 1);
+
+        if (_random.bounded(4) == 0 && sections >= 8) {
+            // a whole group of eight changes at once
+            auto base = quint8(_random.bounded(sections / 8) * 8);
+            auto bits = quint8(_random.bounded(256));
+            state = (state & ~(0xffu << base)) | (quint32(bits) << base);
+            auto payload = Packer::pack(base, quint8(8), bits);
+            appendMessage(frame, out, address, MSG_BM_MULTIPLE, payload);
+        } else {
+            for (int i = 0; i < std::max(_profile.occupancyBurst, 1); ++i) {
+                auto mnum = quint8(_random.bounded(sections));
+                state ^= 1u << mnum;
+                auto type = state & (1u << mnum) ? MSG_BM_OCC : MSG_BM_FREE;
+                appendMessage(frame, out, address, type, Packer::pack(mnum));
+            }
+        }
+        break;
+    }
+
+    case Railcom: {
+        auto address = quint32(_random.bounded(_profile.detectorNodes) + 1);
+        auto mnum = quint8(_random.bounded(std::max(_profile.sectionsPerNode, 1)));
+        auto loco = quint16(3 + _random.bounded(_profile.locos));
+        appendMessage(frame, out, address, MSG_BM_ADDRESS, Packer::pack(mnum, loco));
+        break;
+    }
+
+    case Diagnostics: {
+        auto address = quint32(_profile.detectorNodes + 1 + _random.bounded(_profile.boosterNodes));
+        appendMessage(frame,
+                      out,
+                      address,
+                      MSG_BOOST_DIAGNOSTIC,
+                      Packer::pack(KeyValue8{BIDIB_BST_DIAG_I, quint8(_random.bounded(40, 120))},
+                                   KeyValue8{BIDIB_BST_DIAG_V, quint8(_random.bounded(150, 170))},
+                                   KeyValue8{BIDIB_BST_DIAG_T, quint8(_random.bounded(25, 60))}));
+        break;
+    }
+
+    case DriveAck: {
+        auto loco = quint16(3 + _random.bounded(_profile.locos));
+        appendMessage(frame, out, 0, MSG_CS_DRIVE_ACK, Packer::pack(DriveAck{loco, 1}));
+        break;
+    }
+
+    case Feature: {
+        auto address = quint32(_random.bounded(std::max(_profile.detectorNodes, 1)) + 1);
+        auto value = quint8(_random.bounded(256));
+        appendMessage(frame, out, address, MSG_FEATURE, Packer::pack(_feature, value));
+        ++_feature;
+        break;
+    }
+
+    case KindCount:
+        break;
+    }
+
+    finishFrame(frame, out);
+}
+
+void TrafficGenerator::appendMessage(QByteArray &frame,
+                                     QByteArray &out,
+                                     quint32 address,
+                                     quint8 type,
+                                     QByteArray const &payload)
+{
+    // interfaces pack several messages into one frame, but keep frames reasonably short
+    if (frame.size() > 48)
+        finishFrame(frame, out);
+
+    auto &num = _sequence[address];
+    num = num == 255 ? 1 : num + 1;
+    frame += *Message(type, payload).toSendBuffer(Address(address), num);
+    ++_messages;
+}
+
+void TrafficGenerator::finishFrame(QByteArray &frame, QByteArray &out)
+{
+    if (frame.isEmpty())
+        return;
+    auto wire = SerialTransport::frame(frame);
+    frame.clear();
+    out += wire;
+    ++_frames;
+}
+
+} // namespace Bd
@@ -1,13 +1,38 @@
 #include <QTest>
 
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSet>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <iostream>
+#include <thread>
 
 #include <bidib/address.h>
 #include <bidib/bidib_messages.h>
+#include <bidib/core/features.h>
+#include <bidib/core/frame.h>
+#include <bidib/core/macros.h>
+#include <bidib/discovery.h>
+#include <bidib/core/pack.h>
+#include <bidib/host.h>
+#include <bidib/layoutstate.h>
+#include <bidib/locopositions.h>
 #include <bidib/message.h>
+#include <bidib/messagebus.h>
+#include <bidib/messagerouter.h>
+#include <bidib/node.h>
+#include <bidib/nodecache.h>
+#include <bidib/nodetable.h>
+#include <bidib/occupancy.h>
 #include <bidib/pack.h>
+#include <bidib/remotenode.h>
+#include <bidib/scheduler.h>
+#include <bidib/serialconnection.h>
 #include <bidib/serialtransport.h>
+#include <bidib/simulator.h>
+#include <bidib/telemetry.h>
+#include <bidib/trafficgenerator.h>
 
 #include "QtTest/qtestcase.h"
 #include "bidib/pack.h"
@@ -48,9 +73,51 @@ private slots:
     void serialTransportFrameWrongChecksum();
     void serialTransportFrameMessageTooShort();
     void serialTransportFrameMessageInvalidAddress();
+    void serialTransportFrameRoundTrip();
+    void serialTransportSink();
+    void serialTransportErrorFlood();
+
+    void serialConnectionProfileForBaudRate();
+
+    void trafficGeneratorDeterministic();
+    void trafficGeneratorDecodes();
+
+    void simulatorPopulate();
+    void simulatorNodeTab();
+
+    void featureTable();
+    void nodeFeatureGetAll();
+
+    void hostReadFeatures_data();
+    void hostReadFeatures();
+    void hostReadFeaturesTimeout();
+
+    void nodeCacheReopen();
+    void hostReadNodeCached();
+
+    void discoveryTree();
+    void nodeTableIncremental();
+    void remoteNodeAwait();
+    void remoteNodeTimeout();
+    void remoteNodePipeline();
+    void messageRouterFilters();
+    void messageBusConsumers();
+    void layoutStateSnapshots();
+    void occupancyBulkUpdates();
+    void locoPositionsIndex();
+    void telemetryHistory();
+    void schedulerTimers();
+    void accessoryEngine();
+    void lcPortEngine();
+    void lcPortConfig();
+    void lcMacroEngine();
 
     void computeCrc8();
 
+    void coreFrameDecoderFragmentedStream();
+    void coreFrameDecoderOverflow();
+    void corePackerFixedCapacity();
+
     void packerPackValues();
     void packerPackStruct();
     void packerPackString();
@@ -430,12 +497,1370 @@ void TestBiDiB::serialTransportFrameMessageInvalidAddress()
     QCOMPARE(errorOccurred[0][1].toByteArray(), ba(0x01, 0x02, 0x03, 0x01, 0x55, 0xaa, 0xde, 0xad, 0xef));
 }
 
+void TestBiDiB::serialTransportFrameRoundTrip()
+{
+    auto buf = Bd::Message(MSG_SYS_MAGIC, ba(0xfe, 0xaf)).toSendBuffer(Bd::Address(0x01), 7);
+    QVERIFY(buf.has_value());
+
+    auto wire = Bd::SerialTransport::frame(*buf);
+    QCOMPARE(static_cast<quint8>(wire.front()), BIDIB_PKT_MAGIC);
+    QCOMPARE(static_cast<quint8>(wire.back()), BIDIB_PKT_MAGIC);
+
+    Bd::SerialTransport st;
+    QSignalSpy messageReceived(&st, &Bd::SerialTransport::messageReceived);
+    QSignalSpy errorOccurred(&st, &Bd::SerialTransport::errorOccurred);
+    st.processData(wire);
+    QCOMPARE(errorOccurred.count(), 0);
+    QCOMPARE(messageReceived.count(), 1);
+    QCOMPARE(messageReceived[0][0], QVariant::fromValue(Bd::Address(0x01)));
+    QCOMPARE(messageReceived[0][1], QVariant::fromValue(Bd::Message(MSG_SYS_MAGIC, ba(0xfe, 0xaf))));
+}
+
+void TestBiDiB::serialTransportSink()
+{
+    struct Sink : Bd::TransportSink
+    {
+        QList<QByteArray> frames;
+        QList<std::tuple<quint32, quint8, QByteArray>> messages;
+        QList<Bd::Error> errors;
+
+        void frameReceived(std::span<const std::byte> frame) override
+        {
+            frames << Bd::toByteArray(frame);
+        }
+        void messageReceived(Bd::Core::MessageView const &msg) override
+        {
+            messages << std::make_tuple(msg.address.stack(), msg.type, Bd::toByteArray(msg.payload));
+        }
+        void errorOccurred(Bd::Error error, std::span<const std::byte>) override { errors << error; }
+    };
+
+    Sink sink;
+    Bd::SerialTransport st;
+    st.setSink(&sink);
+    QCOMPARE(st.sink(), &sink);
+
+    st.processData(ba(BIDIB_PKT_MAGIC, 0x0a, 0x01, 0x02, 0x03, 0x00, 0x55, 0xaa, 0xde, 0xad, 0xbe, 0xef, 0xd8, BIDIB_PKT_MAGIC));
+    st.processData(ba(1, 2, 3, BIDIB_PKT_MAGIC));
+    QCOMPARE(sink.frames.count(), 2);
+    QCOMPARE(sink.messages.count(), 1);
+    QCOMPARE(sink.messages[0], std::make_tuple(0x030201u, quint8(0xaa), ba(0xde, 0xad, 0xbe, 0xef)));
+    QCOMPARE(sink.errors, QList<Bd::Error>{Bd::Error::BadChecksum});
+}
+
+void TestBiDiB::serialTransportErrorFlood()
+{
+    Bd::SerialTransport st;
+    st.setErrorSampling(5, std::chrono::hours(1));
+    QSignalSpy errorOccurred(&st, &Bd::SerialTransport::errorOccurred);
+
+    QByteArray garbage;
+    for (int i = 0; i < 1000; ++i)
+        garbage += ba(BIDIB_PKT_MAGIC, 1, 2, 3);
+    st.processData(garbage);
+    st.processData(ba(BIDIB_PKT_MAGIC, 0x09, 0x01, 0x02, 0x03, 0x01, 0x55, 0xaa, 0xde, 0xad, 0xef, 0x6d, BIDIB_PKT_MAGIC));
+
+    QCOMPARE(st.errorCount(Bd::Error::BadChecksum), 1000);
+    QCOMPARE(st.errorCount(Bd::Error::AddressMissingTerminator), 1);
+    QCOMPARE(st.totalErrorCount(), 1001);
+    QCOMPARE(errorOccurred.count(), 5);
+
+    st.resetErrorCounts();
+    QCOMPARE(st.totalErrorCount(), 0);
+}
+
+void TestBiDiB::serialConnectionProfileForBaudRate()
+{
+    auto const &profiles = Bd::SerialConnection::profiles();
+    QVERIFY(!profiles.isEmpty());
+    for (qsizetype i = 1; i < profiles.size(); ++i)
+        QVERIFY(profiles[i - 1].baudRate < profiles[i].baudRate);
+
+    QCOMPARE(Bd::SerialConnection::profileForBaudRate(115200), profiles[1]);
+
+    auto custom = Bd::SerialConnection::profileForBaudRate(500000);
+    QCOMPARE(custom.baudRate, 500000);
+    QCOMPARE(custom.readChunkSize, Bd::SerialConnection::profileForBaudRate(115200).readChunkSize);
+}
+
+void TestBiDiB::trafficGeneratorDeterministic()
+{
+    Bd::TrafficGenerator a(Bd::TrafficProfile{}, 7);
+    Bd::TrafficGenerator b(Bd::TrafficProfile{}, 7);
+    Bd::TrafficGenerator c(Bd::TrafficProfile{}, 8);
+
+    auto first = a.generate(std::chrono::seconds(1));
+    QVERIFY(!first.isEmpty());
+    QCOMPARE(b.generate(std::chrono::milliseconds(400)) + b.generate(std::chrono::milliseconds(600)),
+             first);
+    QVERIFY(c.generate(std::chrono::seconds(1)) != first);
+    QCOMPARE(a.elapsed().count(), 1000000);
+}
+
+void TestBiDiB::trafficGeneratorDecodes()
+{
+    Bd::TrafficGenerator generator(Bd::TrafficProfile{}.scaled(10), 1);
+    auto data = generator.generate(std::chrono::seconds(2));
+
+    Bd::SerialTransport st;
+    QSignalSpy messageReceived(&st, &Bd::SerialTransport::messageReceived);
+    QSignalSpy frameReceived(&st, &Bd::SerialTransport::frameReceived);
+    st.processData(data);
+
+    QCOMPARE(st.totalErrorCount(), 0);
+    QCOMPARE(quint64(frameReceived.count()), generator.frameCount());
+    QCOMPARE(quint64(messageReceived.count()), generator.messageCount());
+    // 10x the default profile is roughly 900 messages per second
+    QVERIFY(generator.messageCount() > 400);
+}
+
+void TestBiDiB::simulatorPopulate()
+{
+    Bd::Simulator sim;
+    sim.populate(5000);
+    QCOMPARE(sim.nodeCount(), 5000);
+
+    QSet<quint32> addresses;
+    for (qsizetype i = 0; i < sim.nodeCount(); ++i) {
+        auto address = sim.address(i);
+        QVERIFY(address.size() <= 4);
+        QCOMPARE(sim.find(address), i);
+        addresses << address.core().stack();
+    }
+    QCOMPARE(addresses.size(), 5000);
+
+    // leaves cannot have children
+    auto leaf = sim.nodeCount() - 1;
+    QVERIFY(sim.kind(leaf) != Bd::Simulator::NodeKind::Hub);
+    QCOMPARE(sim.addNode(leaf, Bd::Simulator::NodeKind::Occupancy), -1);
+}
+
+void TestBiDiB::simulatorNodeTab()
+{
+    Bd::Simulator sim;
+    auto hub = sim.addNode(0, Bd::Simulator::NodeKind::Hub);
+    auto a = sim.addNode(hub, Bd::Simulator::NodeKind::Booster);
+    auto b = sim.addNode(hub, Bd::Simulator::NodeKind::Occupancy);
+    QCOMPARE(sim.address(b), Bd::Address(0x0201));
+
+    std::vector<Bd::Message> replies;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &address, Bd::Message const &msg) {
+                QCOMPARE(address, sim.address(hub));
+                replies.push_back(msg);
+            });
+    sim.handleMessage(sim.address(hub), Bd::Message(MSG_NODETAB_GETALL, {}));
+    for (int i = 0; i < 4; ++i)
+        sim.handleMessage(sim.address(hub), Bd::Message(MSG_NODETAB_GETNEXT, {}));
+
+    QCOMPARE(replies.size(), 5);
+    QCOMPARE(replies[0], Bd::Message::create<quint8>(MSG_NODETAB_COUNT, 3));
+    QCOMPARE(replies[1], Bd::Message::create(MSG_NODETAB, quint8(3), quint8(0), sim.uniqueId(hub)));
+    QCOMPARE(replies[2], Bd::Message::create(MSG_NODETAB, quint8(3), quint8(1), sim.uniqueId(a)));
+    QCOMPARE(replies[3], Bd::Message::create(MSG_NODETAB, quint8(3), quint8(2), sim.uniqueId(b)));
+    QCOMPARE(replies[4], Bd::Message::create<quint8>(MSG_NODE_NA, 0xff));
+}
+
+void TestBiDiB::featureTable()
+{
+    Bd::Core::FeatureTable features{{FEATURE_STRING_SIZE, 24}, {FEATURE_BM_SIZE, 16}, {64, 1}};
+    QCOMPARE(features.size(), std::size_t(3));
+    QVERIFY(features.contains(64));
+    QVERIFY(!features.contains(FEATURE_BM_ON));
+
+    // updating an unknown feature must not add it
+    QVERIFY(!features.update(FEATURE_BM_ON, 1));
+    QVERIFY(!features.contains(FEATURE_BM_ON));
+
+    QList<quint8> ids;
+    for (auto e : features)
+        ids << e.id;
+    QCOMPARE(ids, (QList<quint8>{FEATURE_BM_SIZE, 64, FEATURE_STRING_SIZE}));
+    QCOMPARE(*features.next(65), quint8(FEATURE_STRING_SIZE));
+    QVERIFY(!features.next(FEATURE_STRING_SIZE + 1));
+}
+
+void TestBiDiB::nodeFeatureGetAll()
+{
+    Bd::Node node;
+    node.setFeature(FEATURE_STRING_SIZE, 24);
+    node.setFeature(FEATURE_BM_SIZE, 16);
+
+    QList<Bd::Message> replies;
+    connect(&node, &Bd::Node::messageToSend, this, [&](Bd::Message const &msg) { replies << msg; });
+    node.handleMessage(Bd::Message(MSG_FEATURE_GETALL, {}));
+    for (int i = 0; i < 3; ++i)
+        node.handleMessage(Bd::Message(MSG_FEATURE_GETNEXT, {}));
+    node.handleMessage(Bd::Message::create<quint8, quint8>(MSG_FEATURE_SET, FEATURE_BM_ON, 1));
+
+    auto expected = QList<Bd::Message>{
+        Bd::Message::create<quint8>(MSG_FEATURE_COUNT, 2),
+        Bd::Message::create<quint8, quint8>(MSG_FEATURE, FEATURE_BM_SIZE, 16),
+        Bd::Message::create<quint8, quint8>(MSG_FEATURE, FEATURE_STRING_SIZE, 24),
+        Bd::Message::create<quint8>(MSG_FEATURE_NA, 0xff),
+        Bd::Message::create<quint8>(MSG_FEATURE_NA, FEATURE_BM_ON),
+    };
+    QCOMPARE(replies, expected);
+    QCOMPARE(node.features().size(), std::size_t(2));
+}
+
+void TestBiDiB::hostReadFeatures_data()
+{
+    QTest::addColumn<Bd::Host::FeatureMode>("mode");
+    QTest::addColumn<int>("requests");
+    // a booster has 5 features
+    QTest::addRow("stepped") << Bd::Host::FeatureMode::Stepped << 6;
+    QTest::addRow("streamed") << Bd::Host::FeatureMode::Streamed << 1;
+}
+
+void TestBiDiB::hostReadFeatures()
+{
+    QFETCH(Bd::Host::FeatureMode, mode);
+    QFETCH(int, requests);
+
+    Bd::Simulator sim;
+    auto booster = sim.addNode(0, Bd::Simulator::NodeKind::Booster);
+    Bd::Host host;
+    connect(&host, &Bd::Host::messageToSend, &sim, &Bd::Simulator::handleMessage);
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+
+    QSignalSpy messageToSend(&host, &Bd::Host::messageToSend);
+    std::optional<Bd::Core::FeatureTable> features;
+    connect(&host,
+            &Bd::Host::featuresRead,
+            this,
+            [&](Bd::Address const &, Bd::Core::FeatureTable const &f) { features = f; });
+    host.readFeatures(sim.address(booster), mode);
+
+    QVERIFY(features);
+    QCOMPARE(features->size(), std::size_t(5));
+    QCOMPARE(features->value(FEATURE_BST_VOLT, 0), quint8(12));
+    QCOMPARE(messageToSend.count(), requests);
+}
+
+void TestBiDiB::hostReadFeaturesTimeout()
+{
+    Bd::Host host;
+    host.setTimeout(std::chrono::milliseconds(20));
+    QSignalSpy requestFailed(&host, &Bd::Host::requestFailed);
+    host.readFeatures(Bd::Address(0x01));
+
+    QVERIFY(requestFailed.wait(1000));
+    QCOMPARE(requestFailed[0][1].value<quint8>(), quint8(MSG_FEATURE_GETALL));
+    QCOMPARE(requestFailed[0][2].value<Bd::Error>(), Bd::Error::Timeout);
+}
+
+void TestBiDiB::nodeCacheReopen()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto path = dir.filePath(QStringLiteral("nodes.cache"));
+
+    Bd::NodeInfo info;
+    info.uniqueId = {.classId = Bd::UniqueId::ClassBooster, .vendorId = 0x0d, .productId = 42};
+    info.softwareVersion = 0x010203;
+    info.nodeTabVersion = 7;
+    info.nodeTabCount = 2;
+    info.nodeTab = {{0, info.uniqueId}, {1, {.vendorId = 0x0d, .productId = 43}}};
+    info.features = {{FEATURE_BST_VOLT, 12}, {FEATURE_STRING_SIZE, 24}};
+    info.productName = QStringLiteral("Booster");
+    info.userName = QStringLiteral("Größenwahn");
+
+    {
+        Bd::NodeCache cache(path);
+        QVERIFY(cache.isOpen());
+        // more than the initial capacity, so the file has to grow
+        for (quint32 i = 0; i < 100; ++i) {
+            auto other = info;
+            other.uniqueId.productId = 1000 + i;
+            QVERIFY(cache.store(other));
+        }
+        QVERIFY(cache.store(info));
+        cache.remove(Bd::UniqueId{.vendorId = 0x0d, .productId = 1000});
+    }
+
+    Bd::NodeCache cache(path);
+    QCOMPARE(cache.size(), 100);
+    QVERIFY(cache.find(info.uniqueId) == info);
+    QVERIFY(!cache.find(Bd::UniqueId{.vendorId = 0x0d, .productId = 1000}));
+    QVERIFY(cache.lookup(info.uniqueId, 0x010203));
+    QVERIFY(!cache.lookup(info.uniqueId, 0x010204));
+}
+
+void TestBiDiB::hostReadNodeCached()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    Bd::NodeCache cache(dir.filePath(QStringLiteral("nodes.cache")));
+
+    Bd::Simulator sim;
+    auto hub = sim.addNode(0, Bd::Simulator::NodeKind::Hub);
+    sim.addNode(hub, Bd::Simulator::NodeKind::Occupancy);
+
+    Bd::Host host;
+    host.setCache(&cache);
+    connect(&host, &Bd::Host::messageToSend, &sim, &Bd::Simulator::handleMessage);
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+    QSignalSpy messageToSend(&host, &Bd::Host::messageToSend);
+    QSignalSpy nodeRead(&host, &Bd::Host::nodeRead);
+
+    // unique ID, software version, both node table entries, features, product and user name
+    host.readNode(sim.address(hub));
+    QCOMPARE(nodeRead.count(), 1);
+    QCOMPARE(nodeRead[0][2].toBool(), false);
+    QCOMPARE(messageToSend.count(), 8);
+    auto cached = *cache.find(sim.uniqueId(hub));
+    QCOMPARE(cached.nodeTabCount, quint8(2));
+    QCOMPARE(cached.nodeTab.size(), 2);
+    QCOMPARE(cached.nodeTab[0], (Bd::NodeTabEntry{0, sim.uniqueId(hub)}));
+    QCOMPARE(cached.productName, QStringLiteral("SimHub"));
+
+    // only unique ID, software version, node table count and the first entry for its version
+    messageToSend.clear();
+    host.readNode(sim.address(hub));
+    QCOMPARE(nodeRead.count(), 2);
+    QCOMPARE(nodeRead[1][2].toBool(), true);
+    QCOMPARE(nodeRead[1][1].value<Bd::NodeInfo>(), cached);
+    QCOMPARE(messageToSend.count(), 4);
+
+    // the node table alone is answered from the record after its first entry
+    QSignalSpy nodeTabRead(&host, &Bd::Host::nodeTabRead);
+    messageToSend.clear();
+    host.readNodeTab(sim.address(hub));
+    QCOMPARE(nodeTabRead.count(), 1);
+    QCOMPARE(nodeTabRead[0][2].value<QList<Bd::NodeTabEntry>>(), cached.nodeTab);
+    QCOMPARE(messageToSend.count(), 2);
+
+    // the same count with another version is a different table
+    auto stale = cached;
+    ++stale.nodeTabVersion;
+    cache.store(stale);
+    host.readNode(sim.address(hub));
+    QCOMPARE(nodeRead.count(), 3);
+    QCOMPARE(nodeRead[2][2].toBool(), false);
+    QCOMPARE(*cache.find(sim.uniqueId(hub)), cached);
+
+    // a new node below the hub invalidates the record
+    sim.addNode(hub, Bd::Simulator::NodeKind::Booster);
+    host.readNode(sim.address(hub));
+    QCOMPARE(nodeRead.count(), 4);
+    QCOMPARE(nodeRead[3][2].toBool(), false);
+    QCOMPARE(cache.find(sim.uniqueId(hub))->nodeTabCount, quint8(3));
+    QCOMPARE(cache.find(sim.uniqueId(hub))->nodeTab.size(), 3);
+}
+
+void TestBiDiB::discoveryTree()
+{
+    // interface plus four levels of hubs, the deepest address stack BiDiB allows
+    Bd::Simulator sim;
+    sim.populate(100, 8);
+    QCOMPARE(sim.nodeCount(), 100);
+    QCOMPARE(sim.address(sim.nodeCount() - 1).size(), 4);
+
+    Bd::Host host;
+    connect(&host,
+            &Bd::Host::messageToSend,
+            &sim,
+            &Bd::Simulator::handleMessage,
+            Qt::QueuedConnection);
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+
+    Bd::Discovery discovery(&host);
+    qsizetype maxPending = 0;
+    connect(&discovery, &Bd::Discovery::progress, this, [&](qsizetype, qsizetype pending) {
+        maxPending = std::max(maxPending, pending);
+    });
+    QSignalSpy finished(&discovery, &Bd::Discovery::finished);
+    discovery.start();
+    QVERIFY(finished.wait(5000));
+
+    auto const &nodes = discovery.nodes();
+    QCOMPARE(nodes.size(), sim.nodeCount());
+    QCOMPARE(nodes[0].uniqueId, sim.uniqueId(0));
+    for (auto const &node : nodes) {
+        auto index = sim.find(node.address);
+        QVERIFY(index >= 0);
+        QCOMPARE(node.uniqueId, sim.uniqueId(index));
+        if (node.parent >= 0)
+            QCOMPARE(node.address.size(), nodes[node.parent].address.size() + 1);
+    }
+    // the hubs of a level are enumerated side by side
+    QVERIFY(maxPending > 1);
+}
+
+void TestBiDiB::nodeTableIncremental()
+{
+    Bd::Simulator sim;
+    auto hub = sim.addNode(0, Bd::Simulator::NodeKind::Hub);
+    auto a = sim.addNode(hub, Bd::Simulator::NodeKind::Occupancy);
+    auto hubAddress = sim.address(hub);
+
+    Bd::Host host;
+    QList<quint8> sent;
+    connect(&host,
+            &Bd::Host::messageToSend,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { sent << m.type(); });
+    connect(&host, &Bd::Host::messageToSend, &sim, &Bd::Simulator::handleMessage);
+    bool drop = false;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &address, Bd::Message const &m) {
+                if (!drop)
+                    host.handleMessage(address, m);
+            });
+
+    Bd::NodeTable table(&host);
+    QList<Bd::Address> added;
+    QList<Bd::Address> removed;
+    connect(&table,
+            &Bd::NodeTable::nodeAdded,
+            this,
+            [&](Bd::Address const &address, Bd::UniqueId const &) { added << address; });
+    connect(&table,
+            &Bd::NodeTable::nodeRemoved,
+            this,
+            [&](Bd::Address const &address, Bd::UniqueId const &) { removed << address; });
+
+    host.readNodeTab(hubAddress);
+    QCOMPARE(table.entries(hubAddress).size(), 2);
+    QCOMPARE(added, QList<Bd::Address>{sim.address(a)});
+    auto version = table.version(hubAddress);
+    QVERIFY(version.has_value());
+
+    // changes in sequence are applied as they are, only the acknowledge goes out
+    sent.clear();
+    auto b = sim.addNode(hub, Bd::Simulator::NodeKind::Booster);
+    QCOMPARE(sent, QList<quint8>{MSG_NODE_CHANGED_ACK});
+    QCOMPARE(table.entries(hubAddress).size(), 3);
+    QCOMPARE(table.entries(hubAddress).last().uniqueId, sim.uniqueId(b));
+    QCOMPARE(added.last(), sim.address(b));
+    QVERIFY(table.version(hubAddress) != version);
+
+    sent.clear();
+    QVERIFY(sim.removeNode(a));
+    QCOMPARE(sent, QList<quint8>{MSG_NODE_CHANGED_ACK});
+    QCOMPARE(removed, QList<Bd::Address>{sim.address(a)});
+    QCOMPARE(table.entries(hubAddress).size(), 2);
+    QCOMPARE(table.resyncCount(), 0);
+
+    // a missed change leaves a gap in the versions, the hub is enumerated again
+    drop = true;
+    auto c = sim.addNode(hub, Bd::Simulator::NodeKind::Accessory);
+    drop = false;
+    auto d = sim.addNode(hub, Bd::Simulator::NodeKind::Accessory);
+    QCOMPARE(table.resyncCount(), 1);
+    QVERIFY(sent.contains(MSG_NODETAB_GETALL));
+    auto entries = table.entries(hubAddress);
+    QCOMPARE(entries.size(), 4);
+    // the number of the removed node went to the first new one
+    QCOMPARE(entries[1].uniqueId, sim.uniqueId(c));
+    QCOMPARE(entries[2].uniqueId, sim.uniqueId(b));
+    QCOMPARE(entries[3].uniqueId, sim.uniqueId(d));
+    QVERIFY(added.contains(sim.address(c)));
+    QVERIFY(added.contains(sim.address(d)));
+}
+
+static Bd::Task<int> boosterPower(Bd::RemoteNode node)
+{
+    // both requests are on the wire before the first reply is awaited
+    auto volt = node.getFeature(FEATURE_BST_VOLT);
+    auto ampere = node.getFeature(FEATURE_BST_AMPERE);
+    auto v = co_await std::move(volt);
+    auto a = co_await std::move(ampere);
+    if (!v)
+        co_return tl::make_unexpected(v.error());
+    if (!a)
+        co_return tl::make_unexpected(a.error());
+    co_return int(*v) * int(*a);
+}
+
+void TestBiDiB::remoteNodeAwait()
+{
+    Bd::Simulator sim;
+    auto booster = sim.addNode(0, Bd::Simulator::NodeKind::Booster);
+
+    Bd::Host host;
+    int sent = 0;
+    connect(&host, &Bd::Host::messageToSend, this, [&] { ++sent; });
+    connect(&host,
+            &Bd::Host::messageToSend,
+            &sim,
+            &Bd::Simulator::handleMessage,
+            Qt::QueuedConnection);
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+
+    Bd::RemoteNode node(&host, sim.address(booster));
+    auto power = boosterPower(node);
+    auto uid = node.getUniqueId();
+    auto missing = node.getFeature(FEATURE_BM_SIZE);
+    QCOMPARE(sent, 4);
+    QVERIFY(!power.isReady());
+
+    QTRY_VERIFY(power.isReady() && uid.isReady() && missing.isReady());
+    QCOMPARE(*power.result(), 12 * 147);
+    QCOMPARE(*uid.result(), sim.uniqueId(booster));
+    QCOMPARE(missing.result().error(), Bd::Error::NotAvailable);
+
+    // the node clamps the voltage, the task reports what it took
+    auto set = node.setFeature(FEATURE_BST_VOLT, 20);
+    QTRY_VERIFY(set.isReady());
+    QCOMPARE(*set.result(), 16);
+
+    // a dropped task still runs to the end and reports through its callback
+    std::optional<quint8> volt;
+    node.getFeature(FEATURE_BST_VOLT).then([&](Bd::Task<quint8>::Result const &r) {
+        volt = r.value_or(0);
+    });
+    QTRY_VERIFY(volt.has_value());
+    QCOMPARE(*volt, 16);
+}
+
+void TestBiDiB::remoteNodeTimeout()
+{
+    Bd::Host host;
+    host.setTimeout(std::chrono::milliseconds(50));
+    // only accessory 2 answers
+    connect(&host,
+            &Bd::Host::messageToSend,
+            this,
+            [&](Bd::Address const &address, Bd::Message const &m) {
+                if (m.type() == MSG_ACCESSORY_SET && m.payload()[0] == 2) {
+                    auto reply = Bd::Message::create<quint8, quint8, quint8, quint8, quint8>(
+                        MSG_ACCESSORY_STATE, 2, m.payload()[1], 2, 0b11, 10);
+                    QMetaObject::invokeMethod(
+                        &host,
+                        [&host, address, reply] { host.handleMessage(address, reply); },
+                        Qt::QueuedConnection);
+                }
+            });
+
+    Bd::RemoteNode node(&host, Bd::Address(1));
+    auto first = node.setAccessory(1, 1);
+    auto second = node.setAccessory(2, 1);
+    QTRY_VERIFY(second.isReady());
+    QVERIFY(!first.isReady());
+    QCOMPARE(*second.result(), (Bd::AccessoryState{2, 1, 2, 0b11, 10}));
+
+    QTRY_VERIFY(first.isReady());
+    QCOMPARE(first.result().error(), Bd::Error::Timeout);
+}
+
+void TestBiDiB::remoteNodePipeline()
+{
+    Bd::Simulator sim;
+    auto booster = sim.addNode(0, Bd::Simulator::NodeKind::Booster);
+
+    Bd::Host host;
+    qsizetype inFlight = 0;
+    qsizetype maxInFlight = 0;
+    connect(&host, &Bd::Host::messageToSend, this, [&] {
+        maxInFlight = std::max(maxInFlight, ++inFlight);
+    });
+    connect(&sim, &Bd::Simulator::messageOut, this, [&] { --inFlight; });
+    connect(&host,
+            &Bd::Host::messageToSend,
+            &sim,
+            &Bd::Simulator::handleMessage,
+            Qt::QueuedConnection);
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+
+    Bd::RemoteNode node(&host, sim.address(booster));
+    QList<quint8> ids;
+    for (int i = 0; i < 32; ++i)
+        ids << FEATURE_BST_VOLT << FEATURE_BST_AMPERE << FEATURE_BM_SIZE;
+
+    host.setWindow(4);
+    auto features = node.getFeatures(ids);
+    QTRY_VERIFY(features.isReady());
+    QCOMPARE(maxInFlight, 4);
+    QCOMPARE(features.result()->size(), ids.size());
+    for (qsizetype i = 0; i < ids.size(); i += 3) {
+        QCOMPARE(*features.result()->at(i), 12);
+        QCOMPARE(*features.result()->at(i + 1), 147);
+        QCOMPARE(features.result()->at(i + 2).error(), Bd::Error::NotAvailable);
+    }
+
+    // the node has room for 64 bytes, ten 6 byte requests
+    auto capacity = node.requestAll({{Bd::Message(MSG_GET_PKT_CAPACITY, {}), {MSG_PKT_CAPACITY}}});
+    QTRY_VERIFY(capacity.isReady());
+    QCOMPARE(capacity.result()->at(0)->payload(), ba(64));
+
+    host.setWindow(32);
+    maxInFlight = 0;
+    auto again = node.getFeatures(ids);
+    QTRY_VERIFY(again.isReady());
+    QCOMPARE(maxInFlight, 10);
+    QVERIFY(*again.result() == *features.result());
+}
+
+void TestBiDiB::messageRouterFilters()
+{
+    using Bd::Core::TypeMask;
+
+    Bd::MessageRouter router;
+    QList<quint8> everything;
+    QList<quint8> boosters;
+    QList<quint32> occupancy;
+    router.subscribe(TypeMask::all(),
+                     Bd::Address::localNode(),
+                     [&](Bd::Address const &, Bd::Message const &m) { everything << m.type(); });
+    router.subscribe(TypeMask::range(MSG_UBST, MSG_UACC - 1),
+                     Bd::Address::localNode(),
+                     [&](Bd::Address const &, Bd::Message const &m) { boosters << m.type(); });
+    // only below hub 1
+    router.subscribe({MSG_BM_OCC, MSG_BM_FREE},
+                     Bd::Address(0x01),
+                     [&](Bd::Address const &a, Bd::Message const &) {
+                         occupancy << a.core().stack();
+                     });
+
+    auto context = std::make_unique<QObject>();
+    router.subscribe(TypeMask::all(), Bd::Address::localNode(), context.get(), [](auto &&...) {
+        QFAIL("delivered after its context was destroyed");
+    });
+    QCOMPARE(router.subscriberCount(), 4);
+    context.reset();
+    QCOMPARE(router.subscriberCount(), 3);
+
+    router.route(Bd::Address(0x0201), Bd::Message::create<quint8>(MSG_BOOST_STAT, 0x80));
+    router.route(Bd::Address(0x0201), Bd::Message::create<quint8>(MSG_BM_OCC, 3));
+    router.route(Bd::Address(0x02), Bd::Message::create<quint8>(MSG_BM_OCC, 3));
+    router.route(Bd::Address(0x01), Bd::Message::create<quint8>(MSG_BM_FREE, 3));
+    QCOMPARE(everything.size(), 4);
+    QCOMPARE(boosters, QList<quint8>{MSG_BOOST_STAT});
+    QCOMPARE(occupancy, (QList<quint32>{0x0201, 0x01}));
+
+    // straight from the decoder
+    Bd::SerialTransport st;
+    st.setSink(&router);
+    auto buf = Bd::Message::create<quint8>(MSG_BM_OCC, 7).toSendBuffer(Bd::Address(0x030201), 1);
+    st.processData(Bd::SerialTransport::frame(*buf));
+    QCOMPARE(occupancy.last(), 0x030201u);
+    QCOMPARE(everything.size(), 5);
+}
+
+void TestBiDiB::messageBusConsumers()
+{
+    struct Counter : Bd::TransportSink
+    {
+        int messages{};
+        void messageReceived(Bd::Core::MessageView const &) override { ++messages; }
+    };
+
+    Counter next;
+    Bd::MessageBus bus(&next);
+    auto fast = bus.subscribe();
+    auto slow = bus.subscribe();
+
+    Bd::SerialTransport st;
+    st.setSink(&bus);
+    auto buf = Bd::Message::create<quint8>(MSG_BM_OCC, 7).toSendBuffer(Bd::Address(0x0201), 5);
+    st.processData(Bd::SerialTransport::frame(*buf));
+    QCOMPARE(next.messages, 1);
+
+    Bd::BusMessage m;
+    QVERIFY(fast.poll(m));
+    QCOMPARE(m.sender(), Bd::Address(0x0201));
+    QCOMPARE(m.num, 5);
+    QCOMPARE(m.message(), Bd::Message::create<quint8>(MSG_BM_OCC, 7));
+    QVERIFY(!fast.poll(m));
+
+    // a reader on another thread, it sees everything in order or knows what it missed
+    constexpr int Count = 10000;
+    int received = 0;
+    bool ordered = true;
+    std::thread reader([&] {
+        Bd::BusMessage m;
+        qint64 last = 0;
+        while (received + fast.lost() < Count) {
+            if (!fast.poll(m)) {
+                fast.wait();
+                continue;
+            }
+            ordered = ordered && m.type == MSG_BM_FREE && m.timestamp >= last;
+            last = m.timestamp;
+            ++received;
+        }
+    });
+    for (int i = 0; i < Count; ++i)
+        bus.publish(Bd::Address(0x01), Bd::Message::create<quint8>(MSG_BM_FREE, i));
+    reader.join();
+    QVERIFY(ordered);
+    QCOMPARE(received + fast.lost(), quint64(Count));
+    QCOMPARE(fast.backlog(), quint64(0));
+
+    // the other one fell behind by more than a lap, missed the oldest and knows it
+    QCOMPARE(slow.backlog(), quint64(Count + 1));
+    QVERIFY(slow.poll(m));
+    QCOMPARE(slow.lost(), quint64(Count + 1 - Bd::MessageBus::Capacity));
+    QCOMPARE(bus.lost(), slow.lost());
+    QCOMPARE(m.type, MSG_BM_FREE);
+}
+
+void TestBiDiB::layoutStateSnapshots()
+{
+    Bd::LayoutState state;
+    Bd::LayoutState::Reader reader(state.snapshots());
+    QVERIFY(reader.isValid());
+    Bd::Address const node(0x01);
+
+    QVERIFY(state.apply(node, Bd::Message::create<quint8>(MSG_BM_OCC, 3)));
+    QVERIFY(!state.apply(node, Bd::Message::create<quint8>(MSG_BM_OCC, 3)));
+    QVERIFY(state.apply(node, Bd::Message(MSG_BM_ADDRESS, QByteArray::fromHex("030300"))));
+    // nothing visible before publishing
+    {
+        auto snapshot = reader.lock();
+        QCOMPARE(snapshot->epoch(), quint64(0));
+        QVERIFY(!snapshot->occupied(node, 3));
+    }
+    state.publish();
+
+    auto first = reader.lock();
+    QCOMPARE(first->epoch(), quint64(1));
+    QVERIFY(first->occupied(node, 3));
+    QCOMPARE(first->locos(node, 3), QList<quint16>{3});
+
+    // sections 8..15 from a bulk report, then an accessory, a booster and a port
+    QVERIFY(state.apply(node, Bd::Message(MSG_BM_MULTIPLE, QByteArray::fromHex("080881"))));
+    QVERIFY(state.apply(node, Bd::Message(MSG_ACCESSORY_STATE, QByteArray::fromHex("0201020000"))));
+    QVERIFY(state.apply(node, Bd::Message::create<quint8>(MSG_BOOST_STAT, BIDIB_BST_STATE_ON)));
+    QVERIFY(state.apply(node, Bd::Message(MSG_BOOST_DIAGNOSTIC, QByteArray::fromHex("00400120"))));
+    QVERIFY(state.apply(node, Bd::Message(MSG_LC_STAT, QByteArray::fromHex("000401"))));
+    QVERIFY(state.apply(node, Bd::Message::create<quint8>(MSG_BM_FREE, 3)));
+
+    QSignalSpy published(&state, &Bd::LayoutState::published);
+    state.publish();
+    state.publish();
+    QCOMPARE(published.size(), 1);
+    QCOMPARE(published[0][0].toULongLong(), quint64(2));
+
+    // the reader still holding the first snapshot sees it unchanged
+    QCOMPARE(first->epoch(), quint64(1));
+    QVERIFY(first->occupied(node, 3));
+    QVERIFY(!first->occupied(node, 8));
+    QVERIFY(!first->accessory(node, 2));
+
+    auto const &second = state.current();
+    QCOMPARE(second.epoch(), quint64(2));
+    QVERIFY(!second.occupied(node, 3));
+    QVERIFY(second.locos(node, 3).isEmpty());
+    QCOMPARE(second.occupancy(node).to_ulong(), 0x8100ul);
+    QVERIFY(second.accessory(node, 2) == (Bd::AccessoryState{2, 1, 2, 0, 0}));
+    QVERIFY(second.booster(node)
+            == (Bd::BoosterState{BIDIB_BST_STATE_ON, 0x40, 0x20, std::nullopt}));
+    QCOMPARE(second.port(node, BIDIB_PORTTYPE_SWITCH, 4), std::optional<quint8>(1));
+    QVERIFY(!second.port(node, BIDIB_PORTTYPE_SWITCH, 5));
+
+    // messages handled in one event loop pass end up in one snapshot
+    state.handleMessage(node, Bd::Message::create<quint8>(MSG_BM_OCC, 20));
+    state.handleMessage(node, Bd::Message::create<quint8>(MSG_BM_OCC, 21));
+    QCOMPARE(state.current().epoch(), quint64(2));
+    QVERIFY(published.wait(1000));
+    QCOMPARE(published.size(), 2);
+    QVERIFY(state.current().occupied(node, 20) && state.current().occupied(node, 21));
+
+    // a reader on another thread only ever sees complete snapshots, in order
+    constexpr int Count = 2000;
+    std::atomic<bool> done{false};
+    bool consistent = true;
+    std::thread other([&] {
+        Bd::LayoutState::Reader reader(state.snapshots());
+        quint64 last = 0;
+        while (!done.load()) {
+            auto snapshot = reader.lock();
+            auto epoch = snapshot->epoch();
+            // every publish below toggles section 30
+            consistent = consistent && epoch >= last
+                         && snapshot->occupied(node, 30) == (epoch > 3 && epoch % 2 == 0);
+            last = epoch;
+        }
+    });
+    for (int i = 0; i < Count; ++i) {
+        state.apply(node, Bd::Message::create<quint8>(i % 2 ? MSG_BM_FREE : MSG_BM_OCC, 30));
+        state.publish();
+    }
+    done = true;
+    other.join();
+    QVERIFY(consistent);
+    QCOMPARE(state.current().epoch(), quint64(3 + Count));
+}
+
+void TestBiDiB::occupancyBulkUpdates()
+{
+    Bd::Simulator sim;
+    auto hub = sim.addNode(0, Bd::Simulator::NodeKind::Hub);
+    auto detector = sim.addNode(hub, Bd::Simulator::NodeKind::Occupancy);
+    auto node = sim.address(detector);
+
+    Bd::Occupancy occupancy;
+    QList<Bd::Message> sent;
+    connect(&occupancy,
+            &Bd::Occupancy::messageToSend,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { sent << m; });
+    connect(&occupancy, &Bd::Occupancy::messageToSend, &sim, &Bd::Simulator::handleMessage);
+    bool drop = false;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &a, Bd::Message const &m) {
+                if (!drop)
+                    occupancy.handleMessage(a, m);
+            });
+    QList<std::pair<Bd::Core::SectionSet, Bd::Core::SectionSet>> changes;
+    connect(&occupancy,
+            &Bd::Occupancy::changed,
+            this,
+            [&](Bd::Address const &a,
+                Bd::Core::SectionSet const &c,
+                Bd::Core::SectionSet const &o) {
+                QVERIFY(a == node);
+                changes << std::pair{c, o};
+            });
+
+    // single reports are mirrored back
+    QVERIFY(sim.setOccupied(detector, 3, true));
+    QCOMPARE(changes.size(), 1);
+    QVERIFY(changes[0].first == Bd::Core::SectionSet::range(3, 1));
+    QVERIFY(occupancy.occupied(node, 3));
+    QCOMPARE(sent, QList{Bd::Message::create<quint8>(MSG_BM_MIRROR_OCC, 3)});
+
+    // missed reports are caught up with in one bulk report and one change mask
+    drop = true;
+    sim.setOccupied(detector, 3, false);
+    sim.setOccupied(detector, 5, true);
+    sim.setOccupied(detector, 9, true);
+    sim.setOccupied(detector, 15, true);
+    drop = false;
+    sent.clear();
+    occupancy.resync(node, 0, 16);
+    QCOMPARE(changes.size(), 2);
+    QCOMPARE(changes[1].first.count(), std::size_t(4));
+    QVERIFY(changes[1].first.test(3) && changes[1].first.test(15));
+    QVERIFY(changes[1].second == occupancy.sections(node));
+    QCOMPARE(occupancy.sections(node).count(), std::size_t(3));
+    QVERIFY(!occupancy.occupied(node, 3) && occupancy.occupied(node, 9));
+    QCOMPARE(sent.size(), 2);
+    QCOMPARE(sent[0], Bd::Message::create<quint8, quint8>(MSG_BM_GET_RANGE, 0, 16));
+    QCOMPARE(sent[1], Bd::Message(MSG_BM_MIRROR_MULTIPLE, ba(0, 16, 0x20, 0x82)));
+
+    // an unchanged state reports nothing, but is still acknowledged
+    occupancy.resync(node, 0, 16);
+    QCOMPARE(changes.size(), 2);
+    QCOMPARE(sent.size(), 4);
+
+    occupancy.setAcknowledge(false);
+    sent.clear();
+    sim.setOccupied(detector, 0, true);
+    QCOMPARE(changes.size(), 3);
+    QVERIFY(sent.isEmpty());
+}
+
+void TestBiDiB::locoPositionsIndex()
+{
+    Bd::LocoPositions positions;
+    QStringList feed;
+    connect(&positions,
+            &Bd::LocoPositions::locoEntered,
+            this,
+            [&](quint16 loco, Bd::Address const &node, quint8 section) {
+                feed << QStringLiteral("+%1@%2.%3").arg(loco).arg(node.core().stack()).arg(section);
+            });
+    connect(&positions,
+            &Bd::LocoPositions::locoLeft,
+            this,
+            [&](quint16 loco, Bd::Address const &node, quint8 section) {
+                feed << QStringLiteral("-%1@%2.%3").arg(loco).arg(node.core().stack()).arg(section);
+            });
+
+    Bd::Address const a(0x01);
+    Bd::Address const b(0x02);
+    // loco 3 facing backwards and loco 1000 in section 4 of a, loco 3 also in section 5
+    positions.handleMessage(a, Bd::Message(MSG_BM_ADDRESS, ba(4, 0x03, 0x80, 0xe8, 0x03)));
+    positions.handleMessage(a, Bd::Message(MSG_BM_ADDRESS, ba(5, 0x03, 0x00)));
+    QCOMPARE(feed, (QStringList{"+3@1.4", "+1000@1.4", "+3@1.5"}));
+    QCOMPARE(positions.size(), 2);
+    QVERIFY(positions.sections(3)
+            == (QList{Bd::Core::SectionKey(a.core(), 4), Bd::Core::SectionKey(a.core(), 5)}));
+    QCOMPARE(positions.locos(a, 4), (QList<quint16>{3, 1000}));
+
+    // a repeated report changes nothing, a new one only what differs
+    feed.clear();
+    positions.handleMessage(a, Bd::Message(MSG_BM_ADDRESS, ba(4, 0x03, 0x80, 0xe8, 0x03)));
+    QVERIFY(feed.isEmpty());
+    positions.handleMessage(a, Bd::Message(MSG_BM_ADDRESS, ba(4, 0xe8, 0x03)));
+    QCOMPARE(feed, QStringList{"-3@1.4"});
+    QVERIFY(positions.sections(3) == QList{Bd::Core::SectionKey(a.core(), 5)});
+
+    // address 0: occupied, but by something without an address
+    feed.clear();
+    positions.handleMessage(b, Bd::Message(MSG_BM_ADDRESS, ba(1, 0x00, 0x00)));
+    QVERIFY(feed.isEmpty());
+    positions.handleMessage(b, Bd::Message(MSG_BM_ADDRESS, ba(1, 0xe8, 0x03)));
+    positions.handleMessage(a, Bd::Message::create<quint8>(MSG_BM_FREE, 4));
+    QCOMPARE(feed, (QStringList{"+1000@2.1", "-1000@1.4"}));
+    QVERIFY(positions.sections(1000) == QList{Bd::Core::SectionKey(b.core(), 1)});
+    QVERIFY(positions.locos(a, 4).isEmpty());
+
+    feed.clear();
+    positions.removeNode(a);
+    QCOMPARE(feed, QStringList{"-3@1.5"});
+    QCOMPARE(positions.size(), 1);
+}
+
+void TestBiDiB::telemetryHistory()
+{
+    using Quantity = Bd::Telemetry::Quantity;
+    using Series = Bd::Core::TimeSeries;
+    Bd::Telemetry telemetry;
+    Bd::Address const booster(0x01);
+    Bd::Address const detector(0x02);
+
+    auto before = QDateTime::currentMSecsSinceEpoch();
+    telemetry.handleMessage(booster,
+                            Bd::Message(MSG_BOOST_DIAGNOSTIC,
+                                        ba(BIDIB_BST_DIAG_I, 100, BIDIB_BST_DIAG_V, 150)));
+    telemetry.handleMessage(detector, Bd::Message::create<quint8, quint8>(MSG_BM_CURRENT, 3, 20));
+    telemetry.handleMessage(detector,
+                            Bd::Message::create<quint16, quint16>(MSG_BM_SPEED, 0x8003, 80));
+    auto after = QDateTime::currentMSecsSinceEpoch();
+    QCOMPARE(telemetry.channels().size(), 4);
+
+    auto current = telemetry.query({0x01, Quantity::BoosterCurrent}, before, after);
+    QCOMPARE(current.size(), 1);
+    QCOMPARE(current[0].min, 100);
+    QCOMPARE(telemetry.query({0x01, Quantity::BoosterVoltage}, before, after)[0].min, 150);
+    QCOMPARE(telemetry.query({0x02, Quantity::DetectorCurrent, 3}, before, after)[0].min, 20);
+    QCOMPARE(telemetry.query({0x02, Quantity::LocoSpeed, 3}, before, after)[0].min, 80);
+    QVERIFY(telemetry.query({0x02, Quantity::DetectorCurrent, 4}, before, after).isEmpty());
+
+    // a week at one value per second: the raw values of the last hours, minutes for all of it
+    Bd::Telemetry::Channel const channel{0x01, Quantity::BoosterTemperature};
+    constexpr qint64 Start = 1'700'000'000'000;
+    constexpr qint64 Seconds = 7 * 24 * 3600;
+    for (qint64 i = 0; i < Seconds; ++i)
+        telemetry.record(channel, Start + i * 1000, 40 + (i / 60) % 10);
+    auto const end = Start + (Seconds - 1) * 1000;
+
+    QCOMPARE(telemetry.query(channel, end - 9999, end).size(), 10);
+    QVERIFY(telemetry.query(channel, Start, Start + 60'000).isEmpty());
+    auto seconds = telemetry.query(channel, end - 60'000, end, Series::Second);
+    QCOMPARE(seconds.size(), 61);
+    QCOMPARE(seconds.back().time, end);
+
+    // the history starts and ends in the middle of a minute
+    auto minutes = telemetry.query(channel, Start - 60'000, end, Series::Minute);
+    QCOMPARE(minutes.size(), Seconds / 60 + 1);
+    QCOMPARE(minutes[0].time, Start - Start % 60'000);
+    QVERIFY(minutes[0] == (Bd::Core::SeriesPoint{minutes[0].time, 40, 40, 40}));
+    QVERIFY(minutes[1] == (Bd::Core::SeriesPoint{minutes[1].time, 40, 41, 40}));
+    QVERIFY(telemetry.memoryUsage() < 1024 * 1024);
+}
+
+void TestBiDiB::schedulerTimers()
+{
+    using namespace std::chrono_literals;
+    Bd::Scheduler scheduler;
+    QList<int> fired;
+    scheduler.schedule(30ms, [&] { fired << 30; });
+    scheduler.schedule(10ms, [&] { fired << 10; });
+    auto cancelled = scheduler.schedule(20ms, [&] { fired << 20; });
+    QVERIFY(scheduler.cancel(cancelled));
+    QVERIFY(!scheduler.cancel(cancelled));
+    QVERIFY(!scheduler.cancel(0));
+
+    // a periodic timer cancelling itself
+    int ticks = 0;
+    Bd::Scheduler::Id periodic = 0;
+    periodic = scheduler.every(5ms, [&] {
+        if (++ticks == 3)
+            scheduler.cancel(periodic);
+    });
+    QCOMPARE(scheduler.size(), 3);
+
+    // many timers cost nothing to add and remove
+    QList<Bd::Scheduler::Id> many;
+    for (int i = 0; i < 10000; ++i)
+        many << scheduler.schedule(std::chrono::milliseconds(50 + i), [&] { fired << -1; });
+    for (auto id : std::as_const(many))
+        QVERIFY(scheduler.cancel(id));
+
+    QTRY_COMPARE(fired, (QList<int>{10, 30}));
+    QTRY_COMPARE(ticks, 3);
+    QCOMPARE(scheduler.size(), 0);
+
+    // timers scheduled from a callback
+    scheduler.schedule(1ms, [&] { scheduler.schedule(0ms, [&] { fired << 0; }); });
+    QTRY_COMPARE(fired.size(), 3);
+    QCOMPARE(fired.last(), 0);
+}
+
+void TestBiDiB::accessoryEngine()
+{
+    Bd::Simulator sim;
+    auto decoder = sim.addNode(0, Bd::Simulator::NodeKind::Accessory);
+    auto node = sim.address(decoder);
+
+    Bd::Host host;
+    QList<Bd::Message> sent, received;
+    connect(&host,
+            &Bd::Host::messageToSend,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { sent << m; });
+    connect(&host, &Bd::Host::messageToSend, &sim, &Bd::Simulator::handleMessage);
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { received << m; });
+    connect(&sim, &Bd::Simulator::messageOut, &host, &Bd::Host::handleMessage);
+    QList<QList<Bd::AccessoryState>> reads;
+    connect(&host,
+            &Bd::Host::accessoriesRead,
+            this,
+            [&](Bd::Address const &a, QList<Bd::AccessoryState> const &states) {
+                QVERIFY(a == node);
+                reads << states;
+            });
+
+    // one request, all states streamed back
+    host.readAccessories(node, 16);
+    QCOMPARE(reads.size(), 1);
+    QCOMPARE(reads[0].size(), 16);
+    QVERIFY(reads[0][15] == (Bd::AccessoryState{15, 0, 2, BIDIB_ACC_STATE_DONE, 0}));
+    QCOMPARE(sent, QList{Bd::Message(MSG_ACCESSORY_GETALL, {})});
+    QCOMPARE(received.size(), 16);
+
+    // the answer tells how long the movement takes, its end is notified
+    received.clear();
+    sim.handleMessage(node, Bd::Message::create<quint8, quint8>(MSG_ACCESSORY_SET, 3, 1));
+    QCOMPARE(received,
+             QList{Bd::Message(MSG_ACCESSORY_STATE, ba(3, 1, 2, BIDIB_ACC_STATE_WAIT, 2))});
+    QTRY_COMPARE(received.size(), 2);
+    QCOMPARE(received[1], Bd::Message(MSG_ACCESSORY_NOTIFY, ba(3, 1, 2, BIDIB_ACC_STATE_DONE, 0)));
+
+    // unknown aspects and accessories are refused
+    received.clear();
+    sim.handleMessage(node, Bd::Message::create<quint8, quint8>(MSG_ACCESSORY_SET, 3, 2));
+    sim.handleMessage(node, Bd::Message::create<quint8, quint8>(MSG_ACCESSORY_SET, 16, 0));
+    QCOMPARE(received,
+             (QList{
+                 Bd::Message(MSG_ACCESSORY_STATE,
+                             ba(3, 1, 2, BIDIB_ACC_STATE_ERROR, BIDIB_ACC_STATE_ERROR_VOID)),
+                 Bd::Message(MSG_ACCESSORY_STATE,
+                             ba(16, 0xff, 0, BIDIB_ACC_STATE_ERROR, BIDIB_ACC_STATE_ERROR_VOID)),
+             }));
+
+    // spontaneous errors are notified once and show up in the next read
+    received.clear();
+    QVERIFY(sim.failAccessory(decoder, 5, BIDIB_ACC_STATE_ERROR_FUSE));
+    QVERIFY(sim.failAccessory(decoder, 5, BIDIB_ACC_STATE_ERROR_FUSE));
+    QCOMPARE(received,
+             QList{Bd::Message(MSG_ACCESSORY_NOTIFY,
+                               ba(5, 0, 2, BIDIB_ACC_STATE_ERROR, BIDIB_ACC_STATE_ERROR_FUSE))});
+    QVERIFY(!sim.failAccessory(0, 0, BIDIB_ACC_STATE_ERROR_FUSE));
+
+    host.readAccessories(node, 16);
+    QCOMPARE(reads.size(), 2);
+    QVERIFY(reads[1][3] == (Bd::AccessoryState{3, 1, 2, BIDIB_ACC_STATE_DONE, 0}));
+    QVERIFY(reads[1][5]
+            == (Bd::AccessoryState{5, 0, 2, BIDIB_ACC_STATE_ERROR, BIDIB_ACC_STATE_ERROR_FUSE}));
+}
+
+void TestBiDiB::lcPortEngine()
+{
+    Bd::Simulator sim;
+    auto decoder = sim.addNode(0, Bd::Simulator::NodeKind::LightControl);
+    auto node = sim.address(decoder);
+
+    QList<Bd::Message> replies;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { replies << m; });
+    auto queryAll = [&](quint16 select, quint16 start = 0, quint16 end = 0xffff) {
+        replies.clear();
+        sim.handleMessage(node,
+                          Bd::Message::create<quint16, quint16, quint16>(MSG_LC_PORT_QUERY_ALL,
+                                                                         select,
+                                                                         start,
+                                                                         end));
+        // the end of the list is marked with MSG_LC_NA
+        if (replies.isEmpty() || !(replies.last() == Bd::Message(MSG_LC_NA, ba(0xff, 0xff))))
+            return qsizetype(-1);
+        return replies.size() - 1;
+    };
+
+    // all 64 ports in one go, or only those of the selected types
+    QCOMPARE(queryAll(0xffff), 64);
+    QCOMPARE(queryAll(1 << BIDIB_PORTTYPE_LIGHT), 16);
+    QCOMPARE(replies[0], Bd::Message(MSG_LC_STAT, ba(BIDIB_PORTTYPE_LIGHT, 0, 0)));
+    QCOMPARE(queryAll(1 << BIDIB_PORTTYPE_SWITCH, 0x0200, 0x0400), 2);
+    QCOMPARE(queryAll(1 << BIDIB_PORTTYPE_SOUND), 0);
+
+    // type model: the type in the low byte, the number in the high byte
+    replies.clear();
+    sim.handleMessage(node, Bd::Message(MSG_LC_OUTPUT, ba(BIDIB_PORTTYPE_LIGHT, 4, 1)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_OUTPUT, ba(BIDIB_PORTTYPE_INPUT, 0, 1)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_OUTPUT, ba(BIDIB_PORTTYPE_LIGHT, 16, 1)));
+    QCOMPARE(replies,
+             (QList{
+                 Bd::Message(MSG_LC_STAT, ba(BIDIB_PORTTYPE_LIGHT, 4, 1)),
+                 Bd::Message(MSG_LC_NA, ba(BIDIB_PORTTYPE_INPUT, 0)),
+                 Bd::Message(MSG_LC_NA, ba(BIDIB_PORTTYPE_LIGHT, 16)),
+             }));
+
+    // flat model: ports are numbered switches first, then lights
+    replies.clear();
+    sim.handleMessage(node,
+                      Bd::Message::create<quint8, quint8>(MSG_FEATURE_SET,
+                                                          FEATURE_CTRL_PORT_FLAT_MODEL,
+                                                          1));
+    QCOMPARE(replies, QList{Bd::Message(MSG_FEATURE, ba(FEATURE_CTRL_PORT_FLAT_MODEL, 64))});
+    replies.clear();
+    sim.handleMessage(node, Bd::Message::create<quint16>(MSG_LC_PORT_QUERY, 36));
+    sim.handleMessage(node, Bd::Message::create<quint16>(MSG_LC_PORT_QUERY, 64));
+    QCOMPARE(replies,
+             (QList{
+                 Bd::Message(MSG_LC_STAT, ba(36, 0, 1)),
+                 Bd::Message(MSG_LC_NA, ba(64, 0)),
+             }));
+    QCOMPARE(queryAll(1 << BIDIB_PORTTYPE_LIGHT, 40), 8);
+    QCOMPARE(replies[0], Bd::Message(MSG_LC_STAT, ba(40, 0, 0)));
+}
+
+void TestBiDiB::lcPortConfig()
+{
+    Bd::Simulator sim;
+    auto decoder = sim.addNode(0, Bd::Simulator::NodeKind::LightControl);
+    auto node = sim.address(decoder);
+
+    QList<Bd::Message> replies;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { replies << m; });
+
+    // only the configured ports answer, the full range costs no more than they do
+    sim.handleMessage(node, Bd::Message(MSG_LC_CONFIGX_GET_ALL, {}));
+    QCOMPARE(replies.size(), 16 + 8);
+    QCOMPARE(replies[0],
+             Bd::Message(MSG_LC_CONFIGX,
+                         ba(BIDIB_PORTTYPE_LIGHT,
+                            0,
+                            BIDIB_PCFG_LEVEL_PORT_ON,
+                            255,
+                            BIDIB_PCFG_LEVEL_PORT_OFF,
+                            0,
+                            BIDIB_PCFG_DIMM_UP_8_8,
+                            0x00,
+                            0x08,
+                            BIDIB_PCFG_DIMM_DOWN_8_8,
+                            0x00,
+                            0x08)));
+
+    // values of one to three bytes, answered with all parameters of the port
+    replies.clear();
+    sim.handleMessage(node,
+                      Bd::Message(MSG_LC_CONFIGX_SET,
+                                  ba(BIDIB_PORTTYPE_SWITCH,
+                                     3,
+                                     BIDIB_PCFG_TICKS,
+                                     20,
+                                     BIDIB_PCFG_RGB,
+                                     1,
+                                     2,
+                                     3)));
+    sim.handleMessage(node,
+                      Bd::Message(MSG_LC_CONFIGX_SET,
+                                  ba(BIDIB_PORTTYPE_SWITCH, 3, BIDIB_PCFG_TICKS, 40)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_CONFIGX_GET, ba(BIDIB_PORTTYPE_SWITCH, 4)));
+    Bd::Message const configured(
+        MSG_LC_CONFIGX,
+        ba(BIDIB_PORTTYPE_SWITCH, 3, BIDIB_PCFG_TICKS, 40, BIDIB_PCFG_RGB, 1, 2, 3));
+    QCOMPARE(replies.size(), 3);
+    QCOMPARE(replies[1], configured);
+    QCOMPARE(replies[2], Bd::Message(MSG_LC_CONFIGX, ba(BIDIB_PORTTYPE_SWITCH, 4)));
+
+    // cut short values and unknown ports are refused
+    replies.clear();
+    sim.handleMessage(node,
+                      Bd::Message(MSG_LC_CONFIGX_SET,
+                                  ba(BIDIB_PORTTYPE_SWITCH, 3, BIDIB_PCFG_TICKS, 1, 0x46, 1)));
+    sim.handleMessage(node,
+                      Bd::Message(MSG_LC_CONFIGX_SET,
+                                  ba(BIDIB_PORTTYPE_SWITCH, 32, BIDIB_PCFG_TICKS, 1)));
+    QCOMPARE(replies,
+             (QList{
+                 Bd::Message(MSG_LC_NA, ba(BIDIB_PORTTYPE_SWITCH, 3)),
+                 Bd::Message(MSG_LC_NA, ba(BIDIB_PORTTYPE_SWITCH, 32)),
+             }));
+
+    // ports come in port order, the switch port configured last before the defaults
+    replies.clear();
+    sim.handleMessage(node, Bd::Message(MSG_LC_CONFIGX_GET_ALL, {}));
+    QCOMPARE(replies.size(), 1 + 16 + 8);
+    QCOMPARE(replies.first(), configured);
+
+    // the range selects among the configured ports, number 3 of every type here
+    replies.clear();
+    sim.handleMessage(node,
+                      Bd::Message::create<quint16, quint16>(MSG_LC_CONFIGX_GET_ALL,
+                                                            0x0300,
+                                                            0x0400));
+    QCOMPARE(replies.size(), 3);
+    QCOMPARE(replies.first(), configured);
+}
+
+void TestBiDiB::lcMacroEngine()
+{
+    using Engine = Bd::Core::MacroEngine;
+
+    // timing in ticks: each step waits its delay times the slowdown before the next one
+    Engine engine(4, 8);
+    engine.setStep(0, 0, {2, {BIDIB_PORTTYPE_LIGHT, 0}, 1});
+    engine.setStep(0, 1, {0, {Bd::Core::MacroStep::System, 3}, Engine::DelayFixed});
+    engine.setStep(0, 2, {0, {BIDIB_PORTTYPE_LIGHT, 0}, 0});
+    engine.setStep(1, 0, {0, {Bd::Core::MacroStep::System, 0}, Engine::StartMacro});
+    engine.setStep(1, 1, {1, {BIDIB_PORTTYPE_LIGHT, 1}, 1});
+    QVERIFY(engine.setParameter(0, Engine::Repeat, 2));
+    QVERIFY(engine.setParameter(1, Engine::Slowdown, 10));
+    QVERIFY(!engine.setParameter(0, 9, 1));
+
+    QList<std::tuple<quint64, int, int>> outputs;
+    QList<std::pair<quint64, int>> stops;
+    auto output = [&](quint8, quint16 port, quint8 state) {
+        outputs << std::tuple<quint64, int, int>{engine.now(), port, state};
+    };
+    auto stopped = [&](quint8 macro) { stops << std::pair<quint64, int>{engine.now(), macro}; };
+    // macro 1 starts macro 0 in the same tick
+    engine.start(1, 100);
+    engine.advance(1000, output, stopped);
+    QCOMPARE(outputs,
+             (QList<std::tuple<quint64, int, int>>{
+                 {100, 0x0101, 1},
+                 {100, 0x0001, 1},
+                 {105, 0x0001, 0},
+                 {105, 0x0001, 1},
+                 {110, 0x0001, 0},
+             }));
+    QCOMPARE(stops, (QList<std::pair<quint64, int>>{{110, 0}, {110, 1}}));
+    QCOMPARE(engine.active(), std::size_t(0));
+
+    // the same through a simulated node, a tick is 20 ms there
+    Bd::Simulator sim;
+    auto decoder = sim.addNode(0, Bd::Simulator::NodeKind::LightControl);
+    auto node = sim.address(decoder);
+    QList<Bd::Message> replies;
+    connect(&sim,
+            &Bd::Simulator::messageOut,
+            this,
+            [&](Bd::Address const &, Bd::Message const &m) { replies << m; });
+
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_SET, ba(0, 0, 5, BIDIB_PORTTYPE_LIGHT, 2, 1)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_SET, ba(0, 1, 0, BIDIB_PORTTYPE_LIGHT, 2, 0)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_SET, ba(0, 32, 0, 0, 0, 0)));
+    QCOMPARE(replies,
+             (QList{
+                 Bd::Message(MSG_LC_MACRO, ba(0, 0, 5, BIDIB_PORTTYPE_LIGHT, 2, 1)),
+                 Bd::Message(MSG_LC_MACRO, ba(0, 1, 0, BIDIB_PORTTYPE_LIGHT, 2, 0)),
+                 Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_NOTEXIST)),
+             }));
+
+    replies.clear();
+    QElapsedTimer elapsed;
+    elapsed.start();
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_HANDLE, ba(0, BIDIB_MACRO_START)));
+    QCOMPARE(replies, QList{Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_RUNNING))});
+    QTRY_COMPARE(replies.size(), 4);
+    QVERIFY(elapsed.elapsed() >= 5 * 20);
+    QCOMPARE(replies[1], Bd::Message(MSG_LC_STAT, ba(BIDIB_PORTTYPE_LIGHT, 2, 1)));
+    QCOMPARE(replies[2], Bd::Message(MSG_LC_STAT, ba(BIDIB_PORTTYPE_LIGHT, 2, 0)));
+    QCOMPARE(replies[3], Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_OFF)));
+
+    // parameters, and steps kept through delete and restore
+    replies.clear();
+    sim.handleMessage(node,
+                      Bd::Message::create<quint8, quint8, quint32>(MSG_LC_MACRO_PARA_SET,
+                                                                   0,
+                                                                   BIDIB_MACRO_PARA_REPEAT,
+                                                                   3));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_HANDLE, ba(0, BIDIB_MACRO_SAVE)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_HANDLE, ba(0, BIDIB_MACRO_DELETE)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_GET, ba(0, 0)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_HANDLE, ba(0, BIDIB_MACRO_RESTORE)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_GET, ba(0, 0)));
+    sim.handleMessage(node, Bd::Message(MSG_LC_MACRO_PARA_GET, ba(0, BIDIB_MACRO_PARA_REPEAT)));
+    QCOMPARE(replies,
+             (QList{
+                 Bd::Message(MSG_LC_MACRO_PARA, ba(0, BIDIB_MACRO_PARA_REPEAT, 3, 0, 0, 0)),
+                 Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_SAVE)),
+                 Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_DELETE)),
+                 Bd::Message(MSG_LC_MACRO, ba(0, 0, 0, 0xff, 0, BIDIB_MSYS_END_OF_MACRO)),
+                 Bd::Message(MSG_LC_MACRO_STATE, ba(0, BIDIB_MACRO_RESTORE)),
+                 Bd::Message(MSG_LC_MACRO, ba(0, 0, 5, BIDIB_PORTTYPE_LIGHT, 2, 1)),
+                 Bd::Message(MSG_LC_MACRO_PARA, ba(0, BIDIB_MACRO_PARA_REPEAT, 3, 0, 0, 0)),
+             }));
+}
+
 void TestBiDiB::computeCrc8()
 {
     QCOMPARE(Bd::computeCrc8(QByteArray::fromHex("0370dd47b501c724eabc016f747c7349")), 0x1e);
     QCOMPARE(Bd::computeCrc8(QByteArray::fromHex("0370dd47b501c724eabc016f747c73491e")), 0);
 }
 
+struct CoreSink
+{
+    int frames{};
+    QList<Bd::Error> errors;
+    QList<std::tuple<quint32, quint8, QByteArray>> messages;
+
+    void frame(std::span<const std::byte>) { ++frames; }
+    void message(Bd::Core::MessageView const &msg)
+    {
+        messages << std::make_tuple(msg.address.stack(), msg.type, Bd::toByteArray(msg.payload));
+    }
+    void error(Bd::Error error, std::span<const std::byte>) { errors << error; }
+};
+
+void TestBiDiB::coreFrameDecoderFragmentedStream()
+{
+    auto buf = Bd::Message(MSG_SYS_MAGIC, ba(0xfe, 0xaf)).toSendBuffer(Bd::Address(0x0201), 3);
+    auto wire = ba(0x11, 0x22) + Bd::SerialTransport::frame(*buf);
+
+    Bd::Core::FrameDecoder<> decoder;
+    CoreSink sink;
+    for (auto c : wire)
+        decoder.feed(Bd::asBytes(QByteArrayView(&c, 1)), sink);
+
+    QCOMPARE(sink.frames, 1);
+    QVERIFY(sink.errors.isEmpty());
+    QCOMPARE(sink.messages.count(), 1);
+    QCOMPARE(sink.messages[0], std::make_tuple(0x0201u, quint8(MSG_SYS_MAGIC), ba(0xfe, 0xaf)));
+}
+
+void TestBiDiB::coreFrameDecoderOverflow()
+{
+    Bd::Core::FrameDecoder<4> decoder;
+    CoreSink sink;
+    decoder.feed(Bd::asBytes(ba(BIDIB_PKT_MAGIC, 1, 2, 3, 4, 5, BIDIB_PKT_MAGIC)), sink);
+    QCOMPARE(sink.frames, 0);
+    QCOMPARE(sink.errors, QList<Bd::Error>{Bd::Error::MessageTooLarge});
+}
+
+void TestBiDiB::corePackerFixedCapacity()
+{
+    auto fits = Bd::Core::Packer<4>::pack(quint8(1), quint16(2));
+    QVERIFY(fits.ok());
+    QCOMPARE(Bd::toByteArray(fits.buffer().bytes()), ba(1, 2, 0));
+
+    auto overflows = Bd::Core::Packer<4>::pack(quint8(1), quint32(2));
+    QVERIFY(!overflows.ok());
+}
+
 struct S
 {
     quint8 x;
@@ -0,0 +1,14 @@
+#include "uniqueid.h"
+
+#include <QDebug>
+
+namespace Bd {
+
+QDebug operator<<(QDebug d, UniqueId const &id)
+{
+    d << "VID" << qUtf8Printable(QString::number(id.vendorId, 16)) << "PID"
+      << qUtf8Printable(QString::number(id.productId, 16));
+    return d;
+}
+
+} // namespace Bd
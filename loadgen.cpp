@@ -0,0 +1,62 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSerialPort>
+#include <QTimer>
+
+#include <bidib/serialconnection.h>
+#include <bidib/trafficgenerator.h>
+
+// Plays generated BiDiB traffic into a serial port or pty in real time, e.g. one end of
+// "socat pty,link=/tmp/bidib-A pty,link=/tmp/bidib-B" while the host under test reads the other.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption portOption({"p", "port"}, "Serial port or pty to write to.", "port");
+    QCommandLineOption baudOption({"b", "baud"}, "Baud rate.", "rate", "115200");
+    QCommandLineOption seedOption({"s", "seed"}, "Random seed.", "seed", "1");
+    QCommandLineOption scaleOption({"x", "scale"}, "Traffic rate multiplier.", "factor", "1");
+    QCommandLineOption durationOption({"d", "duration"}, "Seconds to run, 0 for ever.", "s", "0");
+    QCommandLineOption tickOption({"t", "tick"}, "Write interval in milliseconds.", "ms", "10");
+    parser.addOptions(
+        {portOption, baudOption, seedOption, scaleOption, durationOption, tickOption});
+    parser.process(app);
+
+    if (!parser.isSet(portOption))
+        parser.showHelp(1);
+
+    QSerialPort serial(parser.value(portOption));
+    auto profile = Bd::SerialConnection::profileForBaudRate(parser.value(baudOption).toInt());
+    if (!serial.open(QIODevice::WriteOnly)) {
+        qCritical() << "cannot open" << serial.portName() << serial.errorString();
+        return 1;
+    }
+    Bd::SerialConnection::applyProfile(serial, profile);
+
+    Bd::TrafficGenerator generator(Bd::TrafficProfile{}.scaled(parser.value(scaleOption).toDouble()),
+                                   parser.value(seedOption).toUInt());
+    auto duration = std::chrono::seconds(parser.value(durationOption).toInt());
+
+    QElapsedTimer clock;
+    clock.start();
+
+    QTimer tick;
+    tick.setInterval(parser.value(tickOption).toInt());
+    QObject::connect(&tick, &QTimer::timeout, &app, [&] {
+        // catch up with the wall clock so that timer jitter does not change the load
+        auto now = std::chrono::microseconds(clock.nsecsElapsed() / 1000);
+        serial.write(generator.generate(now - generator.elapsed()));
+
+        if (duration.count() > 0 && now >= duration) {
+            qInfo() << generator.messageCount() << "messages in" << generator.frameCount()
+                    << "frames";
+            app.quit();
+        }
+    });
+    tick.start();
+
+    return app.exec();
+}
@@ -1,15 +1,27 @@
 #include <QByteArray>
+#include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QHash>
 #include <QRandomGenerator>
 #include <QSerialPort>
 #include <QTimer>
 #include <QtCore/qobjectdefs.h>
 
+#include <chrono>
+#include <memory>
 #include <signal.h>
 
 #include <bidib/bidib_messages.h>
+#include <bidib/core/accessories.h>
+#include <bidib/core/features.h>
+#include <bidib/core/portconfig.h>
+#include <bidib/core/ports.h>
 #include <bidib/message.h>
 #include <bidib/pack.h>
+#include <bidib/scheduler.h>
+#include <bidib/serialconnection.h>
+#include <bidib/simulator.h>
+#include <bidib/uniqueid.h>
 
 struct BiDiBMessage
 {
@@ -65,13 +77,11 @@ class BiDiBSerialTransport : public QObject
     Q_OBJECT
 
 public:
-    explicit BiDiBSerialTransport(QString port)
+    explicit BiDiBSerialTransport(QString port, Bd::SerialProfile profile)
         : _serial(port)
+        , _profile(profile)
     {
-        _serial.setBaudRate(QSerialPort::Baud115200);
-        _serial.setDataBits(QSerialPort::Data8);
-        _serial.setParity(QSerialPort::NoParity);
-        _serial.setStopBits(QSerialPort::OneStop);
+        Bd::SerialConnection::applyProfile(_serial, _profile);
 
         connect(&_serial,
                 &QSerialPort::readyRead,
@@ -88,23 +98,31 @@ public:
                         return;
                     if (_serial.isOpen())
                         _serial.close();
-                    QTimer::singleShot(1000, this, [this] { _serial.open(QIODevice::ReadWrite); });
+                    QTimer::singleShot(1000, this, [this] { open(); });
                 });
 
-        _serial.open(QIODevice::ReadWrite);
+        open();
+    }
+
+    void open()
+    {
+        // the low latency flag can only be set on an open port
+        if (_serial.open(QIODevice::ReadWrite))
+            Bd::SerialConnection::applyProfile(_serial, _profile);
     }
 
     void receiveData()
     {
-        auto data = _serial.readAll();
-        quint8 crc = 0;
+        auto data = _serial.read(_profile.readChunkSize);
+        if (_serial.bytesAvailable() > 0)
+            QMetaObject::invokeMethod(this, &BiDiBSerialTransport::receiveData, Qt::QueuedConnection);
         for (quint8 c : data) {
             switch (c) {
             case BIDIB_PKT_MAGIC:
                 if (_currentPacket.isEmpty())
                     continue;
 
-                if (!crc) {
+                if (!_crc) {
                     // remove CRC
                     _currentPacket.removeLast();
                     emit packetReceived(_currentPacket);
@@ -113,7 +131,7 @@ public:
                 }
 
                 _currentPacket.clear();
-                crc = 0;
+                _crc = 0;
                 break;
 
             case BIDIB_PKT_ESCAPE:
@@ -125,7 +143,7 @@ public:
                     _escape = false;
                     c = c ^ 0x20;
                 }
-                crc = crcTable[crc ^ c];
+                _crc = crcTable[_crc ^ c];
                 _currentPacket.append(c);
             }
         }
@@ -161,7 +179,9 @@ signals:
 
 private:
     QSerialPort _serial;
+    Bd::SerialProfile _profile;
     QByteArray _currentPacket{};
+    quint8 _crc{0};
     bool _escape{false};
 };
 
@@ -194,7 +214,20 @@ public slots:
         packet.append(m.type);
         packet.append(m.data);
 
-        emit sendPacket(packet);
+        // messages sent in one go, like a streamed feature list, share packets
+        if (_pending.size() + packet.size() > MaxPacketSize)
+            flush();
+        _pending.append(packet);
+        if (!_flushScheduled) {
+            _flushScheduled = true;
+            QMetaObject::invokeMethod(
+                this,
+                [this] {
+                    _flushScheduled = false;
+                    flush();
+                },
+                Qt::QueuedConnection);
+        }
     }
 
     void parsePacket(QByteArray packet)
@@ -245,6 +278,14 @@ private:
         return msg;
     }
 
+    void flush()
+    {
+        if (_pending.isEmpty())
+            return;
+        emit sendPacket(_pending);
+        _pending.clear();
+    }
+
     inline quint8 nextMsgNum()
     {
         if (_msgNum == 0)
@@ -252,7 +293,11 @@ private:
         return _msgNum++;
     }
 
+    static constexpr qsizetype MaxPacketSize = 64;
+
     quint8 _msgNum{};
+    QByteArray _pending{};
+    bool _flushScheduled{false};
 };
 
 using MessageHandler = std::function<void(BiDiBMessage)>;
@@ -270,23 +315,7 @@ struct __attribute__((__packed__)) CsDrive
 };
 static_assert(sizeof(CsDrive) == 9);
 
-struct __attribute__((packed)) UniqueId
-{
-    union {
-        quint8 classId;
-    };
-    quint8 classIdEx;
-    quint8 vendorId;
-    quint32 productId;
-};
-static_assert(sizeof(UniqueId) == 7);
-
-QDebug operator<<(QDebug d, UniqueId const &id)
-{
-    d << "VID" << qUtf8Printable(QString::number(id.vendorId, 16)) << "PID"
-      << qUtf8Printable(QString::number(id.productId, 16));
-    return d;
-}
+using Bd::UniqueId;
 
 using namespace std::placeholders;
 
@@ -377,7 +406,6 @@ public:
         };
 
         registerStaticReply(MSG_SYS_GET_MAGIC, makeMessage<quint16>(MSG_SYS_MAGIC, BIDIB_SYS_MAGIC));
-        registerStaticReply(MSG_FEATURE_GETNEXT, FeatureNA);
         registerStaticReply(MSG_SYS_GET_SW_VERSION,
                             makeMessage(MSG_SYS_SW_VERSION, Version{1, 0, 0}));
         registerStaticReply(MSG_NODETAB_GETNEXT, NodeNA);
@@ -385,31 +413,27 @@ public:
                             makeMessage(MSG_SYS_P_VERSION, quint16{BIDIB_VERSION}));
         registerStaticReply(MSG_SYS_GET_UNIQUE_ID, makeMessage(MSG_SYS_UNIQUE_ID, MyUniqueId));
 
-        _measurementTimer.setInterval(1000);
-        connect(&_measurementTimer, &QTimer::timeout, this, [this] {
-            quint8 v = std::clamp<quint8>(_boosterVoltage, 0, 25) * 10;
-            sendReply<KeyValue8, KeyValue8>(MSG_BOOST_DIAGNOSTIC,
-                                            {BIDIB_BST_DIAG_I, 100},
-                                            {BIDIB_BST_DIAG_V, v});
-        });
-
         _nodes << MyUniqueId << OtherUniqueId;
 
-        _features[FEATURE_BST_AMPERE] = 147;
-        _features[FEATURE_BST_CURMEAS_INTERVAL] = _measurementTimer.interval() / 10;
-        _features[FEATURE_BST_CUTOUT_AVAILABLE] = 1;
-        _features[FEATURE_BST_CUTOUT_ON] = 1;
-        _features[FEATURE_BST_INHIBIT_AUTOSTART] = 0;
-        _features[FEATURE_BST_VOLT] = _boosterVoltage;
-        _features[FEATURE_BST_VOLT_ADJUSTABLE] = 1;
-        //        _features[FEATURE_CTRL_PORT_FLAT_MODEL] = 16;
-        //        _features[FEATURE_CTRL_PORT_FLAT_MODEL_EXTENDED] = 0;
-        _features[FEATURE_CTRL_SERVO_COUNT] = 16;
-        _features[FEATURE_ACCESSORY_COUNT] = 16;
-        _features[FEATURE_FW_UPDATE_MODE] = 0;
-        _features[FEATURE_GEN_WATCHDOG] = 10;
-        _features[FEATURE_STRING_SIZE] = 24;
-        _features[FEATURE_STRING_NAMESPACES_AVAILABLE] = 0b101;
+        _features.set(FEATURE_BST_AMPERE, 147);
+        _features.set(FEATURE_BST_CURMEAS_INTERVAL, _measurementInterval.count() / 10);
+        _features.set(FEATURE_BST_CUTOUT_AVAILABLE, 1);
+        _features.set(FEATURE_BST_CUTOUT_ON, 1);
+        _features.set(FEATURE_BST_INHIBIT_AUTOSTART, 0);
+        _features.set(FEATURE_BST_VOLT, _boosterVoltage);
+        _features.set(FEATURE_BST_VOLT_ADJUSTABLE, 1);
+        //        _features.set(FEATURE_CTRL_PORT_FLAT_MODEL, 16);
+        //        _features.set(FEATURE_CTRL_PORT_FLAT_MODEL_EXTENDED, 0);
+        _features.set(FEATURE_CTRL_SWITCH_COUNT, _ports.count(BIDIB_PORTTYPE_SWITCH));
+        _features.set(FEATURE_CTRL_SERVO_COUNT, _ports.count(BIDIB_PORTTYPE_SERVO));
+        _features.set(FEATURE_ACCESSORY_COUNT, quint8(_accessories.size()));
+        _features.set(FEATURE_FW_UPDATE_MODE, 0);
+        _features.set(FEATURE_GEN_WATCHDOG, 10);
+        _features.set(FEATURE_STRING_SIZE, 24);
+        _features.set(FEATURE_STRING_NAMESPACES_AVAILABLE, 0b101);
+
+        for (quint16 i = 0; i < _ports.size(); ++i)
+            _portConfig.set(i, {BIDIB_PCFG_SERVO_SPEED, 55});
 
         _strings[0x0000] = "Roy";
         _strings[0x0001] = "Größenwahn";
@@ -428,16 +452,37 @@ public slots:
 private:
     static const BiDiBMessage NodeNA;
     static const BiDiBMessage FeatureNA;
+    // answer for an accessory number the node does not have
+    static constexpr Bd::Core::AccessoryCell VoidAccessory{
+        0xff,
+        0,
+        Bd::Core::AccessoryCell::Error,
+        Bd::Core::AccessoryCell::ErrorVoid,
+    };
+    // in MSG_ACCESSORY_STATE units of 100 ms
+    static constexpr quint8 AccessoryWait = 10;
 
     QList<MessageHandler> _handlers{255};
     QList<UniqueId> _nodes;
-    QMap<quint8, quint8> _features;
+    Bd::Core::FeatureTable _features;
+    quint16 _featureCursor{0x100};
     quint8 _boosterState{BIDIB_BST_STATE_OFF};
     quint8 _nodeTabVersion{1};
     quint8 _csState{BIDIB_CS_STATE_OFF};
-    QTimer _measurementTimer{};
+    // measurements and accessory movements, 0 while measurements are off
+    Bd::Scheduler _scheduler;
+    Bd::Scheduler::Id _measurementTimer{};
+    std::chrono::milliseconds _measurementInterval{1000};
     quint8 _boosterVoltage{12};
     QMap<quint16, QString> _strings;
+    Bd::Core::PortTable _ports{
+        {BIDIB_PORTTYPE_SWITCH, 16},
+        {BIDIB_PORTTYPE_SERVO, 16},
+    };
+    Bd::Core::PortConfig _portConfig{_ports.size()};
+    Bd::Core::AccessoryBank _accessories{16, 2};
+    // running movements by accessory
+    QHash<quint8, Bd::Scheduler::Id> _movements;
 
     quint8 updateFeature(quint8 id, quint8 value)
     {
@@ -448,16 +493,30 @@ private:
 
         case FEATURE_BST_CURMEAS_INTERVAL:
             value = std::max<quint8>(value, 10);
-            _measurementTimer.setInterval(value * 10);
+            _measurementInterval = std::chrono::milliseconds(value * 10);
+            if (_measurementTimer)
+                startMeasurement();
             break;
 
         default:
-            value = _features[id];
+            // everything else is read only
+            value = _features.value(id, value);
         }
 
         return value;
     }
 
+    void startMeasurement()
+    {
+        _scheduler.cancel(_measurementTimer);
+        _measurementTimer = _scheduler.every(_measurementInterval, [this] {
+            quint8 v = std::clamp<quint8>(_boosterVoltage, 0, 25) * 10;
+            sendReply<KeyValue8, KeyValue8>(MSG_BOOST_DIAGNOSTIC,
+                                            {BIDIB_BST_DIAG_I, 100},
+                                            {BIDIB_BST_DIAG_V, v});
+        });
+    }
+
     HANDLE(MSG_NODETAB_GETALL, void)
     {
         auto e = Enumerator::create(_nodes);
@@ -476,19 +535,19 @@ private:
 
     HANDLE(MSG_FEATURE_GET, quint8 id)
     {
-        if (_features.contains(id))
-            sendReply(MSG_FEATURE, id, _features[id]);
+        if (auto value = _features.value(id))
+            sendReply(MSG_FEATURE, id, *value);
         else
-            sendReply(MSG_FEATURE_NA, FeatureNA);
+            sendReply<quint8>(MSG_FEATURE_NA, id);
     }
 
     HANDLE(MSG_FEATURE_SET, quint8 id, quint8 value)
     {
         if (_features.contains(id)) {
-            _features[id] = updateFeature(id, value);
-            sendReply(MSG_FEATURE, id, _features[id]);
+            _features.update(id, updateFeature(id, value));
+            sendReply(MSG_FEATURE, id, *_features.value(id));
         } else {
-            sendReply(MSG_FEATURE_NA, FeatureNA);
+            sendReply<quint8>(MSG_FEATURE_NA, id);
         }
     }
 
@@ -502,31 +561,56 @@ private:
            std::optional<quint16> start,
            std::optional<quint16> end)
     {
-        for (quint16 port = std::max(quint16(0), start.value_or(0));
-             port < std::min(quint16(15), end.value_or(0xffff));
-             ++port)
-            sendReply(MSG_LC_STAT, quint8(BIDIB_PORTTYPE_SWITCH), port, quint8(0));
-
+        // all states back to back and MSG_LC_NA for the end, batched by the packet parser
+        _ports.query(select.value_or(0xffff),
+                     start.value_or(0),
+                     end.value_or(0xffff),
+                     [this](quint16 port, quint8 state) { sendReply(MSG_LC_STAT, port, state); });
         sendReply(MSG_LC_NA, quint16(0xffff));
     }
 
-    HANDLE(MSG_LC_CONFIGX_GET_ALL, std::optional<quint16> start, std::optional<quint16> end)
+    HANDLE(MSG_LC_CONFIGX_SET, quint16 port, std::span<const std::byte> params)
     {
-        auto s = start.value_or(0);
-        auto e = end.value_or(0xffff);
-
-        for (quint16 port = s; port <= e; ++port) {
-            auto type = port & 0xff;
-            if (type == BIDIB_PORTTYPE_SERVO || type == BIDIB_PORTTYPE_SWITCH)
-                sendReply(MSG_LC_CONFIGX, port, KeyValue8{BIDIB_PCFG_SERVO_SPEED, 55});
+        auto index = _ports.find(port);
+        if (!index || !_portConfig.apply(*index, params)) {
+            sendReply(MSG_LC_NA, port);
+            return;
         }
+        sendPortConfig(*index);
+    }
+
+    HANDLE(MSG_LC_CONFIGX_GET, quint16 port)
+    {
+        if (auto index = _ports.find(port))
+            sendPortConfig(*index);
+        else
+            sendReply(MSG_LC_NA, port);
+    }
+
+    HANDLE(MSG_LC_CONFIGX_GET_ALL, std::optional<quint16> start, std::optional<quint16> end)
+    {
+        // only ports with parameters are visited, however wide the range
+        _portConfig.forEach([&](quint16 index, auto) {
+            auto port = _ports.address(index);
+            if (port >= start.value_or(0) && port < end.value_or(0xffff))
+                sendPortConfig(index);
+        });
     }
 
     HANDLE(MSG_ACCESSORY_GET, quint8 num)
     {
-        quint8 aspect = 0;
-        quint8 total = 3;
-        sendReply(MSG_ACCESSORY_STATE, num, aspect, total, quint8(0), quint8(0));
+        if (_accessories.contains(num))
+            sendReply(MSG_ACCESSORY_STATE, num, _accessories[num]);
+        else
+            sendReply(MSG_ACCESSORY_STATE, num, VoidAccessory);
+    }
+
+    HANDLE(MSG_ACCESSORY_GETALL, void)
+    {
+        // all states back to back, the packet parser batches them into few packets
+        quint8 num = 0;
+        for (auto const &state : _accessories)
+            sendReply(MSG_ACCESSORY_STATE, num++, state);
     }
 
     HANDLE(MSG_ACCESSORY_PARA_GET, quint8 anum, quint8 pnum)
@@ -553,34 +637,53 @@ private:
 
     HANDLE(MSG_ACCESSORY_SET, quint8 anum, quint8 aspect)
     {
-        quint8 total = 2;
-        quint8 execute = 0b00000011;
-        quint8 wait = 10;
-        sendReply(MSG_ACCESSORY_STATE, anum, aspect, total, execute, wait);
-        QTimer::singleShot(1000, this, [this, anum, aspect, total] {
-            quint8 execute = 0b00000010;
-            quint8 wait = 0;
-            sendReply(MSG_ACCESSORY_STATE, anum, aspect, total, execute, wait);
-        });
+        if (!_accessories.contains(anum)) {
+            sendReply(MSG_ACCESSORY_STATE, anum, VoidAccessory);
+            return;
+        }
+
+        auto state = _accessories.operate(anum, aspect, AccessoryWait);
+        sendReply(MSG_ACCESSORY_STATE, anum, state);
+        if (state.failed())
+            return;
+
+        // a new operation replaces the movement still going on
+        _scheduler.cancel(_movements.take(anum));
+        if (!state.moving())
+            return;
+        auto delay = std::chrono::milliseconds(100) * state.wait;
+        _movements.insert(anum, _scheduler.schedule(delay, [this, anum] {
+            _movements.remove(anum);
+            if (_accessories.complete(anum))
+                sendReply(MSG_ACCESSORY_NOTIFY, anum, _accessories[anum]);
+        }));
     }
 
     HANDLE(MSG_FEATURE_GETALL, std::optional<quint8> shouldStream)
     {
-        // bool useStreaming = shouldStream.value_or(0) == 1;
+        if (shouldStream.value_or(0) != 1) {
+            _featureCursor = 0;
+            sendReply<quint8>(MSG_FEATURE_COUNT, _features.size());
+            return;
+        }
 
-        auto e = Enumerator::create(_features);
+        // all features back to back, the packet parser batches them into few packets
+        _featureCursor = 0x100;
+        sendReply<quint8, quint8>(MSG_FEATURE_COUNT, _features.size(), 1);
+        for (auto e : _features)
+            sendReply(MSG_FEATURE, e.id, e.value);
+    }
 
-        sendReply<quint8>(MSG_FEATURE_COUNT, _features.count());
-        if (e->iter.hasNext()) {
-            bindLambda(MSG_FEATURE_GETNEXT, [this, e](auto) {
-                auto feature = e->iter.next();
-                sendReply<quint8, quint8>(MSG_FEATURE, feature.key(), feature.value());
-                if (!e->iter.hasNext())
-                    registerStaticReply(MSG_FEATURE_GETNEXT, FeatureNA);
-            });
-        } else {
-            registerStaticReply(MSG_FEATURE_GETNEXT, FeatureNA);
+    HANDLE(MSG_FEATURE_GETNEXT, void)
+    {
+        auto id = _features.next(_featureCursor);
+        if (!id) {
+            _featureCursor = 0x100;
+            emit messageOut(FeatureNA);
+            return;
         }
+        _featureCursor = *id + 1;
+        sendReply<quint8, quint8>(MSG_FEATURE, *id, *_features.value(*id));
     }
 
     HANDLE(MSG_BOOST_QUERY, void) { sendReply<quint8>(MSG_BOOST_STAT, _boosterState); }
@@ -589,14 +692,14 @@ private:
     {
         _boosterState = BIDIB_BST_STATE_ON;
         sendReply<quint8>(MSG_BOOST_STAT, _boosterState);
-        _measurementTimer.start();
+        startMeasurement();
     }
 
     HANDLE(MSG_BOOST_OFF, quint8 local)
     {
         _boosterState = BIDIB_BST_STATE_OFF;
         sendReply<quint8>(MSG_BOOST_STAT, _boosterState);
-        _measurementTimer.stop();
+        _scheduler.cancel(std::exchange(_measurementTimer, 0));
     }
 
     HANDLE(MSG_STRING_GET, quint8 ns, quint8 id)
@@ -610,6 +713,13 @@ private:
         sendReply(MSG_STRING, ns, id, s);
     }
 
+    void sendPortConfig(quint16 index)
+    {
+        QByteArray params;
+        _portConfig.bytes(index, [&params](quint8 b) { params.append(char(b)); });
+        sendReply(MSG_LC_CONFIGX, _ports.address(index), Bd::asBytes(params));
+    }
+
     template<class... Types>
     void sendReply(int type, Types const &...t)
     {
@@ -674,9 +784,27 @@ int main(int argc, char *argv[])
     signal(SIGTERM, terminate);
     signal(SIGINT, terminate);
 
-    BiDiBSerialTransport serialTransport("/tmp/bidib-interface-B");
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption portOption({"p", "port"},
+                                  "Serial port of the simulated interface.",
+                                  "port",
+                                  "/tmp/bidib-interface-B");
+    QCommandLineOption baudOption({"b", "baud"},
+                                  "Baud rate of the simulated interface.",
+                                  "rate",
+                                  QString::number(QSerialPort::Baud115200));
+    QCommandLineOption nodesOption({"n", "nodes"},
+                                   "Simulate a tree of this many nodes instead of a single node.",
+                                   "count");
+    parser.addOption(portOption);
+    parser.addOption(baudOption);
+    parser.addOption(nodesOption);
+    parser.process(app);
+
+    auto profile = Bd::SerialConnection::profileForBaudRate(parser.value(baudOption).toInt());
+    BiDiBSerialTransport serialTransport(parser.value(portOption), profile);
     BiDiBPacketParser packetParser;
-    BiDiBNode node;
 
     QObject::connect(&serialTransport,
                      &BiDiBSerialTransport::packetReceived,
@@ -688,12 +816,43 @@ int main(int argc, char *argv[])
                      &serialTransport,
                      &BiDiBSerialTransport::sendPacket);
 
-    QObject::connect(&packetParser,
-                     &BiDiBPacketParser::messageReceived,
-                     &node,
-                     &BiDiBNode::messageIn);
-
-    QObject::connect(&node, &BiDiBNode::messageOut, &packetParser, &BiDiBPacketParser::sendMessage);
+    std::unique_ptr<QObject> endpoint;
+    if (parser.isSet(nodesOption)) {
+        auto simulator = new Bd::Simulator;
+        simulator->populate(parser.value(nodesOption).toInt());
+        qDebug() << "simulating" << simulator->nodeCount() << "nodes";
+        endpoint.reset(simulator);
+
+        QObject::connect(&packetParser,
+                         &BiDiBPacketParser::messageReceived,
+                         simulator,
+                         [simulator](BiDiBMessage m) {
+                             if (auto address = Bd::Address::parse(m.addr + '\0'))
+                                 simulator->handleMessage(*address, Bd::Message(m.type, m.data));
+                         });
+
+        QObject::connect(simulator,
+                         &Bd::Simulator::messageOut,
+                         &packetParser,
+                         [&packetParser](Bd::Address const &address, Bd::Message const &msg) {
+                             auto addr = address.toByteArray();
+                             addr.chop(1);
+                             packetParser.sendMessage({addr, 0, msg.type(), msg.payload()});
+                         });
+    } else {
+        auto node = new BiDiBNode;
+        endpoint.reset(node);
+
+        QObject::connect(&packetParser,
+                         &BiDiBPacketParser::messageReceived,
+                         node,
+                         &BiDiBNode::messageIn);
+
+        QObject::connect(node,
+                         &BiDiBNode::messageOut,
+                         &packetParser,
+                         &BiDiBPacketParser::sendMessage);
+    }
 
     return app.exec();
 }